@@ -0,0 +1,145 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * Synthetic MAFW source and renderer for performance testing. Load the
+ * plugin with MAFW_TG_PLUGINS=/path/to/mafw-test-gui-synthetic.so and
+ * configure it with MAFW_TG_SYNTHETIC (see synthetic.h).
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <config.h>
+
+#include <libmafw/mafw.h>
+
+#include "synthetic.h"
+
+static MafwSource *source = NULL;
+static MafwRenderer *renderer = NULL;
+
+/**
+ * Read the configuration from the environment. Unknown keys are ignored with
+ * a warning, and missing keys keep their defaults.
+ */
+void
+synthetic_config_load (SyntheticConfig *config)
+{
+	const gchar *env;
+	gchar **pairs;
+	gchar **pair;
+	gchar *value;
+	guint number;
+
+	config->depth = 1;
+	config->fanout = 10;
+	config->items = 100;
+	config->payload = 0;
+	config->latency = 0;
+	config->jitter = 0;
+	config->renderer_delay = 100;
+	config->duration = 180;
+
+	env = g_getenv (SYNTHETIC_CONFIG_ENV);
+	if (env == NULL)
+		return;
+
+	pairs = g_strsplit (env, ",", 0);
+	for (pair = pairs; *pair != NULL; pair++)
+	{
+		value = strchr (*pair, '=');
+		if (value == NULL)
+		{
+			g_warning ("Synthetic plugin: ignoring '%s'", *pair);
+			continue;
+		}
+
+		*value++ = '\0';
+		number = strtoul (value, NULL, 10);
+
+		if (strcmp (*pair, "depth") == 0)
+			config->depth = number;
+		else if (strcmp (*pair, "fanout") == 0)
+			config->fanout = number;
+		else if (strcmp (*pair, "items") == 0)
+			config->items = number;
+		else if (strcmp (*pair, "payload") == 0)
+			config->payload = number;
+		else if (strcmp (*pair, "latency") == 0)
+			config->latency = number;
+		else if (strcmp (*pair, "jitter") == 0)
+			config->jitter = number;
+		else if (strcmp (*pair, "renderer-delay") == 0)
+			config->renderer_delay = number;
+		else if (strcmp (*pair, "duration") == 0)
+			config->duration = MAX (number, 1);
+		else
+			g_warning ("Synthetic plugin: unknown key '%s'", *pair);
+	}
+	g_strfreev (pairs);
+}
+
+static gboolean
+synthetic_plugin_initialize (MafwRegistry *registry, GError **error)
+{
+	SyntheticConfig config;
+
+	synthetic_config_load (&config);
+
+	source = synthetic_source_new (&config);
+	mafw_registry_add_extension (registry, MAFW_EXTENSION (source));
+
+	renderer = synthetic_renderer_new (&config);
+	mafw_registry_add_extension (registry, MAFW_EXTENSION (renderer));
+
+	return TRUE;
+}
+
+static void
+synthetic_plugin_deinitialize (GError **error)
+{
+	MafwRegistry *registry;
+
+	registry = MAFW_REGISTRY (mafw_registry_get_instance ());
+
+	if (source != NULL)
+	{
+		mafw_registry_remove_extension (registry,
+						MAFW_EXTENSION (source));
+		source = NULL;
+	}
+
+	if (renderer != NULL)
+	{
+		mafw_registry_remove_extension (registry,
+						MAFW_EXTENSION (renderer));
+		renderer = NULL;
+	}
+}
+
+/* The registry looks the descriptor up by the module's file name */
+G_MODULE_EXPORT MafwPluginDescriptor
+mafw_test_gui_synthetic_plugin_description = {
+	{ .name = "MAFW Test GUI synthetic plugin" },
+	.initialize = synthetic_plugin_initialize,
+	.deinitialize = synthetic_plugin_deinitialize,
+};
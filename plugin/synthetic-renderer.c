@@ -0,0 +1,503 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * Synthetic renderer. Accepts every request and goes through the same state
+ * changes and signals as a real renderer, but every change of state takes
+ * the configured delay, and nothing is actually played: the position just
+ * advances with the clock and the renderer moves on to the next playlist
+ * item at the end of each track.
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include <libmafw/mafw.h>
+
+#include "synthetic.h"
+
+#define SYNTHETIC_TYPE_RENDERER (synthetic_renderer_get_type ())
+
+typedef struct _SyntheticRenderer {
+	MafwRenderer parent;
+
+	SyntheticConfig config;
+
+	MafwPlaylist *playlist;
+	gint index;
+	gchar *objectid;
+
+	MafwPlayState state;
+
+	/* State to enter when state_timeout_id fires */
+	MafwPlayState target_state;
+	guint state_timeout_id;
+
+	/* Position in seconds when the clock was last started, and the
+	   clock that measures playing time since then */
+	gint position;
+	GTimer *clock;
+	guint tick_id;
+} SyntheticRenderer;
+
+typedef struct _SyntheticRendererClass {
+	MafwRendererClass parent_class;
+} SyntheticRendererClass;
+
+static GType synthetic_renderer_get_type (void);
+
+G_DEFINE_TYPE (SyntheticRenderer, synthetic_renderer, MAFW_TYPE_RENDERER);
+
+/*****************************************************************************
+ * State
+ *****************************************************************************/
+
+static gint
+synthetic_renderer_position (SyntheticRenderer *renderer)
+{
+	if (renderer->state != Playing)
+		return renderer->position;
+
+	return renderer->position +
+		(gint) g_timer_elapsed (renderer->clock, NULL);
+}
+
+static void
+synthetic_renderer_seek (SyntheticRenderer *renderer, gint position)
+{
+	renderer->position = CLAMP (position, 0,
+				    (gint) renderer->config.duration);
+	g_timer_start (renderer->clock);
+}
+
+static void
+synthetic_renderer_emit_state (SyntheticRenderer *renderer,
+			       MafwPlayState state)
+{
+	if (renderer->state == state)
+		return;
+
+	/* Freeze the position when playback stops */
+	if (renderer->state == Playing)
+		renderer->position = synthetic_renderer_position (renderer);
+	else if (state == Playing)
+		g_timer_start (renderer->clock);
+
+	renderer->state = state;
+	g_signal_emit_by_name (renderer, "state-changed", state);
+}
+
+static gboolean synthetic_renderer_tick (gpointer data);
+
+static gboolean
+synthetic_renderer_state_timeout (gpointer data)
+{
+	SyntheticRenderer *renderer = data;
+
+	renderer->state_timeout_id = 0;
+	synthetic_renderer_emit_state (renderer, renderer->target_state);
+
+	/* Stopping rewinds */
+	if (renderer->state == Stopped)
+		renderer->position = 0;
+
+	if (renderer->state == Playing && renderer->tick_id == 0)
+		renderer->tick_id = g_timeout_add (1000,
+						   synthetic_renderer_tick,
+						   renderer);
+
+	return FALSE;
+}
+
+/**
+ * Go to a new state after the configured delay. Starting playback goes
+ * through Transitioning, like renderers that need to buffer do.
+ */
+static void
+synthetic_renderer_change_state (SyntheticRenderer *renderer,
+				 MafwPlayState state)
+{
+	if (renderer->state_timeout_id != 0)
+		g_source_remove (renderer->state_timeout_id);
+
+	if (state == Playing)
+		synthetic_renderer_emit_state (renderer, Transitioning);
+
+	renderer->target_state = state;
+	renderer->state_timeout_id =
+		g_timeout_add (renderer->config.renderer_delay,
+			       synthetic_renderer_state_timeout, renderer);
+}
+
+/**
+ * Select the index'th item of the assigned playlist as the current media
+ */
+static gboolean
+synthetic_renderer_set_media (SyntheticRenderer *renderer, gint index)
+{
+	gchar *objectid = NULL;
+
+	if (renderer->playlist == NULL || index < 0 ||
+	    index >= (gint) mafw_playlist_get_size (renderer->playlist, NULL))
+		return FALSE;
+
+	objectid = mafw_playlist_get_item (renderer->playlist, index, NULL);
+	if (objectid == NULL)
+		return FALSE;
+
+	g_free (renderer->objectid);
+	renderer->objectid = objectid;
+	renderer->index = index;
+	synthetic_renderer_seek (renderer, 0);
+
+	g_signal_emit_by_name (renderer, "media-changed", renderer->index,
+			       renderer->objectid);
+	return TRUE;
+}
+
+/**
+ * Advance to the next track at the end of the current one, or stop at the
+ * end of the playlist.
+ */
+static gboolean
+synthetic_renderer_tick (gpointer data)
+{
+	SyntheticRenderer *renderer = data;
+
+	if (renderer->state != Playing)
+	{
+		renderer->tick_id = 0;
+		return FALSE;
+	}
+
+	if (synthetic_renderer_position (renderer) <
+	    (gint) renderer->config.duration)
+		return TRUE;
+
+	if (synthetic_renderer_set_media (renderer, renderer->index + 1))
+	{
+		synthetic_renderer_change_state (renderer, Playing);
+	}
+	else
+	{
+		synthetic_renderer_emit_state (renderer, Stopped);
+		synthetic_renderer_seek (renderer, 0);
+	}
+
+	renderer->tick_id = 0;
+	return FALSE;
+}
+
+static void
+synthetic_renderer_reply (SyntheticRenderer *renderer,
+			  MafwRendererPlaybackCB callback, gpointer user_data,
+			  gboolean ok)
+{
+	GError *error = NULL;
+
+	if (callback == NULL)
+		return;
+
+	if (ok == FALSE)
+		g_set_error (&error, MAFW_RENDERER_ERROR,
+			     MAFW_RENDERER_ERROR_NO_MEDIA, "Nothing to play");
+
+	callback (MAFW_RENDERER (renderer), user_data, error);
+
+	if (error != NULL)
+		g_error_free (error);
+}
+
+/*****************************************************************************
+ * Playback
+ *****************************************************************************/
+
+static void
+synthetic_renderer_play (MafwRenderer *self, MafwRendererPlaybackCB callback,
+			 gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+	gboolean ok = TRUE;
+
+	if (renderer->objectid == NULL)
+		ok = synthetic_renderer_set_media (renderer,
+						   MAX (renderer->index, 0));
+	if (ok)
+		synthetic_renderer_change_state (renderer, Playing);
+
+	synthetic_renderer_reply (renderer, callback, user_data, ok);
+}
+
+static void
+synthetic_renderer_play_object (MafwRenderer *self, const gchar *object_id,
+				MafwRendererPlaybackCB callback,
+				gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	g_free (renderer->objectid);
+	renderer->objectid = g_strdup (object_id);
+	renderer->index = -1;
+	synthetic_renderer_seek (renderer, 0);
+
+	g_signal_emit_by_name (renderer, "media-changed", renderer->index,
+			       renderer->objectid);
+	synthetic_renderer_change_state (renderer, Playing);
+	synthetic_renderer_reply (renderer, callback, user_data, TRUE);
+}
+
+static void
+synthetic_renderer_play_uri (MafwRenderer *self, const gchar *uri,
+			     MafwRendererPlaybackCB callback,
+			     gpointer user_data)
+{
+	synthetic_renderer_play_object (self, uri, callback, user_data);
+}
+
+static void
+synthetic_renderer_stop (MafwRenderer *self, MafwRendererPlaybackCB callback,
+			 gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	synthetic_renderer_change_state (renderer, Stopped);
+	synthetic_renderer_reply (renderer, callback, user_data, TRUE);
+}
+
+static void
+synthetic_renderer_pause (MafwRenderer *self,
+			  MafwRendererPlaybackCB callback, gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	synthetic_renderer_change_state (renderer, Paused);
+	synthetic_renderer_reply (renderer, callback, user_data, TRUE);
+}
+
+static void
+synthetic_renderer_resume (MafwRenderer *self,
+			   MafwRendererPlaybackCB callback, gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	synthetic_renderer_change_state (renderer, Playing);
+	synthetic_renderer_reply (renderer, callback, user_data, TRUE);
+}
+
+static void
+synthetic_renderer_get_status (MafwRenderer *self,
+			       MafwRendererStatusCB callback,
+			       gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	callback (self, renderer->playlist, MAX (renderer->index, 0),
+		  renderer->state, renderer->objectid, user_data, NULL);
+}
+
+/*****************************************************************************
+ * Playlist
+ *****************************************************************************/
+
+static gboolean
+synthetic_renderer_assign_playlist (MafwRenderer *self,
+				    MafwPlaylist *playlist, GError **error)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	if (renderer->playlist != NULL)
+		g_object_unref (renderer->playlist);
+	renderer->playlist = playlist != NULL ? g_object_ref (playlist)
+		: NULL;
+
+	g_free (renderer->objectid);
+	renderer->objectid = NULL;
+	renderer->index = -1;
+
+	synthetic_renderer_change_state (renderer, Stopped);
+	g_signal_emit_by_name (renderer, "playlist-changed", playlist);
+	synthetic_renderer_set_media (renderer, 0);
+
+	return TRUE;
+}
+
+static void
+synthetic_renderer_goto (SyntheticRenderer *renderer, gint index,
+			 MafwRendererPlaybackCB callback, gpointer user_data)
+{
+	gboolean ok;
+
+	ok = synthetic_renderer_set_media (renderer, index);
+	if (ok && renderer->state != Stopped)
+		synthetic_renderer_change_state (renderer, Playing);
+
+	synthetic_renderer_reply (renderer, callback, user_data, ok);
+}
+
+static void
+synthetic_renderer_next (MafwRenderer *self, MafwRendererPlaybackCB callback,
+			 gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	synthetic_renderer_goto (renderer, renderer->index + 1, callback,
+				 user_data);
+}
+
+static void
+synthetic_renderer_previous (MafwRenderer *self,
+			     MafwRendererPlaybackCB callback,
+			     gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	synthetic_renderer_goto (renderer, renderer->index - 1, callback,
+				 user_data);
+}
+
+static void
+synthetic_renderer_goto_index (MafwRenderer *self, guint index,
+			       MafwRendererPlaybackCB callback,
+			       gpointer user_data)
+{
+	synthetic_renderer_goto ((SyntheticRenderer *) self, index, callback,
+				 user_data);
+}
+
+/*****************************************************************************
+ * Position and metadata
+ *****************************************************************************/
+
+static void
+synthetic_renderer_set_position (MafwRenderer *self,
+				 MafwRendererSeekMode mode, gint seconds,
+				 MafwRendererPositionCB callback,
+				 gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+
+	if (mode == SeekRelative)
+		seconds += synthetic_renderer_position (renderer);
+	synthetic_renderer_seek (renderer, seconds);
+
+	if (callback != NULL)
+		callback (self, renderer->position, user_data, NULL);
+}
+
+static void
+synthetic_renderer_get_position (MafwRenderer *self,
+				 MafwRendererPositionCB callback,
+				 gpointer user_data)
+{
+	callback (self,
+		  synthetic_renderer_position ((SyntheticRenderer *) self),
+		  user_data, NULL);
+}
+
+static void
+synthetic_renderer_get_current_metadata (MafwRenderer *self,
+					 MafwRendererMetadataResultCB callback,
+					 gpointer user_data)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) self;
+	GHashTable *metadata = NULL;
+
+	if (renderer->objectid != NULL)
+	{
+		metadata = mafw_metadata_new ();
+		mafw_metadata_add_int (metadata, MAFW_METADATA_KEY_DURATION,
+				       renderer->config.duration);
+	}
+
+	callback (self, renderer->objectid, metadata, user_data, NULL);
+
+	if (metadata != NULL)
+		g_hash_table_unref (metadata);
+}
+
+/*****************************************************************************
+ * GObject
+ *****************************************************************************/
+
+static void
+synthetic_renderer_finalize (GObject *object)
+{
+	SyntheticRenderer *renderer = (SyntheticRenderer *) object;
+
+	if (renderer->state_timeout_id != 0)
+		g_source_remove (renderer->state_timeout_id);
+	if (renderer->tick_id != 0)
+		g_source_remove (renderer->tick_id);
+	if (renderer->playlist != NULL)
+		g_object_unref (renderer->playlist);
+
+	g_free (renderer->objectid);
+	g_timer_destroy (renderer->clock);
+
+	G_OBJECT_CLASS (synthetic_renderer_parent_class)->finalize (object);
+}
+
+static void
+synthetic_renderer_class_init (SyntheticRendererClass *klass)
+{
+	MafwRendererClass *renderer_class = MAFW_RENDERER_CLASS (klass);
+
+	G_OBJECT_CLASS (klass)->finalize = synthetic_renderer_finalize;
+
+	renderer_class->play = synthetic_renderer_play;
+	renderer_class->play_object = synthetic_renderer_play_object;
+	renderer_class->play_uri = synthetic_renderer_play_uri;
+	renderer_class->stop = synthetic_renderer_stop;
+	renderer_class->pause = synthetic_renderer_pause;
+	renderer_class->resume = synthetic_renderer_resume;
+	renderer_class->get_status = synthetic_renderer_get_status;
+	renderer_class->assign_playlist = synthetic_renderer_assign_playlist;
+	renderer_class->next = synthetic_renderer_next;
+	renderer_class->previous = synthetic_renderer_previous;
+	renderer_class->goto_index = synthetic_renderer_goto_index;
+	renderer_class->set_position = synthetic_renderer_set_position;
+	renderer_class->get_position = synthetic_renderer_get_position;
+	renderer_class->get_current_metadata =
+		synthetic_renderer_get_current_metadata;
+}
+
+static void
+synthetic_renderer_init (SyntheticRenderer *self)
+{
+	self->index = -1;
+	self->state = Stopped;
+	self->clock = g_timer_new ();
+}
+
+MafwRenderer *
+synthetic_renderer_new (const SyntheticConfig *config)
+{
+	SyntheticRenderer *renderer;
+
+	renderer = g_object_new (SYNTHETIC_TYPE_RENDERER,
+				 "uuid", SYNTHETIC_RENDERER_UUID,
+				 "name", "Synthetic renderer",
+				 NULL);
+	renderer->config = *config;
+
+	return MAFW_RENDERER (renderer);
+}
@@ -0,0 +1,589 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * Synthetic source. Serves a generated tree of containers and items whose
+ * shape, metadata size and result timing are set by SyntheticConfig, so that
+ * the views can be measured against the same data on every run.
+ *
+ * Object IDs encode the position in the tree: "synthetic::" is the root,
+ * "synthetic::3/7/" is the 8th sub-container of the 4th sub-container of the
+ * root and "synthetic::3/7/i17" is the 18th item in it.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <config.h>
+
+#include <libmafw/mafw.h>
+
+#include "synthetic.h"
+
+#define SYNTHETIC_ROOT SYNTHETIC_SOURCE_UUID "::"
+
+/** Number of results emitted per main loop iteration when latency is 0 */
+#define SYNTHETIC_RESULTS_PER_DISPATCH 50
+
+#define SYNTHETIC_TYPE_SOURCE (synthetic_source_get_type ())
+
+typedef struct _SyntheticSource {
+	MafwSource parent;
+
+	SyntheticConfig config;
+
+	/* Seeded with a constant, so that the jitter is the same on every
+	   run */
+	GRand *rand;
+
+	guint next_browse_id;
+
+	/* Browse ID -> SyntheticBrowse */
+	GHashTable *browses;
+} SyntheticSource;
+
+typedef struct _SyntheticSourceClass {
+	MafwSourceClass parent_class;
+} SyntheticSourceClass;
+
+typedef struct _SyntheticBrowse {
+	SyntheticSource *source;
+	guint browse_id;
+
+	/* Object ID of the browsed container */
+	gchar *objectid;
+	guint level;
+	gboolean recursive;
+
+	/* Index of the next result and one past the last one */
+	guint next;
+	guint end;
+
+	/* Index of the first result, results are numbered from here */
+	guint first;
+
+	MafwSourceBrowseResultCb callback;
+	gpointer user_data;
+	guint timeout_id;
+} SyntheticBrowse;
+
+enum {
+	PROP_0,
+	PROP_PENDING_BROWSES
+};
+
+static GType synthetic_source_get_type (void);
+
+G_DEFINE_TYPE (SyntheticSource, synthetic_source, MAFW_TYPE_SOURCE);
+
+/*****************************************************************************
+ * Tree geometry
+ *****************************************************************************/
+
+/**
+ * Parse an object ID of this source.
+ *
+ * @param objectid The object ID to parse
+ * @param level Depth of the container, or of the item's parent container
+ * @param item Index of the item, or -1 for containers
+ * @return TRUE if the object ID refers to an object in the tree
+ */
+static gboolean
+synthetic_parse_objectid (SyntheticSource *source, const gchar *objectid,
+			  guint *level, gint *item)
+{
+	const gchar *p;
+	gchar *end;
+	gulong n;
+
+	if (!g_str_has_prefix (objectid, SYNTHETIC_ROOT))
+		return FALSE;
+
+	*level = 0;
+	*item = -1;
+	for (p = objectid + strlen (SYNTHETIC_ROOT); *p != '\0'; p = end)
+	{
+		if (*p == 'i')
+		{
+			/* Items only exist in the leaf containers */
+			n = strtoul (p + 1, &end, 10);
+			if (end == p + 1 || *end != '\0' ||
+			    *level != source->config.depth ||
+			    n >= source->config.items)
+				return FALSE;
+
+			*item = n;
+			return TRUE;
+		}
+
+		n = strtoul (p, &end, 10);
+		if (end == p || *end != '/' ||
+		    *level >= source->config.depth ||
+		    n >= source->config.fanout)
+			return FALSE;
+
+		end++;
+		(*level)++;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Number of results that browsing a container at the given level yields
+ */
+static guint
+synthetic_child_count (SyntheticSource *source, guint level,
+		       gboolean recursive)
+{
+	guint count;
+
+	if (recursive == FALSE)
+		return level < source->config.depth ? source->config.fanout
+			: source->config.items;
+
+	/* Recursive browsing yields only the items of the subtree */
+	count = source->config.items;
+	for (; level < source->config.depth; level++)
+		count *= source->config.fanout;
+
+	return count;
+}
+
+/**
+ * Object ID of the index'th result of browsing a container.
+ */
+static gchar *
+synthetic_child_objectid (SyntheticSource *source, const gchar *parent,
+			  guint level, gboolean recursive, guint index)
+{
+	GString *objectid;
+	guint leaf, item, divisor, i;
+
+	if (recursive == FALSE)
+	{
+		if (level < source->config.depth)
+			return g_strdup_printf ("%s%u/", parent, index);
+		else
+			return g_strdup_printf ("%si%u", parent, index);
+	}
+
+	/* Items are numbered in depth-first order, so the index is the item
+	   index in the leaf plus the leaf's path as digits in base fanout */
+	item = index % source->config.items;
+	leaf = index / source->config.items;
+
+	divisor = 1;
+	for (i = level + 1; i < source->config.depth; i++)
+		divisor *= source->config.fanout;
+
+	objectid = g_string_new (parent);
+	for (i = level; i < source->config.depth; i++)
+	{
+		g_string_append_printf (objectid, "%u/", leaf / divisor);
+		leaf %= divisor;
+		divisor = MAX (divisor / source->config.fanout, 1);
+	}
+	g_string_append_printf (objectid, "i%u", item);
+
+	return g_string_free (objectid, FALSE);
+}
+
+static GHashTable *
+synthetic_object_metadata (SyntheticSource *source, const gchar *objectid,
+			   guint level, gint item)
+{
+	GHashTable *metadata;
+	const gchar *path;
+	gchar *value;
+
+	path = objectid + strlen (SYNTHETIC_ROOT);
+	metadata = mafw_metadata_new ();
+
+	if (item < 0)
+	{
+		value = g_strdup_printf ("Container %s",
+					 *path != '\0' ? path : "/");
+		mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_TITLE,
+				       value);
+		mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_MIME,
+				       MAFW_METADATA_VALUE_MIME_CONTAINER);
+		mafw_metadata_add_int (metadata,
+				       MAFW_METADATA_KEY_CHILDCOUNT_1,
+				       synthetic_child_count (source, level,
+							      FALSE));
+		g_free (value);
+		return metadata;
+	}
+
+	value = g_strdup_printf ("Synthetic track %d", item);
+	mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_TITLE, value);
+	g_free (value);
+
+	value = g_strdup_printf ("file:///synthetic/%s.mp3", path);
+	mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_URI, value);
+	g_free (value);
+
+	mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_MIME,
+			       "audio/mpeg");
+	mafw_metadata_add_int (metadata, MAFW_METADATA_KEY_DURATION,
+			       source->config.duration);
+
+	if (source->config.payload > 0)
+	{
+		value = g_strnfill (source->config.payload, 'x');
+		mafw_metadata_add_str (metadata, MAFW_METADATA_KEY_COMMENT,
+				       value);
+		g_free (value);
+	}
+
+	return metadata;
+}
+
+/*****************************************************************************
+ * Browsing
+ *****************************************************************************/
+
+static gboolean synthetic_browse_dispatch (gpointer data);
+
+static void
+synthetic_browse_free (SyntheticBrowse *browse)
+{
+	if (browse->timeout_id != 0)
+		g_source_remove (browse->timeout_id);
+	g_free (browse->objectid);
+	g_free (browse);
+}
+
+/**
+ * Schedule the next result of a browse, after the configured latency with
+ * random jitter. Without latency the results are emitted from idle in
+ * batches.
+ */
+static void
+synthetic_browse_schedule (SyntheticBrowse *browse)
+{
+	SyntheticConfig *config = &browse->source->config;
+	gint delay;
+
+	if (config->latency == 0 && config->jitter == 0)
+	{
+		browse->timeout_id = g_idle_add (synthetic_browse_dispatch,
+						 browse);
+		return;
+	}
+
+	delay = config->latency;
+	if (config->jitter > 0)
+		delay += g_rand_int_range (browse->source->rand,
+					   -(gint) config->jitter,
+					   config->jitter + 1);
+
+	browse->timeout_id = g_timeout_add (MAX (delay, 0),
+					    synthetic_browse_dispatch,
+					    browse);
+}
+
+/**
+ * Emit the next result or batch of results of a browse. The callback may
+ * cancel the browse or start new ones, so nothing is kept across calls to
+ * it.
+ */
+static gboolean
+synthetic_browse_dispatch (gpointer data)
+{
+	SyntheticBrowse *browse = data;
+	SyntheticSource *source = browse->source;
+	MafwSourceBrowseResultCb callback;
+	GHashTable *metadata;
+	gpointer user_data;
+	gchar *objectid;
+	guint browse_id, index, remaining, level, batch, i;
+	gint item;
+
+	browse_id = browse->browse_id;
+	browse->timeout_id = 0;
+
+	if (browse->next >= browse->end)
+	{
+		/* Empty result set */
+		callback = browse->callback;
+		user_data = browse->user_data;
+		g_hash_table_remove (source->browses,
+				     GUINT_TO_POINTER (browse_id));
+
+		callback (MAFW_SOURCE (source), browse_id, 0, 0, NULL, NULL,
+			  user_data, NULL);
+		return FALSE;
+	}
+
+	batch = 1;
+	if (source->config.latency == 0 && source->config.jitter == 0)
+		batch = SYNTHETIC_RESULTS_PER_DISPATCH;
+
+	for (i = 0; i < batch; i++)
+	{
+		callback = browse->callback;
+		user_data = browse->user_data;
+		index = browse->next++;
+		remaining = browse->end - browse->next;
+
+		objectid = synthetic_child_objectid (source, browse->objectid,
+						     browse->level,
+						     browse->recursive,
+						     index);
+		synthetic_parse_objectid (source, objectid, &level, &item);
+		metadata = synthetic_object_metadata (source, objectid,
+						      level, item);
+		index -= browse->first;
+
+		/* Removing the browse frees it */
+		if (remaining == 0)
+			g_hash_table_remove (source->browses,
+					     GUINT_TO_POINTER (browse_id));
+
+		callback (MAFW_SOURCE (source), browse_id, remaining,
+			  index, objectid, metadata, user_data, NULL);
+		g_hash_table_unref (metadata);
+		g_free (objectid);
+
+		if (remaining == 0)
+			return FALSE;
+
+		/* Cancelled from the callback */
+		browse = g_hash_table_lookup (source->browses,
+					      GUINT_TO_POINTER (browse_id));
+		if (browse == NULL)
+			return FALSE;
+	}
+
+	synthetic_browse_schedule (browse);
+	return FALSE;
+}
+
+static guint
+synthetic_source_browse (MafwSource *self, const gchar *object_id,
+			 gboolean recursive, const MafwFilter *filter,
+			 const gchar *sort_criteria,
+			 const gchar *const *metadata_keys,
+			 guint skip_count, guint item_count,
+			 MafwSourceBrowseResultCb browse_cb,
+			 gpointer user_data)
+{
+	SyntheticSource *source = (SyntheticSource *) self;
+	SyntheticBrowse *browse;
+	GError *error = NULL;
+	guint level, count;
+	gint item;
+
+	if (!synthetic_parse_objectid (source, object_id, &level, &item) ||
+	    item >= 0)
+	{
+		g_set_error (&error, MAFW_SOURCE_ERROR,
+			     MAFW_SOURCE_ERROR_INVALID_OBJECT_ID,
+			     "Not a container: %s", object_id);
+		browse_cb (self, MAFW_SOURCE_INVALID_BROWSE_ID, 0, 0, NULL,
+			   NULL, user_data, error);
+		g_error_free (error);
+		return MAFW_SOURCE_INVALID_BROWSE_ID;
+	}
+
+	browse = g_new0 (SyntheticBrowse, 1);
+	browse->source = source;
+	browse->browse_id = source->next_browse_id++;
+	browse->objectid = g_strdup (object_id);
+	browse->level = level;
+	browse->recursive = recursive;
+	browse->callback = browse_cb;
+	browse->user_data = user_data;
+
+	count = synthetic_child_count (source, level, recursive);
+	browse->first = MIN (skip_count, count);
+	browse->next = browse->first;
+	browse->end = count;
+	if (item_count != MAFW_SOURCE_BROWSE_ALL)
+		browse->end = MIN (browse->end, browse->next + item_count);
+
+	g_hash_table_insert (source->browses,
+			     GUINT_TO_POINTER (browse->browse_id), browse);
+	synthetic_browse_schedule (browse);
+
+	return browse->browse_id;
+}
+
+static gboolean
+synthetic_source_cancel_browse (MafwSource *self, guint browse_id,
+				GError **error)
+{
+	SyntheticSource *source = (SyntheticSource *) self;
+
+	if (!g_hash_table_remove (source->browses,
+				  GUINT_TO_POINTER (browse_id)))
+	{
+		g_set_error (error, MAFW_SOURCE_ERROR,
+			     MAFW_SOURCE_ERROR_INVALID_BROWSE_ID,
+			     "No such browse: %u", browse_id);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*****************************************************************************
+ * Metadata
+ *****************************************************************************/
+
+static void
+synthetic_source_get_metadata (MafwSource *self, const gchar *object_id,
+			       const gchar *const *metadata_keys,
+			       MafwSourceMetadataResultCb metadata_cb,
+			       gpointer user_data)
+{
+	SyntheticSource *source = (SyntheticSource *) self;
+	GHashTable *metadata;
+	GError *error = NULL;
+	guint level;
+	gint item;
+
+	if (!synthetic_parse_objectid (source, object_id, &level, &item))
+	{
+		g_set_error (&error, MAFW_SOURCE_ERROR,
+			     MAFW_SOURCE_ERROR_INVALID_OBJECT_ID,
+			     "No such object: %s", object_id);
+		metadata_cb (self, object_id, NULL, user_data, error);
+		g_error_free (error);
+		return;
+	}
+
+	metadata = synthetic_object_metadata (source, object_id, level, item);
+	metadata_cb (self, object_id, metadata, user_data, NULL);
+	g_hash_table_unref (metadata);
+}
+
+static void
+synthetic_source_get_metadatas (MafwSource *self, const gchar **object_ids,
+				const gchar *const *metadata_keys,
+				MafwSourceMetadataResultsCb metadatas_cb,
+				gpointer user_data)
+{
+	SyntheticSource *source = (SyntheticSource *) self;
+	GHashTable *metadatas;
+	guint level, i;
+	gint item;
+
+	/* Unknown object IDs are left out of the results */
+	metadatas = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					   (GDestroyNotify) g_hash_table_unref);
+	for (i = 0; object_ids[i] != NULL; i++)
+	{
+		if (!synthetic_parse_objectid (source, object_ids[i], &level,
+					       &item))
+			continue;
+
+		g_hash_table_insert (metadatas, (gpointer) object_ids[i],
+				     synthetic_object_metadata (source,
+								object_ids[i],
+								level, item));
+	}
+
+	metadatas_cb (self, metadatas, user_data, NULL);
+	g_hash_table_unref (metadatas);
+}
+
+/*****************************************************************************
+ * GObject
+ *****************************************************************************/
+
+static void
+synthetic_source_get_property (GObject *object, guint prop_id,
+			       GValue *value, GParamSpec *pspec)
+{
+	SyntheticSource *source = (SyntheticSource *) object;
+
+	switch (prop_id)
+	{
+	case PROP_PENDING_BROWSES:
+		g_value_set_uint (value, g_hash_table_size (source->browses));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		break;
+	}
+}
+
+static void
+synthetic_source_finalize (GObject *object)
+{
+	SyntheticSource *source = (SyntheticSource *) object;
+
+	g_hash_table_destroy (source->browses);
+	g_rand_free (source->rand);
+
+	G_OBJECT_CLASS (synthetic_source_parent_class)->finalize (object);
+}
+
+static void
+synthetic_source_class_init (SyntheticSourceClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	MafwSourceClass *source_class = MAFW_SOURCE_CLASS (klass);
+
+	object_class->get_property = synthetic_source_get_property;
+	object_class->finalize = synthetic_source_finalize;
+
+	source_class->browse = synthetic_source_browse;
+	source_class->cancel_browse = synthetic_source_cancel_browse;
+	source_class->get_metadata = synthetic_source_get_metadata;
+	source_class->get_metadatas = synthetic_source_get_metadatas;
+
+	/* Lets test drivers wait until all the results have been
+	   delivered */
+	g_object_class_install_property (
+		object_class, PROP_PENDING_BROWSES,
+		g_param_spec_uint ("pending-browses", "Pending browses",
+				   "Number of unfinished browse operations",
+				   0, G_MAXUINT, 0, G_PARAM_READABLE));
+}
+
+static void
+synthetic_source_init (SyntheticSource *self)
+{
+	self->rand = g_rand_new_with_seed (0);
+	self->next_browse_id = 1;
+	self->browses = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					       NULL,
+					       (GDestroyNotify)
+					       synthetic_browse_free);
+}
+
+MafwSource *
+synthetic_source_new (const SyntheticConfig *config)
+{
+	SyntheticSource *source;
+
+	source = g_object_new (SYNTHETIC_TYPE_SOURCE,
+			       "uuid", SYNTHETIC_SOURCE_UUID,
+			       "name", "Synthetic source",
+			       NULL);
+	source->config = *config;
+
+	return MAFW_SOURCE (source);
+}
@@ -0,0 +1,76 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __SYNTHETIC_H__
+#define __SYNTHETIC_H__
+
+#include <config.h>
+#include <libmafw/mafw.h>
+
+/** UUIDs of the synthetic extensions */
+#define SYNTHETIC_SOURCE_UUID "synthetic"
+#define SYNTHETIC_RENDERER_UUID "synthetic-renderer"
+
+/** File name of the plugin module */
+#define SYNTHETIC_PLUGIN_FILE "mafw-test-gui-synthetic.so"
+
+/** Environment variable holding the configuration */
+#define SYNTHETIC_CONFIG_ENV "MAFW_TG_SYNTHETIC"
+
+/**
+ * Behaviour of the synthetic extensions. Set with a comma separated list of
+ * key=value pairs in $MAFW_TG_SYNTHETIC, for example
+ * "depth=2,fanout=5,items=1000,latency=2,jitter=1".
+ */
+typedef struct _SyntheticConfig
+{
+	/** Levels of containers under the root container */
+	guint depth;
+
+	/** Number of sub-containers in each non-leaf container */
+	guint fanout;
+
+	/** Number of items in each leaf container */
+	guint items;
+
+	/** Bytes of extra metadata (comment) for each item */
+	guint payload;
+
+	/** Milliseconds between consecutive browse results, and the maximum
+	    random deviation from it */
+	guint latency;
+	guint jitter;
+
+	/** Milliseconds that the renderer takes to change its state */
+	guint renderer_delay;
+
+	/** Length of each track in seconds, for renderer positions */
+	guint duration;
+
+} SyntheticConfig;
+
+void synthetic_config_load(SyntheticConfig *config);
+
+MafwSource *synthetic_source_new(const SyntheticConfig *config);
+MafwRenderer *synthetic_renderer_new(const SyntheticConfig *config);
+
+#endif /* __SYNTHETIC_H__ */
@@ -0,0 +1,1173 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * Headless benchmark for the browse and playlist views.
+ *
+ * Loads the same UI as the application without showing it, and drives the
+ * source and playlist view code with scripted workloads. The results are
+ * printed as a table and can be compared against a saved baseline.
+ *
+ * The browsed items come from the synthetic source plugin in plugin/, so
+ * the results do not depend on the media on the device. $MAFW_TG_SYNTHETIC
+ * can be used to add latency or metadata payload to the results.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <sys/resource.h>
+#include <config.h>
+
+#include <gtk/gtk.h>
+#include <libmafw/mafw.h>
+#include <libmafw-shared/mafw-playlist-manager.h>
+#include <libmafw-shared/mafw-proxy-playlist.h>
+
+#include "main.h"
+#include "source-treeview.h"
+#include "source-model.h"
+#include "browse-cache.h"
+#include "playlist-controls.h"
+#include "playlist-treeview.h"
+#include "title-cache.h"
+#include "plugin/synthetic.h"
+
+#define GTK_BUILDER_FILE DATA_DIR "/mafw-test-gui.ui"
+
+/** The synthetic plugin to load. Libtool keeps the uninstalled plugin in
+    its object directory. */
+#ifdef SYNTHETIC_PLUGIN_UNINSTALLED
+#define SYNTHETIC_PLUGIN SYNTHETIC_PLUGIN_DIR "/" LT_OBJDIR \
+	SYNTHETIC_PLUGIN_FILE
+#else
+#define SYNTHETIC_PLUGIN SYNTHETIC_PLUGIN_DIR "/" SYNTHETIC_PLUGIN_FILE
+#endif
+
+/** Give up waiting for a workload after this many seconds */
+#define BENCH_TIMEOUT 120.0
+
+/** Root container of the synthetic source */
+#define BENCH_ROOT SYNTHETIC_SOURCE_UUID "::"
+
+extern GtkWidget *main_window;
+
+/*****************************************************************************
+ * Options
+ *****************************************************************************/
+
+static gint opt_items = 10000;
+static gint opt_playlist_items = 1000;
+static gint opt_repeat = 3;
+static gint opt_threshold = 20;
+static gint opt_read_ahead = -1;
+static gchar *opt_ui_file = NULL;
+static gchar *opt_baseline = NULL;
+static gchar *opt_save_baseline = NULL;
+static gboolean opt_show = FALSE;
+static gboolean opt_no_playlist = FALSE;
+static gchar *opt_plugin = NULL;
+
+static GOptionEntry entries[] = {
+	{ "items", 'n', 0, G_OPTION_ARG_INT, &opt_items,
+	  "Number of items in the browsed container", "N" },
+	{ "playlist-items", 'p', 0, G_OPTION_ARG_INT, &opt_playlist_items,
+	  "Number of items in the benchmark playlist", "N" },
+	{ "repeat", 'r', 0, G_OPTION_ARG_INT, &opt_repeat,
+	  "Run each workload N times and report the best", "N" },
+	{ "baseline", 'b', 0, G_OPTION_ARG_FILENAME, &opt_baseline,
+	  "Compare the results against a baseline file", "FILE" },
+	{ "save-baseline", 's', 0, G_OPTION_ARG_FILENAME, &opt_save_baseline,
+	  "Save the results as a baseline file", "FILE" },
+	{ "threshold", 't', 0, G_OPTION_ARG_INT, &opt_threshold,
+	  "Allowed slowdown against the baseline, in percent", "PERCENT" },
+	{ "read-ahead", 0, 0, G_OPTION_ARG_INT, &opt_read_ahead,
+	  "Rows around the visible playlist rows to fetch in advance", "N" },
+	{ "ui-file", 0, 0, G_OPTION_ARG_FILENAME, &opt_ui_file,
+	  "GtkBuilder file to load instead of the installed one", "FILE" },
+	{ "show", 0, 0, G_OPTION_ARG_NONE, &opt_show,
+	  "Show the window, so that rendering is included", NULL },
+	{ "no-playlist", 0, 0, G_OPTION_ARG_NONE, &opt_no_playlist,
+	  "Skip the workloads that need the playlist daemon", NULL },
+	{ "plugin", 0, 0, G_OPTION_ARG_FILENAME, &opt_plugin,
+	  "Synthetic plugin to load instead of the default one",
+	  "FILE" },
+	{ NULL }
+};
+
+/*****************************************************************************
+ * Functions normally provided by main.c
+ *****************************************************************************/
+
+void activate_all(gboolean make_active)
+{
+}
+
+void mtg_print_signal_gen (const gchar* origin, const gchar* signal,
+			   const gchar* format, ...)
+{
+}
+
+void mtg_print_signal (MafwExtension* origin, const gchar* signal,
+		       const gchar* format, ...)
+{
+}
+
+void
+application_exit (void)
+{
+	gtk_main_quit ();
+}
+
+/*****************************************************************************
+ * Measurement helpers
+ *****************************************************************************/
+
+typedef struct _BenchResult {
+	gchar *name;
+
+	/** Milliseconds until the first visible result, or 0 if not
+	    applicable */
+	gdouble first;
+
+	/** Milliseconds until the workload was complete */
+	gdouble total;
+
+	/** Peak resident set size of the process so far, in kB */
+	glong peak_rss;
+} BenchResult;
+
+/** BenchResult array */
+static GArray *results = NULL;
+
+static GtkWidget *treeview = NULL;
+static GtkWidget *playlist_view = NULL;
+static GtkWidget *up_button = NULL;
+static MafwSource *bench_source = NULL;
+
+static glong
+peak_rss (void)
+{
+	struct rusage usage;
+
+	if (getrusage (RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	/* Linux reports kilobytes */
+	return usage.ru_maxrss;
+}
+
+static gdouble
+elapsed_ms (GTimer *timer)
+{
+	return g_timer_elapsed (timer, NULL) * 1000.0;
+}
+
+/**
+ * Run the main loop until it has nothing to do
+ */
+static void
+drain (void)
+{
+	while (gtk_events_pending ())
+		gtk_main_iteration ();
+}
+
+/**
+ * Keep the best (smallest) numbers of repeated runs of the same workload
+ */
+static void
+add_result (const gchar *name, gdouble first, gdouble total)
+{
+	BenchResult result;
+	BenchResult *old;
+	guint i;
+
+	for (i = 0; i < results->len; i++)
+	{
+		old = &g_array_index (results, BenchResult, i);
+		if (strcmp (old->name, name) == 0)
+		{
+			old->first = MIN (old->first, first);
+			old->total = MIN (old->total, total);
+			old->peak_rss = peak_rss ();
+			return;
+		}
+	}
+
+	result.name = g_strdup (name);
+	result.first = first;
+	result.total = total;
+	result.peak_rss = peak_rss ();
+	g_array_append_val (results, result);
+}
+
+/*****************************************************************************
+ * Browse workloads
+ *****************************************************************************/
+
+/**
+ * Check whether the synthetic source still has results to deliver
+ */
+static gboolean
+bench_source_busy (void)
+{
+	guint pending = 0;
+
+	g_object_get (bench_source, "pending-browses", &pending, NULL);
+	return pending > 0;
+}
+
+/**
+ * Check whether the view shows at least one item of the browsed container
+ */
+static gboolean
+view_has_items (void)
+{
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *objectid = NULL;
+	gboolean found;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
+	if (model == NULL || !gtk_tree_model_get_iter_first (model, &iter))
+		return FALSE;
+
+	gtk_tree_model_get (model, &iter,
+			    SOURCE_MODEL_COLUMN_OBJECTID, &objectid, -1);
+	found = objectid != NULL && g_str_has_prefix (objectid, BENCH_ROOT) &&
+		strcmp (objectid, BENCH_ROOT) != 0;
+	g_free (objectid);
+
+	return found;
+}
+
+/**
+ * Find the benchmark source from the top level of the source view
+ */
+static GtkTreePath *
+find_bench_source_row (void)
+{
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *objectid;
+	gboolean found = FALSE;
+
+	model = gtk_tree_view_get_model (GTK_TREE_VIEW (treeview));
+	if (model == NULL || !gtk_tree_model_get_iter_first (model, &iter))
+		return NULL;
+
+	do
+	{
+		gtk_tree_model_get (model, &iter,
+				    SOURCE_MODEL_COLUMN_OBJECTID, &objectid,
+				    -1);
+		found = objectid != NULL && strcmp (objectid, BENCH_ROOT) == 0;
+		g_free (objectid);
+	} while (found == FALSE && gtk_tree_model_iter_next (model, &iter));
+
+	return found ? gtk_tree_model_get_path (model, &iter) : NULL;
+}
+
+/**
+ * Enter the benchmark source's root container the same way a user does,
+ * and wait until the whole container has been browsed and displayed.
+ */
+static gboolean
+run_browse (SourceModelBehaviour behaviour)
+{
+	GtkTreePath *path;
+	GTimer *timer;
+	gdouble first = 0.0;
+	gchar *name;
+
+	source_treeview_set_model_behaviour (behaviour);
+	drain ();
+
+	path = find_bench_source_row ();
+	if (path == NULL)
+	{
+		g_printerr ("Benchmark source not found in the view\n");
+		return FALSE;
+	}
+
+	gtk_tree_view_set_cursor (GTK_TREE_VIEW (treeview), path, NULL, FALSE);
+
+	timer = g_timer_new ();
+	gtk_tree_view_row_activated (GTK_TREE_VIEW (treeview), path,
+				     gtk_tree_view_get_column (
+					     GTK_TREE_VIEW (treeview), 0));
+	gtk_tree_path_free (path);
+
+	while (bench_source_busy () || gtk_events_pending ())
+	{
+		if (first == 0.0 && view_has_items ())
+			first = elapsed_ms (timer);
+
+		if (g_timer_elapsed (timer, NULL) > BENCH_TIMEOUT)
+		{
+			g_printerr ("Browsing timed out\n");
+			g_timer_destroy (timer);
+			return FALSE;
+		}
+
+		if (gtk_events_pending ())
+			gtk_main_iteration ();
+		else
+			g_usleep (100);
+	}
+
+	if (first == 0.0 && view_has_items ())
+		first = elapsed_ms (timer);
+
+	name = g_strdup_printf ("browse-%s",
+				source_treeview_behaviour_name (behaviour));
+	add_result (name, first, elapsed_ms (timer));
+	g_free (name);
+	g_timer_destroy (timer);
+
+	/* Back to the top level */
+	gtk_button_clicked (GTK_BUTTON (up_button));
+	drain ();
+
+	return TRUE;
+}
+
+/**
+ * Object ID lookups in a large source model, through the index and by
+ * walking the model like find_objectid() used to.
+ */
+static void
+run_lookup (guint rows)
+{
+	SourceModel *model;
+	GtkTreeIter iter;
+	GTimer *timer;
+	gchar **objectids;
+	gchar *name;
+	gchar *objectid;
+	guint lookups = 1000;
+	guint i;
+
+	model = source_model_new ();
+	for (i = 0; i < rows; i++)
+	{
+		objectid = g_strdup_printf (BENCH_ROOT "i%u", i);
+		source_model_append (model, "Benchmark track", objectid,
+				     "audio/mpeg", NULL);
+		g_free (objectid);
+	}
+
+	objectids = g_new0 (gchar *, lookups + 1);
+	for (i = 0; i < lookups; i++)
+		objectids[i] = g_strdup_printf (BENCH_ROOT "i%u",
+						g_random_int_range (0, rows));
+
+	timer = g_timer_new ();
+	for (i = 0; i < lookups; i++)
+		source_model_lookup (model, objectids[i], &iter);
+	name = g_strdup_printf ("lookup-index-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	g_timer_start (timer);
+	for (i = 0; i < lookups; i++)
+	{
+		gboolean found = FALSE;
+
+		if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model),
+						    &iter))
+			continue;
+		do
+		{
+			gtk_tree_model_get (GTK_TREE_MODEL (model), &iter,
+					    SOURCE_MODEL_COLUMN_OBJECTID,
+					    &objectid, -1);
+			found = strcmp (objectid, objectids[i]) == 0;
+			g_free (objectid);
+		} while (!found &&
+			 gtk_tree_model_iter_next (GTK_TREE_MODEL (model),
+						   &iter));
+	}
+	name = g_strdup_printf ("lookup-linear-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	g_timer_destroy (timer);
+	g_strfreev (objectids);
+	g_object_unref (model);
+}
+
+/**
+ * Draw the icon column of a large container the way scrolling through it
+ * does, once through the view's cell data function and once by choosing
+ * the icon from the MIME string like the data function used to.
+ */
+static void
+run_scroll (guint rows)
+{
+	static const gchar *mimes[] = {
+		MAFW_METADATA_VALUE_MIME_CONTAINER,
+		"audio/mpeg",
+		"video/mp4",
+		"image/jpeg",
+		"text/plain"
+	};
+	GtkTreeViewColumn *column;
+	GtkCellRenderer *renderer;
+	SourceModel *model;
+	GtkTreeIter iter;
+	GdkPixbuf *icons[G_N_ELEMENTS (mimes)];
+	GdkPixbuf *pixbuf;
+	GTimer *timer;
+	GList *cells;
+	gchar *objectid;
+	gchar *mime;
+	gchar *name;
+	guint passes = 10;
+	guint i;
+
+	model = source_model_new ();
+	for (i = 0; i < rows; i++)
+	{
+		objectid = g_strdup_printf (BENCH_ROOT "i%u", i);
+		source_model_append (model, "Benchmark track", objectid,
+				     mimes[i % G_N_ELEMENTS (mimes)], NULL);
+		g_free (objectid);
+	}
+
+	column = gtk_tree_view_get_column (GTK_TREE_VIEW (treeview), 0);
+	cells = gtk_tree_view_column_get_cell_renderers (column);
+	renderer = cells->data;
+	g_list_free (cells);
+
+	timer = g_timer_new ();
+	for (i = 0; i < passes; i++)
+	{
+		if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model),
+						    &iter))
+			break;
+		do
+		{
+			gtk_tree_view_column_cell_set_cell_data (
+				column, GTK_TREE_MODEL (model), &iter,
+				FALSE, FALSE);
+		} while (gtk_tree_model_iter_next (GTK_TREE_MODEL (model),
+						   &iter));
+	}
+	name = g_strdup_printf ("scroll-icons-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	/* The icons the view chose for each of the MIME types */
+	for (i = 0; i < G_N_ELEMENTS (mimes); i++)
+	{
+		icons[i] = NULL;
+		if (gtk_tree_model_iter_nth_child (GTK_TREE_MODEL (model),
+						   &iter, NULL, i))
+		{
+			gtk_tree_view_column_cell_set_cell_data (
+				column, GTK_TREE_MODEL (model), &iter,
+				FALSE, FALSE);
+			g_object_get (G_OBJECT (renderer), "pixbuf", &icons[i],
+				      NULL);
+		}
+	}
+
+	g_timer_start (timer);
+	for (i = 0; i < passes; i++)
+	{
+		if (!gtk_tree_model_get_iter_first (GTK_TREE_MODEL (model),
+						    &iter))
+			break;
+		do
+		{
+			gtk_tree_model_get (GTK_TREE_MODEL (model), &iter,
+					    SOURCE_MODEL_COLUMN_MIME, &mime,
+					    SOURCE_MODEL_COLUMN_OBJECTID,
+					    &objectid, -1);
+			if (objectid == NULL || mime == NULL)
+				pixbuf = NULL;
+			else if (strcmp (mime,
+					 MAFW_METADATA_VALUE_MIME_CONTAINER)
+				 == 0)
+				pixbuf = icons[0];
+			else if (strstr (mime, "audio") != NULL)
+				pixbuf = icons[1];
+			else if (strstr (mime, "video") != NULL)
+				pixbuf = icons[2];
+			else if (strstr (mime, "image") != NULL)
+				pixbuf = icons[3];
+			else
+				pixbuf = icons[4];
+			g_free (mime);
+			g_free (objectid);
+			g_object_set (G_OBJECT (renderer), "pixbuf", pixbuf,
+				      NULL);
+		} while (gtk_tree_model_iter_next (GTK_TREE_MODEL (model),
+						   &iter));
+	}
+	name = g_strdup_printf ("scroll-icons-mime-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	for (i = 0; i < G_N_ELEMENTS (mimes); i++)
+	{
+		if (icons[i] != NULL)
+			g_object_unref (icons[i]);
+	}
+
+	g_timer_destroy (timer);
+	g_object_unref (model);
+}
+
+/**
+ * Filter the titles of a large source model shown in a view as the user
+ * types: through the title filter of the model, which includes telling the
+ * view about the rows that appear and disappear, and by folding and
+ * searching every title like a plain filter would. Returns %FALSE if the
+ * two find different rows.
+ */
+static gboolean
+run_title_filter (guint rows)
+{
+	static const gchar *keystrokes[] = {
+		"t", "tr", "tra", "trac", "track", "track 1", "track 12",
+		"track 123", "artist 4", "ARTIST 42"
+	};
+	SourceModel *model;
+	GtkWidget *view;
+	const SourceModelRow *row;
+	GArray *matches;
+	GArray *found[G_N_ELEMENTS (keystrokes)];
+	guint counts[G_N_ELEMENTS (keystrokes)];
+	gboolean same = TRUE;
+	GTimer *timer;
+	gchar *title;
+	gchar *folded;
+	gchar *needle;
+	gchar *name;
+	guint i, j;
+
+	model = source_model_new ();
+	source_model_set_title_index (model, TRUE);
+	for (i = 0; i < rows; i++)
+	{
+		title = g_strdup_printf ("Track %u by Artist %u", i, i % 97);
+		name = g_strdup_printf (BENCH_ROOT "i%u", i);
+		source_model_append (model, title, name, "audio/mpeg", NULL);
+		g_free (name);
+		g_free (title);
+	}
+
+	view = gtk_tree_view_new_with_model (GTK_TREE_MODEL (model));
+	g_object_ref_sink (view);
+
+	/* Build the index outside the measurement, as browsing would */
+	g_array_free (source_model_match_titles (model, ""), TRUE);
+
+	timer = g_timer_new ();
+	for (i = 0; i < G_N_ELEMENTS (keystrokes); i++)
+	{
+		source_model_filter_titles (model, keystrokes[i]);
+		counts[i] = gtk_tree_model_iter_n_children (
+			GTK_TREE_MODEL (model), NULL);
+	}
+	source_model_filter_titles (model, NULL);
+	name = g_strdup_printf ("filter-index-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	g_timer_start (timer);
+	for (i = 0; i < G_N_ELEMENTS (keystrokes); i++)
+	{
+		needle = g_utf8_casefold (keystrokes[i], -1);
+		found[i] = g_array_new (FALSE, FALSE, sizeof (guint));
+		for (j = 0; j < rows; j++)
+		{
+			row = source_model_get_nth_row (model, j);
+			folded = g_utf8_casefold (row->title, -1);
+			if (strstr (folded, needle) != NULL)
+				g_array_append_val (found[i], j);
+			g_free (folded);
+		}
+		g_free (needle);
+	}
+	name = g_strdup_printf ("filter-linear-%u", rows);
+	add_result (name, 0.0, elapsed_ms (timer));
+	g_free (name);
+
+	/* Both must have found the same rows */
+	for (i = 0; i < G_N_ELEMENTS (keystrokes); i++)
+	{
+		matches = source_model_match_titles (model, keystrokes[i]);
+		if (counts[i] != found[i]->len ||
+		    matches->len != found[i]->len ||
+		    memcmp (matches->data, found[i]->data,
+			    matches->len * sizeof (guint)) != 0)
+		{
+			g_printerr ("Title filter showed %u rows for \"%s\", "
+				    "expected %u\n", counts[i],
+				    keystrokes[i], found[i]->len);
+			same = FALSE;
+		}
+		g_array_free (matches, TRUE);
+		g_array_free (found[i], TRUE);
+	}
+
+	g_timer_destroy (timer);
+	gtk_widget_destroy (view);
+	g_object_unref (view);
+	g_object_unref (model);
+
+	return same;
+}
+
+/*****************************************************************************
+ * Playlist workloads
+ *****************************************************************************/
+
+/**
+ * Check whether all @size rows of the playlist view have got a title
+ */
+static gboolean
+playlist_titles_complete (guint size)
+{
+	gchar *title;
+	gboolean complete = TRUE;
+	guint i;
+
+	/* Look at every row: the view fetches the titles of the rows that
+	   are looked at, so stopping at the first missing one would fetch
+	   them one by one */
+	for (i = 0; i < size; i++)
+	{
+		title = treeview_get_stored_title (i);
+		if (title == NULL)
+			complete = FALSE;
+		g_free (title);
+	}
+
+	return complete;
+}
+
+/**
+ * Run the main loop until the playlist view has all titles. Returns the
+ * elapsed time in milliseconds, or a negative value on timeout.
+ */
+static gdouble
+wait_for_titles (GTimer *timer, guint size)
+{
+	for (;;)
+	{
+		if (gtk_events_pending ())
+		{
+			gtk_main_iteration ();
+			continue;
+		}
+
+		if (playlist_titles_complete (size))
+			return elapsed_ms (timer);
+
+		if (g_timer_elapsed (timer, NULL) > BENCH_TIMEOUT)
+			return -1.0;
+
+		g_usleep (100);
+	}
+}
+
+/**
+ * Create the benchmark playlist in the playlist daemon and make it the
+ * current playlist.
+ */
+static MafwProxyPlaylist *
+setup_bench_playlist (guint size)
+{
+	MafwPlaylistManager *manager;
+	MafwProxyPlaylist *playlist;
+	GError *error = NULL;
+	GTimer *timer;
+	gchar *objectid;
+	guint i;
+
+	manager = mafw_playlist_manager_get ();
+	playlist = mafw_playlist_manager_create_playlist (
+		manager, "mafw-test-gui-bench", &error);
+	if (playlist == NULL)
+	{
+		g_printerr ("Unable to create the benchmark playlist: %s\n",
+			    error != NULL ? error->message : "unknown error");
+		if (error != NULL)
+			g_error_free (error);
+		return NULL;
+	}
+
+	mafw_playlist_clear (MAFW_PLAYLIST (playlist), NULL);
+	for (i = 0; i < size; i++)
+	{
+		/* Items that the synthetic source knows about, so that the
+		   titles can be fetched */
+		objectid = g_strdup_printf (BENCH_ROOT "i%u", i % opt_items);
+		mafw_playlist_insert_item (MAFW_PLAYLIST (playlist), i,
+					   objectid, NULL);
+		g_free (objectid);
+	}
+
+	/* The playlist combo learns about new playlists asynchronously */
+	timer = g_timer_new ();
+	while (select_playlist (playlist) == FALSE)
+	{
+		if (g_timer_elapsed (timer, NULL) > BENCH_TIMEOUT)
+		{
+			g_printerr ("Benchmark playlist never appeared\n");
+			g_timer_destroy (timer);
+			g_object_unref (playlist);
+			return NULL;
+		}
+
+		if (gtk_events_pending ())
+			gtk_main_iteration ();
+		else
+			g_usleep (1000);
+	}
+	g_timer_destroy (timer);
+	drain ();
+
+	return playlist;
+}
+
+/**
+ * Display the whole playlist from scratch
+ */
+static gboolean
+run_playlist_display (MafwProxyPlaylist *playlist, guint size)
+{
+	GTimer *timer;
+	gdouble first, total;
+
+	timer = g_timer_new ();
+	display_playlist_contents (MAFW_PLAYLIST (playlist));
+	first = elapsed_ms (timer);
+	total = wait_for_titles (timer, size);
+	g_timer_destroy (timer);
+
+	if (total < 0.0)
+	{
+		g_printerr ("Playlist titles timed out\n");
+		return FALSE;
+	}
+
+	add_result ("playlist-display", first, total);
+	return TRUE;
+}
+
+/**
+ * Feed the view a burst of one-item replacements scattered over the
+ * playlist, as if another client had edited it
+ */
+static gboolean
+run_playlist_edit (MafwProxyPlaylist *playlist, guint size)
+{
+	GTimer *timer;
+	gdouble first, total;
+	guint i;
+
+	timer = g_timer_new ();
+	for (i = 0; i < 100; i++)
+		on_mafw_playlist_contents_changed (MAFW_PLAYLIST (playlist),
+						   (i * 7919) % size, 1, 1);
+	first = elapsed_ms (timer);
+	total = wait_for_titles (timer, size);
+	g_timer_destroy (timer);
+
+	if (total < 0.0)
+	{
+		g_printerr ("Playlist titles timed out\n");
+		return FALSE;
+	}
+
+	add_result ("playlist-edit", first, total);
+	return TRUE;
+}
+
+/**
+ * Run the main loop until the visible rows of the playlist view have their
+ * titles. Returns the latency the view measured, or a negative value on
+ * timeout.
+ */
+static gdouble
+wait_for_visible_titles (void)
+{
+	GTimer *timer;
+	gdouble latency;
+
+	timer = g_timer_new ();
+	for (;;)
+	{
+		if (gtk_events_pending ())
+		{
+			gtk_main_iteration ();
+			continue;
+		}
+
+		latency = playlist_treeview_get_fetch_latency ();
+		if (latency >= 0.0 ||
+		    g_timer_elapsed (timer, NULL) > BENCH_TIMEOUT)
+			break;
+
+		g_usleep (100);
+	}
+	g_timer_destroy (timer);
+
+	return latency;
+}
+
+/**
+ * Jump around a freshly displayed playlist and measure how long the rows
+ * on the screen take to get their titles after each jump. Only the shown
+ * view has a visible range.
+ */
+static gboolean
+run_playlist_scroll (MafwProxyPlaylist *playlist, guint size)
+{
+	GtkTreePath *path;
+	gdouble first, latency, total = 0.0;
+	guint jumps = 10;
+	guint i;
+
+	display_playlist_contents (MAFW_PLAYLIST (playlist));
+	first = wait_for_visible_titles ();
+	if (first < 0.0)
+	{
+		g_printerr ("Playlist titles timed out\n");
+		return FALSE;
+	}
+
+	for (i = 1; i <= jumps; i++)
+	{
+		path = gtk_tree_path_new_from_indices (
+			(i * 7919) % size, -1);
+		gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (playlist_view),
+					      path, NULL, TRUE, 0.5, 0.0);
+		gtk_tree_path_free (path);
+
+		latency = wait_for_visible_titles ();
+		if (latency < 0.0)
+		{
+			g_printerr ("Playlist titles timed out\n");
+			return FALSE;
+		}
+		total += latency;
+	}
+
+	add_result ("playlist-scroll", first, total / jumps);
+	return TRUE;
+}
+
+/*****************************************************************************
+ * Reporting
+ *****************************************************************************/
+
+static void
+print_results (void)
+{
+	BenchResult *result;
+	guint i;
+
+	g_print ("%-24s %12s %12s %14s\n", "workload", "first (ms)",
+		 "total (ms)", "peak RSS (kB)");
+	for (i = 0; i < results->len; i++)
+	{
+		result = &g_array_index (results, BenchResult, i);
+		g_print ("%-24s %12.1f %12.1f %14ld\n", result->name,
+			 result->first, result->total, result->peak_rss);
+	}
+}
+
+static gboolean
+save_baseline (const gchar *filename)
+{
+	GKeyFile *keyfile;
+	BenchResult *result;
+	GError *error = NULL;
+	gchar *data;
+	gsize length;
+	guint i;
+
+	keyfile = g_key_file_new ();
+	for (i = 0; i < results->len; i++)
+	{
+		result = &g_array_index (results, BenchResult, i);
+		g_key_file_set_double (keyfile, result->name, "first",
+				       result->first);
+		g_key_file_set_double (keyfile, result->name, "total",
+				       result->total);
+		g_key_file_set_integer (keyfile, result->name, "peak_rss",
+					result->peak_rss);
+	}
+
+	data = g_key_file_to_data (keyfile, &length, NULL);
+	g_key_file_free (keyfile);
+
+	if (g_file_set_contents (filename, data, length, &error) == FALSE)
+	{
+		g_printerr ("Unable to save the baseline: %s\n",
+			    error->message);
+		g_error_free (error);
+		g_free (data);
+		return FALSE;
+	}
+
+	g_free (data);
+	return TRUE;
+}
+
+/**
+ * Compare the total times against the baseline.
+ *
+ * Returns the number of workloads that got slower than allowed, or -1 if
+ * the baseline could not be read
+ */
+static gint
+compare_baseline (const gchar *filename)
+{
+	GKeyFile *keyfile;
+	BenchResult *result;
+	GError *error = NULL;
+	gdouble base, limit;
+	gint regressions = 0;
+	guint i;
+
+	keyfile = g_key_file_new ();
+	if (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE,
+				       &error) == FALSE)
+	{
+		g_printerr ("Unable to read the baseline: %s\n",
+			    error->message);
+		g_error_free (error);
+		g_key_file_free (keyfile);
+		return -1;
+	}
+
+	for (i = 0; i < results->len; i++)
+	{
+		result = &g_array_index (results, BenchResult, i);
+		base = g_key_file_get_double (keyfile, result->name, "total",
+					      &error);
+		if (error != NULL)
+		{
+			/* New workload */
+			g_clear_error (&error);
+			continue;
+		}
+
+		/* Ignore differences below a millisecond, they are noise */
+		limit = base * (100 + opt_threshold) / 100.0 + 1.0;
+		if (result->total > limit)
+		{
+			g_print ("REGRESSION %s: %.1f ms, baseline %.1f ms\n",
+				 result->name, result->total, base);
+			regressions++;
+		}
+	}
+
+	g_key_file_free (keyfile);
+	return regressions;
+}
+
+/*****************************************************************************
+ * Setup
+ *****************************************************************************/
+
+static gboolean
+setup (void)
+{
+	GtkBuilder *builder;
+	MafwRegistry *registry;
+	GError *error = NULL;
+	const gchar *extra;
+	gchar *config;
+
+	builder = gtk_builder_new ();
+	if (!gtk_builder_add_from_file (builder,
+					opt_ui_file != NULL ? opt_ui_file
+					: GTK_BUILDER_FILE, &error))
+	{
+		g_printerr ("Unable to load the GUI file: %s\n",
+			    error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	/* The signal handlers are what is being measured */
+	gtk_builder_connect_signals (builder, NULL);
+
+	main_window = GTK_WIDGET (gtk_builder_get_object (builder,
+							  "main-window"));
+	treeview = GTK_WIDGET (gtk_builder_get_object (builder,
+						       "source-treeview"));
+	up_button = GTK_WIDGET (gtk_builder_get_object (builder,
+							"source-up-button"));
+	playlist_view = GTK_WIDGET (gtk_builder_get_object (
+					    builder, "playlist-treeview"));
+	g_assert (main_window != NULL && treeview != NULL &&
+		  up_button != NULL && playlist_view != NULL);
+
+	setup_source_treeview (builder);
+	setup_playlist_treeview (builder);
+	if (opt_read_ahead >= 0)
+		playlist_treeview_set_read_ahead (opt_read_ahead);
+	if (opt_no_playlist == FALSE)
+		setup_playlist_controls (builder);
+
+	if (opt_show == TRUE)
+		gtk_widget_show_all (main_window);
+
+	/* Every browse and playlist title must go to the source */
+	browse_cache_set_capacity (0);
+	title_cache_set_capacity (0);
+
+	/* The root of the synthetic source holds the browsed items. Settings
+	   from the environment, such as latency, are applied on top. */
+	extra = g_getenv (SYNTHETIC_CONFIG_ENV);
+	config = g_strdup_printf ("depth=0,items=%d,latency=0%s%s",
+				  opt_items, extra != NULL ? "," : "",
+				  extra != NULL ? extra : "");
+	g_setenv (SYNTHETIC_CONFIG_ENV, config, TRUE);
+	g_free (config);
+
+	registry = MAFW_REGISTRY (mafw_registry_get_instance ());
+	if (!mafw_registry_load_plugin (registry,
+					opt_plugin != NULL ? opt_plugin
+					: SYNTHETIC_PLUGIN, &error))
+	{
+		g_printerr ("Unable to load the synthetic plugin: %s\n",
+			    error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	bench_source = MAFW_SOURCE (mafw_registry_get_extension_by_uuid (
+					    registry, SYNTHETIC_SOURCE_UUID));
+	g_assert (bench_source != NULL);
+	add_source (bench_source);
+	drain ();
+
+	return TRUE;
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+	static const SourceModelBehaviour behaviours[] = {
+		SourceModelDetached,
+		SourceModelCached,
+		SourceModelNormal,
+		SourceModelPaged
+	};
+	GOptionContext *context;
+	GError *error = NULL;
+	MafwProxyPlaylist *playlist;
+	gint regressions = 0;
+	gint i, j;
+
+	context = g_option_context_new ("- benchmark the MAFW Test GUI views");
+	g_option_context_add_main_entries (context, entries, NULL);
+	g_option_context_add_group (context, gtk_get_option_group (TRUE));
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return 2;
+	}
+	g_option_context_free (context);
+
+	if (opt_items < 0 || opt_playlist_items <= 0 || opt_repeat <= 0)
+	{
+		g_printerr ("Item and repeat counts must be positive\n");
+		return 2;
+	}
+
+	if (opt_items == 0 && opt_no_playlist == FALSE)
+	{
+		g_printerr ("The playlist workloads need at least one item\n");
+		return 2;
+	}
+
+	g_thread_init (NULL);
+	if (!setup ())
+		return 2;
+
+	results = g_array_new (FALSE, FALSE, sizeof (BenchResult));
+
+	for (i = 0; i < opt_repeat; i++)
+	{
+		for (j = 0; j < G_N_ELEMENTS (behaviours); j++)
+		{
+			if (!run_browse (behaviours[j]))
+				return 2;
+		}
+	}
+
+	run_lookup (10000);
+	run_lookup (100000);
+	run_scroll (10000);
+	if (!run_title_filter (100000))
+		return 2;
+
+	if (opt_no_playlist == FALSE)
+	{
+		playlist = setup_bench_playlist (opt_playlist_items);
+		if (playlist == NULL)
+			return 2;
+
+		for (i = 0; i < opt_repeat; i++)
+		{
+			if (!run_playlist_display (playlist,
+						   opt_playlist_items) ||
+			    !run_playlist_edit (playlist, opt_playlist_items))
+				return 2;
+
+			if (opt_show == TRUE &&
+			    !run_playlist_scroll (playlist,
+						  opt_playlist_items))
+				return 2;
+		}
+
+		g_object_unref (playlist);
+	}
+
+	print_results ();
+
+	if (opt_save_baseline != NULL && !save_baseline (opt_save_baseline))
+		return 2;
+
+	if (opt_baseline != NULL)
+	{
+		regressions = compare_baseline (opt_baseline);
+		if (regressions < 0)
+			return 2;
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
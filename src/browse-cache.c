@@ -0,0 +1,351 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <config.h>
+
+#include "browse-cache.h"
+
+/*****************************************************************************
+ * Browse cache
+ *
+ * Keeps the contents of the most recently browsed containers so that going
+ * back to them does not require browsing them again. The least recently used
+ * container is evicted when the cache is full.
+ *****************************************************************************/
+
+typedef struct _BrowseCacheEntry
+{
+	/** Object ID of the cached container */
+	gchar *objectid;
+
+	/** Copy of the container's contents */
+	SourceModel *contents;
+
+} BrowseCacheEntry;
+
+/** Entries in LRU order, the most recently used one at the head */
+static GQueue *lru = NULL;
+
+/** Object ID -> GList link in the lru queue */
+static GHashTable *by_objectid = NULL;
+
+/** Item object ID -> set of the cached containers' object IDs it is in */
+static GHashTable *containers_of = NULL;
+
+static guint capacity = BROWSE_CACHE_DEFAULT_CAPACITY;
+static guint hits = 0;
+static guint misses = 0;
+
+static void
+browse_cache_init (void)
+{
+	if (lru != NULL)
+		return;
+
+	lru = g_queue_new ();
+	by_objectid = g_hash_table_new (g_str_hash, g_str_equal);
+	containers_of = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free,
+					       (GDestroyNotify)
+					       g_hash_table_destroy);
+}
+
+/**
+ * Add the items of @entry to the item -> containers index
+ */
+static void
+index_add (BrowseCacheEntry *entry)
+{
+	const SourceModelRow *row;
+	GHashTable *containers;
+	guint i, length;
+
+	length = source_model_get_length (entry->contents);
+	for (i = 0; i < length; i++)
+	{
+		row = source_model_get_nth_row (entry->contents, i);
+		if (row->objectid == NULL)
+			continue;
+
+		containers = g_hash_table_lookup (containers_of,
+						  row->objectid);
+		if (containers == NULL)
+		{
+			containers = g_hash_table_new (g_str_hash,
+						       g_str_equal);
+			g_hash_table_insert (containers_of,
+					     g_strdup (row->objectid),
+					     containers);
+		}
+
+		/* Keys are owned by the entries */
+		g_hash_table_insert (containers, entry->objectid,
+				     entry->objectid);
+	}
+}
+
+/**
+ * Remove the items of @entry from the item -> containers index
+ */
+static void
+index_remove (BrowseCacheEntry *entry)
+{
+	const SourceModelRow *row;
+	GHashTable *containers;
+	guint i, length;
+
+	length = source_model_get_length (entry->contents);
+	for (i = 0; i < length; i++)
+	{
+		row = source_model_get_nth_row (entry->contents, i);
+		if (row->objectid == NULL)
+			continue;
+
+		containers = g_hash_table_lookup (containers_of,
+						  row->objectid);
+		if (containers == NULL)
+			continue;
+
+		g_hash_table_remove (containers, entry->objectid);
+		if (g_hash_table_size (containers) == 0)
+			g_hash_table_remove (containers_of, row->objectid);
+	}
+}
+
+static void
+entry_free (BrowseCacheEntry *entry)
+{
+	g_object_unref (entry->contents);
+	g_free (entry->objectid);
+	g_free (entry);
+}
+
+/**
+ * Drop the entry at @link from the cache
+ */
+static void
+remove_link (GList *link)
+{
+	BrowseCacheEntry *entry = link->data;
+
+	index_remove (entry);
+	g_hash_table_remove (by_objectid, entry->objectid);
+	g_queue_delete_link (lru, link);
+	entry_free (entry);
+}
+
+/**
+ * Evict the least recently used entries until there are at most @size left
+ */
+static void
+shrink (guint size)
+{
+	while (g_queue_get_length (lru) > size)
+		remove_link (g_queue_peek_tail_link (lru));
+}
+
+/**
+ * Store a copy of @model's contents as the contents of the container
+ * @objectid, replacing any older copy.
+ */
+void
+browse_cache_store (const gchar *objectid, SourceModel *model)
+{
+	BrowseCacheEntry *entry;
+	GList *link;
+
+	g_return_if_fail (objectid != NULL);
+	g_return_if_fail (SOURCE_IS_MODEL (model));
+
+	browse_cache_init ();
+	if (capacity == 0)
+		return;
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link != NULL)
+	{
+		/* Reuse the entry and make it the most recent one */
+		entry = link->data;
+		g_queue_unlink (lru, link);
+		g_queue_push_head_link (lru, link);
+		index_remove (entry);
+	}
+	else
+	{
+		shrink (capacity - 1);
+
+		entry = g_new0 (BrowseCacheEntry, 1);
+		entry->objectid = g_strdup (objectid);
+		entry->contents = source_model_new ();
+		g_queue_push_head (lru, entry);
+		g_hash_table_insert (by_objectid, entry->objectid,
+				     g_queue_peek_head_link (lru));
+	}
+
+	source_model_copy (entry->contents, model);
+	index_add (entry);
+}
+
+/**
+ * Replace @model's contents with the cached contents of the container
+ * @objectid.
+ *
+ * Returns %TRUE on a cache hit. On a miss @model is left untouched.
+ */
+gboolean
+browse_cache_restore (const gchar *objectid, SourceModel *model)
+{
+	BrowseCacheEntry *entry;
+	GList *link;
+
+	g_return_val_if_fail (objectid != NULL, FALSE);
+	g_return_val_if_fail (SOURCE_IS_MODEL (model), FALSE);
+
+	browse_cache_init ();
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link == NULL)
+	{
+		misses++;
+		return FALSE;
+	}
+
+	hits++;
+
+	entry = link->data;
+	g_queue_unlink (lru, link);
+	g_queue_push_head_link (lru, link);
+
+	source_model_copy (model, entry->contents);
+
+	return TRUE;
+}
+
+/**
+ * Check whether the contents of the container @objectid are cached, without
+ * counting a hit or a miss.
+ */
+gboolean
+browse_cache_contains (const gchar *objectid)
+{
+	g_return_val_if_fail (objectid != NULL, FALSE);
+
+	if (lru == NULL)
+		return FALSE;
+
+	return g_hash_table_lookup (by_objectid, objectid) != NULL;
+}
+
+/**
+ * Forget the cached contents of the container @objectid
+ */
+void
+browse_cache_invalidate (const gchar *objectid)
+{
+	GList *link;
+
+	g_return_if_fail (objectid != NULL);
+
+	if (lru == NULL)
+		return;
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link != NULL)
+		remove_link (link);
+}
+
+/**
+ * Forget the cached contents of all containers that include the object
+ * @objectid, since their copy of its metadata is out of date.
+ */
+void
+browse_cache_invalidate_item (const gchar *objectid)
+{
+	GHashTable *containers;
+	GHashTableIter iter;
+	GList *links, *link;
+	gpointer container;
+
+	g_return_if_fail (objectid != NULL);
+
+	if (lru == NULL)
+		return;
+
+	containers = g_hash_table_lookup (containers_of, objectid);
+	if (containers == NULL)
+		return;
+
+	/* Removing the entries modifies the set, so collect them first */
+	links = NULL;
+	g_hash_table_iter_init (&iter, containers);
+	while (g_hash_table_iter_next (&iter, &container, NULL) == TRUE)
+		links = g_list_prepend (links,
+					g_hash_table_lookup (by_objectid,
+							     container));
+
+	for (link = links; link != NULL; link = link->next)
+		remove_link (link->data);
+	g_list_free (links);
+}
+
+/**
+ * Empty the cache. The hit and miss counters are not reset.
+ */
+void
+browse_cache_clear (void)
+{
+	if (lru == NULL)
+		return;
+
+	shrink (0);
+}
+
+/**
+ * Set the maximum number of cached containers. Zero disables the cache.
+ */
+void
+browse_cache_set_capacity (guint new_capacity)
+{
+	capacity = new_capacity;
+
+	if (lru != NULL)
+		shrink (capacity);
+}
+
+/**
+ * Get the current number of cached containers, the maximum number of them,
+ * and the number of cache hits and misses so far. Any of the return
+ * locations can be %NULL.
+ */
+void
+browse_cache_get_stats (guint *size, guint *max_size, guint *hit_count,
+			guint *miss_count)
+{
+	if (size != NULL)
+		*size = lru != NULL ? g_queue_get_length (lru) : 0;
+	if (max_size != NULL)
+		*max_size = capacity;
+	if (hit_count != NULL)
+		*hit_count = hits;
+	if (miss_count != NULL)
+		*miss_count = misses;
+}
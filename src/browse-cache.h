@@ -0,0 +1,45 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __BROWSECACHE_H__
+#define __BROWSECACHE_H__
+
+#include <config.h>
+#include <glib.h>
+
+#include "source-model.h"
+
+/** Number of containers kept in the browse cache */
+#define BROWSE_CACHE_DEFAULT_CAPACITY 16
+
+void browse_cache_store(const gchar *objectid, SourceModel *model);
+gboolean browse_cache_restore(const gchar *objectid, SourceModel *model);
+gboolean browse_cache_contains(const gchar *objectid);
+void browse_cache_invalidate(const gchar *objectid);
+void browse_cache_invalidate_item(const gchar *objectid);
+void browse_cache_clear(void);
+
+void browse_cache_set_capacity(guint new_capacity);
+void browse_cache_get_stats(guint *size, guint *max_size, guint *hit_count,
+			    guint *miss_count);
+
+#endif /* __BROWSECACHE_H__ */
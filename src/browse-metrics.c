@@ -0,0 +1,505 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <config.h>
+
+#include "browse-metrics.h"
+
+/*****************************************************************************
+ * Browse metrics
+ *
+ * Measures how long browsing takes, from the browse request to the first and
+ * the last result, and how evenly the results arrive. Each completed browse
+ * is kept for the rest of the session, together with totals for each source
+ * and model behaviour, so that they can be saved and compared later.
+ *****************************************************************************/
+
+/** One completed browse */
+typedef struct _BrowseRun
+{
+	gchar *uuid;
+	SourceModelBehaviour behaviour;
+
+	/** Number of results */
+	guint items;
+
+	/** Seconds from the request to the first and the last result */
+	gdouble first;
+	gdouble last;
+
+	/** Percentiles of the time between consecutive results, seconds */
+	gdouble gap_p50;
+	gdouble gap_p90;
+	gdouble gap_p99;
+	gdouble gap_max;
+
+} BrowseRun;
+
+/** Totals of all browses of one source with one model behaviour */
+typedef struct _BrowseGroup
+{
+	gchar *uuid;
+	SourceModelBehaviour behaviour;
+
+	guint runs;
+	guint items;
+	gdouble first_total;
+	gdouble last_total;
+
+	/** All gaps between results, seconds */
+	GArray *gaps;
+
+} BrowseGroup;
+
+/** The browse being measured, if active is set */
+static struct {
+	gboolean active;
+	gchar *uuid;
+	SourceModelBehaviour behaviour;
+	gdouble start;
+	gdouble first;
+	gdouble previous;
+	guint items;
+	GArray *gaps;
+} current;
+
+/** BrowseRun array of the session */
+static GArray *runs = NULL;
+
+/** BrowseGroup pointers of the session */
+static GPtrArray *groups = NULL;
+
+/**
+ * Get the current time in seconds from a clock that never jumps
+ */
+static gdouble
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a;
+	gdouble y = *(const gdouble *) b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * Get the @p percentile of the sorted @values, 0 if there are none
+ */
+static gdouble
+percentile (GArray *values, guint p)
+{
+	guint i;
+
+	if (values->len == 0)
+		return 0.0;
+
+	/* Nearest rank */
+	i = (values->len * p + 99) / 100;
+	return g_array_index (values, gdouble, MAX (i, 1) - 1);
+}
+
+static BrowseGroup *
+find_group (const gchar *uuid, SourceModelBehaviour behaviour)
+{
+	BrowseGroup *group;
+	guint i;
+
+	for (i = 0; i < groups->len; i++)
+	{
+		group = g_ptr_array_index (groups, i);
+		if (group->behaviour == behaviour &&
+		    strcmp (group->uuid, uuid) == 0)
+			return group;
+	}
+
+	group = g_new0 (BrowseGroup, 1);
+	group->uuid = g_strdup (uuid);
+	group->behaviour = behaviour;
+	group->gaps = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	g_ptr_array_add (groups, group);
+
+	return group;
+}
+
+/**
+ * Start measuring a browse of the container @objectid in the given model
+ * behaviour. A measurement that is still going on is discarded.
+ */
+void
+browse_metrics_start (const gchar *objectid, SourceModelBehaviour behaviour)
+{
+	browse_metrics_cancel ();
+
+	if (current.gaps == NULL)
+		current.gaps = g_array_new (FALSE, FALSE, sizeof (gdouble));
+
+	mafw_source_split_objectid (objectid, &current.uuid, NULL);
+	if (current.uuid == NULL)
+		current.uuid = g_strdup ("");
+
+	current.behaviour = behaviour;
+	current.items = 0;
+	current.first = 0.0;
+	current.start = current.previous = now ();
+	current.active = TRUE;
+}
+
+/**
+ * A browse result has arrived
+ */
+void
+browse_metrics_result (void)
+{
+	gdouble t, gap;
+
+	if (current.active == FALSE)
+		return;
+
+	t = now ();
+	if (current.items == 0)
+	{
+		current.first = t - current.start;
+	}
+	else
+	{
+		gap = t - current.previous;
+		g_array_append_val (current.gaps, gap);
+	}
+
+	current.previous = t;
+	current.items++;
+}
+
+/**
+ * The last browse result has arrived. Store the measurement.
+ */
+void
+browse_metrics_end (void)
+{
+	BrowseRun run;
+	BrowseGroup *group;
+
+	if (current.active == FALSE)
+		return;
+
+	if (runs == NULL)
+	{
+		runs = g_array_new (FALSE, FALSE, sizeof (BrowseRun));
+		groups = g_ptr_array_new ();
+	}
+
+	memset (&run, 0, sizeof (run));
+	run.uuid = current.uuid;
+	run.behaviour = current.behaviour;
+	run.items = current.items;
+	run.first = current.first;
+	run.last = current.previous - current.start;
+
+	group = find_group (run.uuid, run.behaviour);
+	group->runs++;
+	group->items += run.items;
+	group->first_total += run.first;
+	group->last_total += run.last;
+	g_array_append_vals (group->gaps, current.gaps->data,
+			     current.gaps->len);
+
+	g_array_sort (current.gaps, compare_doubles);
+	run.gap_p50 = percentile (current.gaps, 50);
+	run.gap_p90 = percentile (current.gaps, 90);
+	run.gap_p99 = percentile (current.gaps, 99);
+	run.gap_max = percentile (current.gaps, 100);
+	g_array_append_val (runs, run);
+
+	g_print ("\nBrowsed %u items from %s (%s): first result in %.3f s, "
+		 "last in %.3f s, %.1f items/s\n", run.items, run.uuid,
+		 source_treeview_behaviour_name (run.behaviour),
+		 run.first, run.last,
+		 run.last > 0.0 ? run.items / run.last : 0.0);
+
+	/* The run owns the UUID now */
+	current.uuid = NULL;
+	g_array_set_size (current.gaps, 0);
+	current.active = FALSE;
+}
+
+/**
+ * Discard the current measurement, if any
+ */
+void
+browse_metrics_cancel (void)
+{
+	g_free (current.uuid);
+	current.uuid = NULL;
+	if (current.gaps != NULL)
+		g_array_set_size (current.gaps, 0);
+	current.active = FALSE;
+}
+
+/**
+ * Forget all the measurements of the session
+ */
+void
+browse_metrics_clear (void)
+{
+	BrowseGroup *group;
+	guint i;
+
+	if (runs == NULL)
+		return;
+
+	for (i = 0; i < runs->len; i++)
+		g_free (g_array_index (runs, BrowseRun, i).uuid);
+	g_array_set_size (runs, 0);
+
+	for (i = 0; i < groups->len; i++)
+	{
+		group = g_ptr_array_index (groups, i);
+		g_array_free (group->gaps, TRUE);
+		g_free (group->uuid);
+		g_free (group);
+	}
+	g_ptr_array_set_size (groups, 0);
+}
+
+/*****************************************************************************
+ * Reports
+ *****************************************************************************/
+
+static gdouble
+items_per_second (guint items, gdouble seconds)
+{
+	return seconds > 0.0 ? items / seconds : 0.0;
+}
+
+/** Text of one number in a report */
+typedef gchar NumberText[G_ASCII_DTOSTR_BUF_SIZE];
+
+/**
+ * Format @value with the printf() @format into @text. The decimal separator
+ * is always a dot, whatever the locale.
+ */
+static const gchar *
+format_number (NumberText text, const gchar *format, gdouble value)
+{
+	return g_ascii_formatd (text, G_ASCII_DTOSTR_BUF_SIZE, format, value);
+}
+
+/**
+ * Format the times of a run or a group, given in seconds, as milliseconds,
+ * and its rate for a report
+ */
+static void
+format_times (NumberText *texts, gdouble first, gdouble last, gdouble rate,
+	      gdouble p50, gdouble p90, gdouble p99, gdouble max)
+{
+	format_number (texts[0], "%.3f", first * 1000);
+	format_number (texts[1], "%.3f", last * 1000);
+	format_number (texts[2], "%.1f", rate);
+	format_number (texts[3], "%.3f", p50 * 1000);
+	format_number (texts[4], "%.3f", p90 * 1000);
+	format_number (texts[5], "%.3f", p99 * 1000);
+	format_number (texts[6], "%.3f", max * 1000);
+}
+
+/**
+ * Sort the gaps of @group and get their percentiles
+ */
+static void
+group_gaps (BrowseGroup *group, gdouble *p50, gdouble *p90, gdouble *p99,
+	    gdouble *max)
+{
+	g_array_sort (group->gaps, compare_doubles);
+	*p50 = percentile (group->gaps, 50);
+	*p90 = percentile (group->gaps, 90);
+	*p99 = percentile (group->gaps, 99);
+	*max = percentile (group->gaps, 100);
+}
+
+/**
+ * Get all measurements as CSV. Each browse is on its own "run" line, and
+ * the totals for each source and behaviour are on "total" lines. Times are
+ * in milliseconds.
+ *
+ * Returns a newly allocated string
+ */
+gchar *
+browse_metrics_to_csv (void)
+{
+	GString *csv;
+	BrowseRun *run;
+	BrowseGroup *group;
+	gdouble p50, p90, p99, max;
+	NumberText t[7];
+	guint i;
+
+	csv = g_string_new ("record,uuid,behaviour,runs,items,"
+			    "first_ms,last_ms,items_per_s,"
+			    "gap_p50_ms,gap_p90_ms,gap_p99_ms,gap_max_ms\n");
+	if (runs == NULL)
+		return g_string_free (csv, FALSE);
+
+	for (i = 0; i < runs->len; i++)
+	{
+		run = &g_array_index (runs, BrowseRun, i);
+		format_times (t, run->first, run->last,
+			      items_per_second (run->items, run->last),
+			      run->gap_p50, run->gap_p90, run->gap_p99,
+			      run->gap_max);
+		g_string_append_printf (
+			csv, "run,%s,%s,1,%u,%s,%s,%s,%s,%s,%s,%s\n",
+			run->uuid,
+			source_treeview_behaviour_name (run->behaviour),
+			run->items, t[0], t[1], t[2], t[3], t[4], t[5], t[6]);
+	}
+
+	for (i = 0; i < groups->len; i++)
+	{
+		group = g_ptr_array_index (groups, i);
+		group_gaps (group, &p50, &p90, &p99, &max);
+
+		/* Times are averages over the runs */
+		format_times (t, group->first_total / group->runs,
+			      group->last_total / group->runs,
+			      items_per_second (group->items,
+						group->last_total),
+			      p50, p90, p99, max);
+		g_string_append_printf (
+			csv, "total,%s,%s,%u,%u,%s,%s,%s,%s,%s,%s,%s\n",
+			group->uuid,
+			source_treeview_behaviour_name (group->behaviour),
+			group->runs, group->items,
+			t[0], t[1], t[2], t[3], t[4], t[5], t[6]);
+	}
+
+	return g_string_free (csv, FALSE);
+}
+
+/**
+ * Get all measurements as JSON, with the same contents as
+ * browse_metrics_to_csv().
+ *
+ * Returns a newly allocated string
+ */
+gchar *
+browse_metrics_to_json (void)
+{
+	GString *json;
+	BrowseRun *run;
+	BrowseGroup *group;
+	gdouble p50, p90, p99, max;
+	NumberText t[7];
+	gchar *uuid;
+	guint i;
+
+	json = g_string_new ("{\n  \"runs\": [");
+
+	for (i = 0; runs != NULL && i < runs->len; i++)
+	{
+		run = &g_array_index (runs, BrowseRun, i);
+		uuid = g_strescape (run->uuid, NULL);
+		format_times (t, run->first, run->last,
+			      items_per_second (run->items, run->last),
+			      run->gap_p50, run->gap_p90, run->gap_p99,
+			      run->gap_max);
+		g_string_append_printf (
+			json, "%s\n    {\"uuid\": \"%s\", "
+			"\"behaviour\": \"%s\", "
+			"\"items\": %u, \"first_ms\": %s, "
+			"\"last_ms\": %s, \"items_per_s\": %s, "
+			"\"gap_p50_ms\": %s, \"gap_p90_ms\": %s, "
+			"\"gap_p99_ms\": %s, \"gap_max_ms\": %s}",
+			i > 0 ? "," : "", uuid,
+			source_treeview_behaviour_name (run->behaviour),
+			run->items, t[0], t[1], t[2], t[3], t[4], t[5], t[6]);
+		g_free (uuid);
+	}
+
+	g_string_append (json, "\n  ],\n  \"totals\": [");
+
+	for (i = 0; groups != NULL && i < groups->len; i++)
+	{
+		group = g_ptr_array_index (groups, i);
+		group_gaps (group, &p50, &p90, &p99, &max);
+		uuid = g_strescape (group->uuid, NULL);
+		format_times (t, group->first_total / group->runs,
+			      group->last_total / group->runs,
+			      items_per_second (group->items,
+						group->last_total),
+			      p50, p90, p99, max);
+		g_string_append_printf (
+			json, "%s\n    {\"uuid\": \"%s\", "
+			"\"behaviour\": \"%s\", "
+			"\"runs\": %u, \"items\": %u, "
+			"\"first_ms\": %s, \"last_ms\": %s, "
+			"\"items_per_s\": %s, "
+			"\"gap_p50_ms\": %s, \"gap_p90_ms\": %s, "
+			"\"gap_p99_ms\": %s, \"gap_max_ms\": %s}",
+			i > 0 ? "," : "", uuid,
+			source_treeview_behaviour_name (group->behaviour),
+			group->runs, group->items,
+			t[0], t[1], t[2], t[3], t[4], t[5], t[6]);
+		g_free (uuid);
+	}
+
+	g_string_append (json, "\n  ]\n}\n");
+
+	return g_string_free (json, FALSE);
+}
+
+/**
+ * Write the measurements to @basename.csv and @basename.json
+ */
+gboolean
+browse_metrics_save (const gchar *basename, GError **error)
+{
+	gchar *path;
+	gchar *contents;
+	gboolean ok;
+
+	path = g_strconcat (basename, ".csv", NULL);
+	contents = browse_metrics_to_csv ();
+	ok = g_file_set_contents (path, contents, -1, error);
+	g_free (contents);
+	g_free (path);
+
+	if (ok == FALSE)
+		return FALSE;
+
+	path = g_strconcat (basename, ".json", NULL);
+	contents = browse_metrics_to_json ();
+	ok = g_file_set_contents (path, contents, -1, error);
+	g_free (contents);
+	g_free (path);
+
+	return ok;
+}
@@ -0,0 +1,42 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __BROWSEMETRICS_H__
+#define __BROWSEMETRICS_H__
+
+#include <config.h>
+#include <glib.h>
+
+#include "source-treeview.h"
+
+void browse_metrics_start(const gchar *objectid,
+			  SourceModelBehaviour behaviour);
+void browse_metrics_result(void);
+void browse_metrics_end(void);
+void browse_metrics_cancel(void);
+
+gchar *browse_metrics_to_csv(void);
+gchar *browse_metrics_to_json(void);
+gboolean browse_metrics_save(const gchar *basename, GError **error);
+void browse_metrics_clear(void);
+
+#endif /* __BROWSEMETRICS_H__ */
@@ -0,0 +1,548 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include "browse-scheduler.h"
+
+/*****************************************************************************
+ * Browse scheduler
+ *
+ * All browse requests of the source view go through here. The scheduler
+ * limits the number of browses running at once on each source and queues the
+ * rest by priority, so that the browse the user is waiting for is not stuck
+ * behind speculative ones.
+ *
+ * Each request is tagged with the generation that was current when it was
+ * submitted. Starting a new generation, which the view does whenever it
+ * navigates, cancels the navigation and refresh requests of the older ones.
+ * Prefetches are left alone, since they are for the navigation to come.
+ *
+ * Callers see request IDs instead of the sources' browse IDs. The browse
+ * callback is invoked with the request ID as the browse ID, so request IDs
+ * can be used wherever a browse ID would be.
+ *****************************************************************************/
+
+/** Requests for one source */
+typedef struct _SourceQueue
+{
+	/** Number of requests running */
+	guint running;
+
+	/** BrowseRequests waiting to be started, in submission order */
+	GQueue *waiting;
+
+} SourceQueue;
+
+typedef struct _BrowseRequest
+{
+	guint id;
+	guint generation;
+	BrowsePriority priority;
+
+	MafwSource *source;
+	SourceQueue *queue;
+
+	gchar *objectid;
+	gboolean recursive;
+	gchar *filter;
+	gchar *sort_criteria;
+	gchar **metadata_keys;
+	guint skip_count;
+	guint item_count;
+
+	MafwSourceBrowseResultCb callback;
+	gpointer user_data;
+
+	/** The source's browse ID while running */
+	guint browse_id;
+	gboolean running;
+
+} BrowseRequest;
+
+/** Request ID -> BrowseRequest, for all queued and running requests */
+static GHashTable *requests = NULL;
+
+/** Source UUID -> SourceQueue */
+static GHashTable *queues = NULL;
+
+static guint limit = BROWSE_SCHEDULER_DEFAULT_LIMIT;
+static guint generation = 0;
+static guint next_request_id = 1;
+
+/** Request being started from browse_scheduler_submit(), 0 if none */
+static guint submitting_id = 0;
+static gboolean submit_failed = FALSE;
+
+static guint started = 0;
+static guint cancelled = 0;
+static guint wasted = 0;
+
+static void start_waiting (SourceQueue *queue);
+
+static void
+browse_scheduler_init (void)
+{
+	if (requests != NULL)
+		return;
+
+	requests = g_hash_table_new (g_direct_hash, g_direct_equal);
+	queues = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static SourceQueue *
+get_queue (MafwSource *source)
+{
+	SourceQueue *queue;
+	const gchar *uuid;
+
+	uuid = mafw_extension_get_uuid (MAFW_EXTENSION (source));
+	queue = g_hash_table_lookup (queues, uuid);
+	if (queue == NULL)
+	{
+		queue = g_new0 (SourceQueue, 1);
+		queue->waiting = g_queue_new ();
+		g_hash_table_insert (queues, g_strdup (uuid), queue);
+	}
+
+	return queue;
+}
+
+static void
+request_free (BrowseRequest *request)
+{
+	g_object_unref (request->source);
+	g_free (request->objectid);
+	g_free (request->filter);
+	g_free (request->sort_criteria);
+	g_strfreev (request->metadata_keys);
+	g_free (request);
+}
+
+/**
+ * Forget a request that has finished or been cancelled. The caller starts
+ * the next waiting request when it is safe to do so.
+ */
+static void
+request_remove (BrowseRequest *request)
+{
+	g_hash_table_remove (requests, GUINT_TO_POINTER (request->id));
+
+	if (request->running == TRUE)
+		request->queue->running--;
+	else
+		g_queue_remove (request->queue->waiting, request);
+}
+
+/**
+ * Browse result callback for all the requests. Passes the results on with
+ * the request ID in place of the browse ID.
+ */
+static void
+scheduler_browse_cb (MafwSource *source, guint browse_id,
+		     gint remaining_count, guint index, const gchar *objectid,
+		     GHashTable *metadata, gpointer user_data,
+		     const GError *error)
+{
+	BrowseRequest *request;
+	MafwSourceBrowseResultCb callback;
+	SourceQueue *queue;
+	gpointer callback_data;
+	guint request_id;
+
+	request = g_hash_table_lookup (requests, user_data);
+	if (request == NULL)
+	{
+		/* Still on its way when the request was cancelled */
+		if (objectid != NULL)
+			wasted++;
+		return;
+	}
+
+	request_id = request->id;
+	callback = request->callback;
+	callback_data = request->user_data;
+	queue = request->queue;
+
+	/* A source that fails right away gets the invalid browse ID passed
+	   on, just as it would without the scheduler */
+	if (error != NULL && request_id == submitting_id)
+	{
+		request_id = MAFW_SOURCE_INVALID_BROWSE_ID;
+		submit_failed = TRUE;
+	}
+
+	if (error != NULL || remaining_count == 0)
+	{
+		request_remove (request);
+		request_free (request);
+		request = NULL;
+	}
+
+	callback (source, request_id, remaining_count, index, objectid,
+		  metadata, callback_data, error);
+
+	if (request == NULL)
+		start_waiting (queue);
+}
+
+/**
+ * Start @request. Returns %FALSE if the source refused it, in which case
+ * the request has been removed.
+ */
+static gboolean
+request_start (BrowseRequest *request)
+{
+	MafwFilter *filter = NULL;
+	guint request_id = request->id;
+	guint browse_id;
+
+	g_queue_remove (request->queue->waiting, request);
+	request->queue->running++;
+	request->running = TRUE;
+	started++;
+
+	if (request->filter != NULL)
+		filter = mafw_filter_parse (request->filter);
+
+	browse_id = mafw_source_browse (request->source, request->objectid,
+					request->recursive, filter,
+					request->sort_criteria,
+					(const gchar *const *)
+					request->metadata_keys,
+					request->skip_count,
+					request->item_count,
+					scheduler_browse_cb,
+					GUINT_TO_POINTER (request_id));
+
+	if (filter != NULL)
+		mafw_filter_free (filter);
+
+	/* The source may have called back already */
+	request = g_hash_table_lookup (requests,
+				       GUINT_TO_POINTER (request_id));
+	if (request == NULL)
+		return browse_id != MAFW_SOURCE_INVALID_BROWSE_ID;
+
+	if (browse_id == MAFW_SOURCE_INVALID_BROWSE_ID)
+	{
+		MafwSourceBrowseResultCb callback = request->callback;
+		gpointer callback_data = request->user_data;
+		MafwSource *source = g_object_ref (request->source);
+		GError *error = NULL;
+
+		request_remove (request);
+		request_free (request);
+
+		if (request_id == submitting_id)
+		{
+			/* The caller sees the invalid browse ID */
+			submit_failed = TRUE;
+		}
+		else
+		{
+			/* The caller is waiting for results */
+			g_set_error (&error, MAFW_SOURCE_ERROR,
+				     MAFW_SOURCE_ERROR_BROWSE_RESULT_FAILED,
+				     "Unable to browse");
+			callback (source, request_id, 0, 0, NULL, NULL,
+				  callback_data, error);
+			g_error_free (error);
+		}
+
+		g_object_unref (source);
+		return FALSE;
+	}
+
+	request->browse_id = browse_id;
+	return TRUE;
+}
+
+/**
+ * Take the waiting request with the highest priority, the oldest one among
+ * equals.
+ */
+static BrowseRequest *
+pick_waiting (SourceQueue *queue)
+{
+	BrowseRequest *best = NULL;
+	BrowseRequest *request;
+	GList *link;
+
+	for (link = queue->waiting->head; link != NULL; link = link->next)
+	{
+		request = link->data;
+		if (best == NULL || request->priority > best->priority)
+			best = request;
+	}
+
+	return best;
+}
+
+/**
+ * Start waiting requests of @queue while there is room for them
+ */
+static void
+start_waiting (SourceQueue *queue)
+{
+	BrowseRequest *request;
+
+	while (limit == 0 || queue->running < limit)
+	{
+		request = pick_waiting (queue);
+		if (request == NULL)
+			break;
+
+		request_start (request);
+	}
+}
+
+/**
+ * Cancel a queued or running request without calling its callback
+ */
+static gboolean
+request_cancel (BrowseRequest *request, GError **error)
+{
+	SourceQueue *queue = request->queue;
+	gboolean success = TRUE;
+
+	if (request->running == TRUE)
+	{
+		success = mafw_source_cancel_browse (request->source,
+						     request->browse_id,
+						     error);
+	}
+
+	cancelled++;
+	request_remove (request);
+	request_free (request);
+
+	start_waiting (queue);
+
+	return success;
+}
+
+/**
+ * Submit a browse request. The arguments are the same as for
+ * mafw_source_browse(), except that the filter is given in its string form
+ * and @metadata_keys must be a %NULL-terminated list.
+ *
+ * Returns a request ID that stands for the browse ID both in the callback
+ * and in browse_scheduler_cancel(), or %MAFW_SOURCE_INVALID_BROWSE_ID if the
+ * request was started right away and the source refused it.
+ */
+guint
+browse_scheduler_submit (MafwSource *source, const gchar *objectid,
+			 gboolean recursive, const gchar *filter,
+			 const gchar *sort_criteria,
+			 const gchar *const *metadata_keys,
+			 guint skip_count, guint item_count,
+			 BrowsePriority priority,
+			 MafwSourceBrowseResultCb browse_cb, gpointer user_data)
+{
+	BrowseRequest *request;
+	guint request_id;
+	guint saved_id;
+	gboolean saved_failed;
+	gboolean failed;
+
+	g_return_val_if_fail (source != NULL,
+			      MAFW_SOURCE_INVALID_BROWSE_ID);
+	g_return_val_if_fail (objectid != NULL,
+			      MAFW_SOURCE_INVALID_BROWSE_ID);
+	g_return_val_if_fail (browse_cb != NULL,
+			      MAFW_SOURCE_INVALID_BROWSE_ID);
+
+	browse_scheduler_init ();
+
+	request = g_new0 (BrowseRequest, 1);
+	request->id = next_request_id++;
+	if (next_request_id == MAFW_SOURCE_INVALID_BROWSE_ID)
+		next_request_id = 1;
+	request->generation = generation;
+	request->priority = priority;
+	request->source = g_object_ref (source);
+	request->queue = get_queue (source);
+	request->objectid = g_strdup (objectid);
+	request->recursive = recursive;
+	request->filter = g_strdup (filter);
+	request->sort_criteria = g_strdup (sort_criteria);
+	request->metadata_keys = g_strdupv ((gchar **) metadata_keys);
+	request->skip_count = skip_count;
+	request->item_count = item_count;
+	request->callback = browse_cb;
+	request->user_data = user_data;
+	request->browse_id = MAFW_SOURCE_INVALID_BROWSE_ID;
+
+	request_id = request->id;
+	g_hash_table_insert (requests, GUINT_TO_POINTER (request_id),
+			     request);
+	g_queue_push_tail (request->queue->waiting, request);
+
+	/* Callbacks may submit more requests from within */
+	saved_id = submitting_id;
+	saved_failed = submit_failed;
+
+	submitting_id = request_id;
+	submit_failed = FALSE;
+	start_waiting (request->queue);
+	failed = submit_failed;
+
+	submitting_id = saved_id;
+	submit_failed = saved_failed;
+
+	return failed ? MAFW_SOURCE_INVALID_BROWSE_ID : request_id;
+}
+
+/**
+ * Cancel a queued or running request. Its callback is not called anymore,
+ * even if the source fails to cancel the browse.
+ */
+gboolean
+browse_scheduler_cancel (guint request_id, GError **error)
+{
+	BrowseRequest *request;
+
+	if (requests == NULL)
+		return TRUE;
+
+	request = g_hash_table_lookup (requests,
+				       GUINT_TO_POINTER (request_id));
+	if (request == NULL)
+		return TRUE;
+
+	return request_cancel (request, error);
+}
+
+/**
+ * Turn a request into a navigation request of the current generation. Used
+ * when the view takes over a prefetch.
+ */
+void
+browse_scheduler_promote (guint request_id)
+{
+	BrowseRequest *request;
+
+	if (requests == NULL)
+		return;
+
+	request = g_hash_table_lookup (requests,
+				       GUINT_TO_POINTER (request_id));
+	if (request == NULL)
+		return;
+
+	request->priority = BrowsePriorityNavigation;
+	request->generation = generation;
+}
+
+/**
+ * Start a new generation and cancel the navigation and refresh requests of
+ * the older ones, which the view is not interested in anymore.
+ *
+ * Returns the new generation number.
+ */
+guint
+browse_scheduler_new_generation (void)
+{
+	BrowseRequest *request;
+	GHashTableIter iter;
+	GSList *stale = NULL;
+	GSList *link;
+
+	generation++;
+
+	if (requests == NULL)
+		return generation;
+
+	/* Cancelling starts waiting requests, so collect first */
+	g_hash_table_iter_init (&iter, requests);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &request))
+	{
+		if (request->generation == generation ||
+		    request->priority == BrowsePriorityPrefetch)
+			continue;
+
+		stale = g_slist_prepend (stale,
+					 GUINT_TO_POINTER (request->id));
+	}
+
+	for (link = stale; link != NULL; link = link->next)
+		browse_scheduler_cancel (GPOINTER_TO_UINT (link->data),
+					 NULL);
+	g_slist_free (stale);
+
+	return generation;
+}
+
+/**
+ * Set the maximum number of browses running at once on one source. Zero
+ * removes the limit.
+ */
+void
+browse_scheduler_set_limit (guint new_limit)
+{
+	GHashTableIter iter;
+	SourceQueue *queue;
+
+	limit = new_limit;
+
+	if (queues == NULL)
+		return;
+
+	g_hash_table_iter_init (&iter, queues);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &queue))
+		start_waiting (queue);
+}
+
+/**
+ * Get the number of requests started so far, the number of requests waiting
+ * now, the number of requests cancelled so far, and the number of results
+ * that arrived after their request was cancelled. Any of the return locations
+ * can be %NULL.
+ */
+void
+browse_scheduler_get_stats (guint *started_count, guint *queued,
+			    guint *cancelled_count, guint *wasted_results)
+{
+	GHashTableIter iter;
+	SourceQueue *queue;
+
+	if (started_count != NULL)
+		*started_count = started;
+	if (cancelled_count != NULL)
+		*cancelled_count = cancelled;
+	if (wasted_results != NULL)
+		*wasted_results = wasted;
+
+	if (queued != NULL)
+	{
+		*queued = 0;
+		if (queues != NULL)
+		{
+			g_hash_table_iter_init (&iter, queues);
+			while (g_hash_table_iter_next (&iter, NULL,
+						       (gpointer *) &queue))
+				*queued += g_queue_get_length (queue->waiting);
+		}
+	}
+}
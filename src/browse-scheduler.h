@@ -0,0 +1,56 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __BROWSESCHEDULER_H__
+#define __BROWSESCHEDULER_H__
+
+#include <config.h>
+#include <libmafw/mafw.h>
+
+/** Default maximum number of browses running at once on one source */
+#define BROWSE_SCHEDULER_DEFAULT_LIMIT 2
+
+/** Priority of a browse request. Queued requests with a higher priority
+    are started first. */
+typedef enum _BrowsePriority {
+	BrowsePriorityPrefetch,
+	BrowsePriorityRefresh,
+	BrowsePriorityNavigation
+} BrowsePriority;
+
+guint browse_scheduler_submit(MafwSource *source, const gchar *objectid,
+			      gboolean recursive, const gchar *filter,
+			      const gchar *sort_criteria,
+			      const gchar *const *metadata_keys,
+			      guint skip_count, guint item_count,
+			      BrowsePriority priority,
+			      MafwSourceBrowseResultCb browse_cb,
+			      gpointer user_data);
+gboolean browse_scheduler_cancel(guint request_id, GError **error);
+void browse_scheduler_promote(guint request_id);
+guint browse_scheduler_new_generation(void);
+
+void browse_scheduler_set_limit(guint limit);
+void browse_scheduler_get_stats(guint *started, guint *queued,
+				guint *cancelled, guint *wasted_results);
+
+#endif /* __BROWSESCHEDULER_H__ */
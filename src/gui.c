@@ -27,6 +27,10 @@
 
 #include "gui.h"
 #include "source-treeview.h"
+#include "browse-cache.h"
+#include "title-cache.h"
+#include "browse-metrics.h"
+#include "browse-scheduler.h"
 #include "metadata-view.h"
 #include "playlist-controls.h"
 #include "playlist-treeview.h"
@@ -255,6 +259,19 @@ all_metadata_cb (MafwSource *self, const gchar *object_id, GHashTable *metadata,
 	}
 }
 
+static void
+on_flatten_activate (GtkMenuItem* item, gpointer user_data)
+{
+	source_treeview_flatten_selected ();
+}
+
+static void
+on_browse_all_activate (GtkMenuItem* item, gpointer user_data)
+{
+	/* The roots of all sources */
+	source_treeview_browse_all ("");
+}
+
 static void
 on_show_all_metadata_activate (GtkMenuItem* item, gpointer user_data)
 {
@@ -445,6 +462,126 @@ on_normal_model_menu_toggled (GtkCheckMenuItem* item, gpointer userdata)
 	source_treeview_set_model_behaviour (SourceModelNormal);
 }
 
+static void
+on_paged_model_menu_toggled (GtkCheckMenuItem* item, gpointer userdata)
+{
+	source_treeview_set_model_behaviour (SourceModelPaged);
+}
+
+static void
+on_prefetch_menu_toggled (GtkCheckMenuItem* item, gpointer userdata)
+{
+	source_treeview_set_prefetch (gtk_check_menu_item_get_active (item));
+}
+
+static void
+on_local_filter_menu_toggled (GtkCheckMenuItem* item, gpointer userdata)
+{
+	source_treeview_set_local_filter (
+		gtk_check_menu_item_get_active (item));
+}
+
+/**
+ * Show @text in a note that stays until it is dismissed
+ */
+static void
+show_statistics (const gchar *text)
+{
+	GtkWidget *note;
+
+	note = hildon_note_new_information (GTK_WINDOW (main_window), text);
+	gtk_dialog_run (GTK_DIALOG (note));
+	gtk_widget_destroy (note);
+}
+
+static void
+on_browse_stats_activate (GtkMenuItem* item, gpointer user_data)
+{
+	guint size, capacity, hits, misses;
+	guint started, prefetch_hits, adopted, prefetch_misses, cancelled;
+	guint browses, queued, browses_cancelled, wasted;
+	gchar *msg;
+
+	browse_cache_get_stats (&size, &capacity, &hits, &misses);
+	source_treeview_get_prefetch_stats (&started, &prefetch_hits,
+					    &adopted, &prefetch_misses,
+					    &cancelled);
+	browse_scheduler_get_stats (&browses, &queued, &browses_cancelled,
+				    &wasted);
+	msg = g_strdup_printf ("Browse cache: %u/%u containers, "
+			       "%u hits, %u misses\n"
+			       "Prefetch: %u started, %u hits, %u adopted, "
+			       "%u misses, %u cancelled\n"
+			       "Browses: %u started, %u queued, %u cancelled, "
+			       "%u results wasted\n"
+			       "Shared strings: %" G_GSIZE_FORMAT
+			       " bytes saved",
+			       size, capacity, hits, misses,
+			       started, prefetch_hits, adopted,
+			       prefetch_misses, cancelled,
+			       browses, queued, browses_cancelled, wasted,
+			       source_treeview_get_bytes_saved ());
+	show_statistics (msg);
+	g_free (msg);
+}
+
+static void
+on_playlist_stats_activate (GtkMenuItem* item, gpointer user_data)
+{
+	guint titles, title_capacity, title_hits, title_misses;
+	guint md_requests, md_rows, md_cancelled, md_reissued, md_duplicates;
+	gchar *msg;
+
+	title_cache_get_stats (&titles, &title_capacity, &title_hits,
+			       &title_misses);
+	playlist_treeview_get_fetch_stats (&md_requests, &md_rows,
+					   &md_cancelled, &md_reissued,
+					   &md_duplicates);
+	msg = g_strdup_printf ("Titles: %u/%u cached, %u hits, "
+			       "%u misses (%.0f%% hit ratio)\n"
+			       "Metadata: %u requests for %u rows, "
+			       "%u cancelled, %u rows asked again, "
+			       "%u rows fetched twice\n"
+			       "Shared strings: %" G_GSIZE_FORMAT
+			       " bytes saved",
+			       titles, title_capacity, title_hits,
+			       title_misses,
+			       title_hits + title_misses > 0 ?
+			       100.0 * title_hits /
+			       (title_hits + title_misses) : 0.0,
+			       md_requests, md_rows, md_cancelled, md_reissued,
+			       md_duplicates,
+			       playlist_treeview_get_bytes_saved ());
+	show_statistics (msg);
+	g_free (msg);
+}
+
+static void
+on_save_browse_metrics_activate (GtkMenuItem* item, gpointer user_data)
+{
+	GError *error = NULL;
+	gchar *basename;
+	gchar *msg;
+
+	basename = g_build_filename (g_get_tmp_dir (), "mafw-test-gui-metrics",
+				     NULL);
+	if (browse_metrics_save (basename, &error) == TRUE)
+	{
+		msg = g_strdup_printf ("Browse metrics saved to %s.csv/.json",
+				       basename);
+		hildon_banner_show_information (NULL, NULL, msg);
+		g_free (msg);
+	}
+	else
+	{
+		hildon_banner_show_information (NULL, "chat_smiley_angry",
+						error->message);
+		g_error_free (error);
+	}
+
+	g_free (basename);
+}
+
 void on_enter_uri_cancel_clicked(GtkButton *button, gpointer user_data);
 void on_enter_uri_ok_clicked(GtkButton *button, gpointer user_data);
 
@@ -793,6 +930,12 @@ setup_menu (void)
 	g_signal_connect (G_OBJECT (sub_item), "activate",
 			  G_CALLBACK (on_show_playing_order), NULL);
 
+	/* Title cache and metadata fetch statistics */
+	sub_item = gtk_menu_item_new_with_label ("Playlist statistics");
+	gtk_menu_shell_append (GTK_MENU_SHELL(sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "activate",
+			  G_CALLBACK (on_playlist_stats_activate), NULL);
+
 	/**********************************************************************/
 
 	/* Browse view sub-menu */
@@ -820,6 +963,18 @@ setup_menu (void)
 	g_signal_connect (G_OBJECT (sub_item), "activate",
 			  G_CALLBACK (on_show_all_metadata_activate), NULL);
 
+	/* List all items under the selected folder */
+	sub_item = gtk_menu_item_new_with_label ("Show all items in folder");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "activate",
+			  G_CALLBACK (on_flatten_activate), NULL);
+
+	/* List the roots of all sources together */
+	sub_item = gtk_menu_item_new_with_label ("Browse all sources");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "activate",
+			  G_CALLBACK (on_browse_all_activate), NULL);
+
 	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu),
 			       gtk_separator_menu_item_new ());
 
@@ -858,10 +1013,43 @@ setup_menu (void)
 
 	sub_item = gtk_radio_menu_item_new_with_label (group,
                                                        "Non-optimized model");
+	group = gtk_radio_menu_item_get_group (GTK_RADIO_MENU_ITEM (sub_item));
 	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
 	g_signal_connect (G_OBJECT (sub_item), "toggled",
 			  G_CALLBACK (on_normal_model_menu_toggled), NULL);
 
+	sub_item = gtk_radio_menu_item_new_with_label (group, "Paged model");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "toggled",
+			  G_CALLBACK (on_paged_model_menu_toggled), NULL);
+
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu),
+			       gtk_separator_menu_item_new ());
+
+	/* Speculative prefetch of the selected container */
+	sub_item = gtk_check_menu_item_new_with_label ("Prefetch containers");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "toggled",
+			  G_CALLBACK (on_prefetch_menu_toggled), NULL);
+
+	/* Search the loaded titles instead of asking the source */
+	sub_item = gtk_check_menu_item_new_with_label ("Filter loaded titles");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "toggled",
+			  G_CALLBACK (on_local_filter_menu_toggled), NULL);
+
+	/* Browse cache, prefetch and scheduler statistics */
+	sub_item = gtk_menu_item_new_with_label ("Browse statistics");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "activate",
+			  G_CALLBACK (on_browse_stats_activate), NULL);
+
+	/* Browse metrics */
+	sub_item = gtk_menu_item_new_with_label ("Save browse metrics");
+	gtk_menu_shell_append (GTK_MENU_SHELL (sub_menu), sub_item);
+	g_signal_connect (G_OBJECT (sub_item), "activate",
+			  G_CALLBACK (on_save_browse_metrics_activate), NULL);
+
 	/**********************************************************************/
 
 	/* Import sub-menu */
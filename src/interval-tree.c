@@ -0,0 +1,310 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * A set of closed intervals of row numbers, each with a data pointer, that
+ * answers which intervals overlap a given range without looking at all of
+ * them. The intervals are kept in a treap ordered by their start, and
+ * every node knows the largest end in its subtree, so a subtree that ends
+ * before the range can be skipped. Random priorities keep the treap
+ * balanced on average whatever order the intervals come in.
+ *
+ * Several intervals may start at the same row. They are told apart by
+ * their data pointer, which must be unique.
+ */
+
+#include <config.h>
+
+#include "interval-tree.h"
+
+typedef struct _Node Node;
+
+struct _Node {
+	guint from;
+	guint to;
+	gpointer data;
+
+	/* Largest @to in the subtree */
+	guint max;
+
+	/* Heap order: a parent's priority is at least its children's */
+	guint32 priority;
+
+	Node *left;
+	Node *right;
+};
+
+struct _IntervalTree {
+	Node *root;
+	guint size;
+};
+
+IntervalTree *
+interval_tree_new(void)
+{
+	return g_new0(IntervalTree, 1);
+}
+
+static void
+node_free(Node *node)
+{
+	if (node == NULL)
+		return;
+
+	node_free(node->left);
+	node_free(node->right);
+	g_free(node);
+}
+
+void
+interval_tree_free(IntervalTree *tree)
+{
+	if (tree == NULL)
+		return;
+
+	node_free(tree->root);
+	g_free(tree);
+}
+
+static void
+update_max(Node *node)
+{
+	node->max = node->to;
+	if (node->left != NULL && node->left->max > node->max)
+		node->max = node->left->max;
+	if (node->right != NULL && node->right->max > node->max)
+		node->max = node->right->max;
+}
+
+static Node *
+rotate_right(Node *node)
+{
+	Node *left = node->left;
+
+	node->left = left->right;
+	left->right = node;
+	update_max(node);
+	update_max(left);
+	return left;
+}
+
+static Node *
+rotate_left(Node *node)
+{
+	Node *right = node->right;
+
+	node->right = right->left;
+	right->left = node;
+	update_max(node);
+	update_max(right);
+	return right;
+}
+
+/**
+ * Order of the intervals in the tree: by start, then by data pointer
+ */
+static gint
+compare(guint from, gpointer data, const Node *node)
+{
+	if (from != node->from)
+		return from < node->from ? -1 : 1;
+	if (data != node->data)
+		return (gsize) data < (gsize) node->data ? -1 : 1;
+	return 0;
+}
+
+static Node *
+insert(Node *node, Node *new_node)
+{
+	if (node == NULL)
+		return new_node;
+
+	if (compare(new_node->from, new_node->data, node) < 0)
+	{
+		node->left = insert(node->left, new_node);
+		if (node->left->priority > node->priority)
+			return rotate_right(node);
+	}
+	else
+	{
+		node->right = insert(node->right, new_node);
+		if (node->right->priority > node->priority)
+			return rotate_left(node);
+	}
+
+	update_max(node);
+	return node;
+}
+
+/**
+ * Add the interval from @from to @to, both included, with @data
+ */
+void
+interval_tree_insert(IntervalTree *tree, guint from, guint to,
+		     gpointer data)
+{
+	Node *node;
+
+	g_return_if_fail(from <= to);
+
+	node = g_new0(Node, 1);
+	node->from = from;
+	node->to = to;
+	node->max = to;
+	node->data = data;
+	node->priority = g_random_int();
+
+	tree->root = insert(tree->root, node);
+	tree->size++;
+}
+
+static Node *
+remove_node(Node *node, guint from, gpointer data, gboolean *found)
+{
+	Node *child;
+	gint cmp;
+
+	if (node == NULL)
+		return NULL;
+
+	cmp = compare(from, data, node);
+	if (cmp < 0)
+	{
+		node->left = remove_node(node->left, from, data, found);
+	}
+	else if (cmp > 0)
+	{
+		node->right = remove_node(node->right, from, data, found);
+	}
+	else if (node->left == NULL || node->right == NULL)
+	{
+		child = node->left != NULL ? node->left : node->right;
+		g_free(node);
+		*found = TRUE;
+		return child;
+	}
+	else
+	{
+		/* Rotate the node down until it has at most one child */
+		if (node->left->priority > node->right->priority)
+		{
+			node = rotate_right(node);
+			node->right = remove_node(node->right, from, data,
+						  found);
+		}
+		else
+		{
+			node = rotate_left(node);
+			node->left = remove_node(node->left, from, data,
+						 found);
+		}
+	}
+
+	update_max(node);
+	return node;
+}
+
+/**
+ * Remove the interval that starts at @from and has @data.
+ *
+ * Returns %TRUE if there was such an interval.
+ */
+gboolean
+interval_tree_remove(IntervalTree *tree, guint from, gpointer data)
+{
+	gboolean found = FALSE;
+
+	tree->root = remove_node(tree->root, from, data, &found);
+	if (found)
+		tree->size--;
+
+	return found;
+}
+
+static gboolean
+overlaps(const Node *node, guint from, guint to)
+{
+	while (node != NULL)
+	{
+		if (node->max < from)
+			return FALSE;
+		if (node->from <= to && node->to >= from)
+			return TRUE;
+
+		/* The left subtree can reach @from only if its max does; if
+		   not, only the right one can overlap */
+		if (node->left != NULL && node->left->max >= from)
+			node = node->left;
+		else if (node->from <= to)
+			node = node->right;
+		else
+			return FALSE;
+	}
+	return FALSE;
+}
+
+/**
+ * Check whether any interval overlaps the range from @from to @to
+ */
+gboolean
+interval_tree_overlaps(IntervalTree *tree, guint from, guint to)
+{
+	return overlaps(tree->root, from, to);
+}
+
+static void
+find(const Node *node, guint from, guint to, GPtrArray *result)
+{
+	if (node == NULL || node->max < from)
+		return;
+
+	find(node->left, from, to, result);
+	if (node->from > to)
+		return;
+
+	if (node->to >= from)
+		g_ptr_array_add(result, node->data);
+	find(node->right, from, to, result);
+}
+
+/**
+ * Get the data of all the intervals that overlap the range from @from to
+ * @to, in the order of their start. The tree may be changed while going
+ * through the result.
+ *
+ * Returns a new array, to be freed with g_ptr_array_free().
+ */
+GPtrArray *
+interval_tree_find(IntervalTree *tree, guint from, guint to)
+{
+	GPtrArray *result;
+
+	result = g_ptr_array_new();
+	find(tree->root, from, to, result);
+	return result;
+}
+
+guint
+interval_tree_get_size(IntervalTree *tree)
+{
+	return tree->size;
+}
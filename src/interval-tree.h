@@ -0,0 +1,42 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __INTERVALTREE_H__
+#define __INTERVALTREE_H__
+
+#include <config.h>
+#include <glib.h>
+
+typedef struct _IntervalTree IntervalTree;
+
+IntervalTree *interval_tree_new(void);
+void interval_tree_free(IntervalTree *tree);
+
+void interval_tree_insert(IntervalTree *tree, guint from, guint to,
+			  gpointer data);
+gboolean interval_tree_remove(IntervalTree *tree, guint from, gpointer data);
+
+gboolean interval_tree_overlaps(IntervalTree *tree, guint from, guint to);
+GPtrArray *interval_tree_find(IntervalTree *tree, guint from, guint to);
+guint interval_tree_get_size(IntervalTree *tree);
+
+#endif /* __INTERVALTREE_H__ */
@@ -38,6 +38,7 @@
 #include "source-treeview.h"
 #include "playlist-controls.h"
 #include "playlist-treeview.h"
+#include "title-cache.h"
 
 static MafwRegistry *registry = NULL;
 
@@ -168,6 +169,9 @@ crawler_state_changed (GConfClient *client,
 	    g_ascii_strcasecmp (str_value, "IDLE") == 0) {
 		g_print ("Crawler is done indexing."  \
 			 "Reloading current playlist\n");
+
+		/* Titles may have changed with the new index */
+		title_cache_clear ();
 		playlist = MAFW_PLAYLIST(get_current_playlist());
 		if (playlist != NULL) {
 			display_playlist_contents(playlist);
@@ -279,6 +283,10 @@ deinit_app (void)
 {
 	/* Stop any ongoing playback */
 	stop ();
+
+	/* Come back to the same container at the next start */
+	source_treeview_save_view ();
+	source_treeview_shutdown ();
 }
 
 void
@@ -299,6 +307,9 @@ main (gint   argc,
            return -2;
         }
 
+	/* Show the last view while the sources are being found */
+	source_treeview_restore_view ();
+
         if (!init_app ()) {
            return -3;
         }
@@ -0,0 +1,794 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+/*
+ * A list model for the playlist view that knows only the size of the
+ * playlist up front. Rows have no storage until they are looked at: the
+ * view asks for the title of the rows that it draws, and only those rows
+ * get data, which the playlist view fills in once their metadata arrives.
+ * Memory use follows the number of rows that have been on screen rather
+ * than the length of the playlist.
+ *
+ * The view must use fixed height mode, otherwise it measures every row
+ * and so looks at all of them.
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include "playlist-model.h"
+#include "string-pool.h"
+
+static void playlist_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(PlaylistModel, playlist_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      playlist_model_tree_model_init));
+
+/*****************************************************************************
+ * Helpers
+ *****************************************************************************/
+
+#define ROW_KEY(n) GUINT_TO_POINTER(n)
+
+static inline gboolean
+iter_is_valid(PlaylistModel *model, GtkTreeIter *iter)
+{
+	return iter != NULL && iter->stamp == model->stamp &&
+		GPOINTER_TO_UINT(iter->user_data) < model->length;
+}
+
+static inline void
+iter_set(PlaylistModel *model, GtkTreeIter *iter, guint index)
+{
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER(index);
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+static void
+row_free(PlaylistModelRow *row)
+{
+	g_free(row->title);
+	string_pool_unref(row->objectid);
+	g_free(row);
+}
+
+static void
+row_changed(PlaylistModel *model, guint index)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	iter_set(model, &iter, index);
+	path = gtk_tree_path_new_from_indices(index, -1);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/**
+ * Give a row storage the first time it is looked at, and let the owner
+ * know that it needs data
+ */
+static PlaylistModelRow *
+materialize(PlaylistModel *model, guint index)
+{
+	PlaylistModelRow *row;
+
+	row = g_new0(PlaylistModelRow, 1);
+	g_hash_table_insert(model->rows, ROW_KEY(index), row);
+
+	g_array_append_val(model->needed, index);
+	if (model->needed->len == 1 && model->need_func != NULL)
+		model->need_func(model, model->need_data);
+
+	return row;
+}
+
+/** How rows move when rows are inserted, removed or moved */
+typedef struct _IndexMap {
+	/* Rows in [from, until) move by delta */
+	guint from;
+	guint until;
+	gint delta;
+
+	/* Rows in [drop_from, drop_to) go away */
+	guint drop_from;
+	guint drop_to;
+
+	/* Row moved to another place, or G_MAXUINT */
+	guint moved;
+	guint moved_to;
+} IndexMap;
+
+/**
+ * Find the new place of the row @index. Returns %FALSE if it goes away.
+ */
+static gboolean
+map_index(const IndexMap *map, guint *index)
+{
+	if (*index >= map->drop_from && *index < map->drop_to)
+		return FALSE;
+
+	if (*index == map->moved)
+		*index = map->moved_to;
+	else if (*index >= map->from && *index < map->until)
+		*index += map->delta;
+
+	return TRUE;
+}
+
+/**
+ * Move the stored rows, the needed rows and the current row according to
+ * @map. Costs time in proportion to the rows that have data, not to the
+ * length.
+ */
+static void
+shift_rows(PlaylistModel *model, const IndexMap *map)
+{
+	GHashTableIter hash_iter;
+	GHashTable *rows;
+	gpointer key, value;
+	guint index;
+	guint i, j;
+
+	rows = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_hash_table_iter_init(&hash_iter, model->rows);
+	while (g_hash_table_iter_next(&hash_iter, &key, &value) == TRUE)
+	{
+		index = GPOINTER_TO_UINT(key);
+		if (map_index(map, &index) == TRUE)
+			g_hash_table_insert(rows, ROW_KEY(index), value);
+		else
+			row_free(value);
+	}
+	g_hash_table_destroy(model->rows);
+	model->rows = rows;
+
+	for (i = 0, j = 0; i < model->needed->len; i++)
+	{
+		index = g_array_index(model->needed, guint, i);
+		if (map_index(map, &index) == TRUE)
+			g_array_index(model->needed, guint, j++) = index;
+	}
+	g_array_set_size(model->needed, j);
+
+	if (model->current >= 0)
+	{
+		index = model->current;
+		if (map_index(map, &index) == TRUE)
+			model->current = index;
+		else
+			model->current = -1;
+	}
+}
+
+static void
+free_rows(PlaylistModel *model)
+{
+	GHashTableIter hash_iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&hash_iter, model->rows);
+	while (g_hash_table_iter_next(&hash_iter, NULL, &value) == TRUE)
+		row_free(value);
+	g_hash_table_remove_all(model->rows);
+}
+
+/*****************************************************************************
+ * GtkTreeModel interface
+ *****************************************************************************/
+
+static GtkTreeModelFlags
+playlist_model_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+playlist_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return PLAYLIST_MODEL_N_COLUMNS;
+}
+
+static GType
+playlist_model_get_column_type(GtkTreeModel *tree_model, gint column)
+{
+	switch (column)
+	{
+		case PLAYLIST_MODEL_COLUMN_INDEX:
+			return G_TYPE_UINT;
+		case PLAYLIST_MODEL_COLUMN_CURRENT:
+		case PLAYLIST_MODEL_COLUMN_TITLE:
+			return G_TYPE_STRING;
+		case PLAYLIST_MODEL_COLUMN_OBJECTID:
+			return STRING_POOL_TYPE_STRING;
+		default:
+			g_return_val_if_reached(G_TYPE_INVALID);
+	}
+}
+
+static gboolean
+playlist_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			GtkTreePath *path)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(tree_model);
+	gint index;
+
+	if (gtk_tree_path_get_depth(path) != 1)
+		return FALSE;
+
+	index = gtk_tree_path_get_indices(path)[0];
+	if (index < 0 || index >= model->length)
+		return FALSE;
+
+	iter_set(model, iter, index);
+	return TRUE;
+}
+
+static GtkTreePath *
+playlist_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(tree_model);
+	GtkTreePath *path;
+
+	g_return_val_if_fail(iter_is_valid(model, iter), NULL);
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, GPOINTER_TO_UINT(iter->user_data));
+	return path;
+}
+
+static void
+playlist_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			 gint column, GValue *value)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(tree_model);
+	PlaylistModelRow *row;
+	guint index;
+
+	g_return_if_fail(iter_is_valid(model, iter));
+
+	index = GPOINTER_TO_UINT(iter->user_data);
+
+	/* These don't need the row's data */
+	if (column == PLAYLIST_MODEL_COLUMN_INDEX)
+	{
+		g_value_init(value, G_TYPE_UINT);
+		g_value_set_uint(value, index);
+		return;
+	}
+	else if (column == PLAYLIST_MODEL_COLUMN_CURRENT)
+	{
+		g_value_init(value, G_TYPE_STRING);
+		if (model->current == index)
+			g_value_set_static_string(value, GTK_STOCK_GO_FORWARD);
+		return;
+	}
+
+	row = g_hash_table_lookup(model->rows, ROW_KEY(index));
+	if (row == NULL)
+		row = materialize(model, index);
+
+	switch (column)
+	{
+		case PLAYLIST_MODEL_COLUMN_TITLE:
+			/* Valid until the row changes, which the views
+			   hear about before the next access */
+			g_value_init(value, G_TYPE_STRING);
+			g_value_set_static_string(value, row->title);
+			break;
+		case PLAYLIST_MODEL_COLUMN_OBJECTID:
+			g_value_init(value, STRING_POOL_TYPE_STRING);
+			g_value_set_boxed(value, row->objectid);
+			break;
+		default:
+			g_warning("Invalid playlist model column %d", column);
+			break;
+	}
+}
+
+static gboolean
+playlist_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(tree_model);
+	guint index;
+
+	g_return_val_if_fail(iter_is_valid(model, iter), FALSE);
+
+	index = GPOINTER_TO_UINT(iter->user_data) + 1;
+	if (index >= model->length)
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter->user_data = GUINT_TO_POINTER(index);
+	return TRUE;
+}
+
+static gboolean
+playlist_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			      GtkTreeIter *parent, gint n)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(tree_model);
+
+	if (parent != NULL || n < 0 || n >= model->length)
+		return FALSE;
+
+	iter_set(model, iter, n);
+	return TRUE;
+}
+
+static gboolean
+playlist_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			     GtkTreeIter *parent)
+{
+	return playlist_model_iter_nth_child(tree_model, iter, parent, 0);
+}
+
+static gboolean
+playlist_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint
+playlist_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	if (iter != NULL)
+		return 0;
+	return PLAYLIST_MODEL(tree_model)->length;
+}
+
+static gboolean
+playlist_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			   GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+static void
+playlist_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = playlist_model_get_flags;
+	iface->get_n_columns = playlist_model_get_n_columns;
+	iface->get_column_type = playlist_model_get_column_type;
+	iface->get_iter = playlist_model_get_iter;
+	iface->get_path = playlist_model_get_path;
+	iface->get_value = playlist_model_get_value;
+	iface->iter_next = playlist_model_iter_next;
+	iface->iter_children = playlist_model_iter_children;
+	iface->iter_has_child = playlist_model_iter_has_child;
+	iface->iter_n_children = playlist_model_iter_n_children;
+	iface->iter_nth_child = playlist_model_iter_nth_child;
+	iface->iter_parent = playlist_model_iter_parent;
+}
+
+/*****************************************************************************
+ * GObject
+ *****************************************************************************/
+
+static void
+playlist_model_finalize(GObject *object)
+{
+	PlaylistModel *model = PLAYLIST_MODEL(object);
+
+	free_rows(model);
+	g_hash_table_destroy(model->rows);
+	g_array_free(model->needed, TRUE);
+
+	G_OBJECT_CLASS(playlist_model_parent_class)->finalize(object);
+}
+
+static void
+playlist_model_class_init(PlaylistModelClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	object_class->finalize = playlist_model_finalize;
+}
+
+static void
+playlist_model_init(PlaylistModel *model)
+{
+	model->stamp = g_random_int();
+	model->rows = g_hash_table_new(g_direct_hash, g_direct_equal);
+	model->needed = g_array_new(FALSE, FALSE, sizeof(guint));
+	model->current = -1;
+}
+
+/*****************************************************************************
+ * Public API
+ *****************************************************************************/
+
+PlaylistModel *
+playlist_model_new(void)
+{
+	return g_object_new(PLAYLIST_TYPE_MODEL, NULL);
+}
+
+/**
+ * playlist_model_reset:
+ * @model: A #PlaylistModel
+ * @length: Number of rows
+ *
+ * Forget all the rows and make @length empty ones. The views are not told,
+ * so @model must not be attached to any.
+ */
+void
+playlist_model_reset(PlaylistModel *model, guint length)
+{
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+
+	free_rows(model);
+	g_array_set_size(model->needed, 0);
+	model->current = -1;
+	model->length = length;
+	model->stamp++;
+}
+
+/**
+ * playlist_model_insert:
+ * @model: A #PlaylistModel
+ * @index: Where to insert
+ * @count: Number of empty rows to insert
+ */
+void
+playlist_model_insert(PlaylistModel *model, guint index, guint count)
+{
+	IndexMap map = { 0, G_MAXUINT, 0, 0, 0, G_MAXUINT, 0 };
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint i;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+	g_return_if_fail(index <= model->length);
+
+	if (count == 0)
+		return;
+
+	map.from = index;
+	map.delta = count;
+	shift_rows(model, &map);
+	model->stamp++;
+
+	/* The new rows have no data, so the views can be told about them
+	   one by one after the data of the others has moved */
+	for (i = 0; i < count; i++)
+	{
+		model->length++;
+		iter_set(model, &iter, index + i);
+		path = gtk_tree_path_new_from_indices(index + i, -1);
+		gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path,
+					    &iter);
+		gtk_tree_path_free(path);
+	}
+}
+
+/**
+ * playlist_model_remove:
+ * @model: A #PlaylistModel
+ * @index: First row to remove
+ * @count: Number of rows to remove
+ */
+void
+playlist_model_remove(PlaylistModel *model, guint index, guint count)
+{
+	IndexMap map = { 0, G_MAXUINT, 0, 0, 0, G_MAXUINT, 0 };
+	GtkTreePath *path;
+	guint i;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+	g_return_if_fail(index + count <= model->length);
+
+	if (count == 0)
+		return;
+
+	map.from = index + count;
+	map.delta = -(gint) count;
+	map.drop_from = index;
+	map.drop_to = index + count;
+	shift_rows(model, &map);
+	model->stamp++;
+
+	path = gtk_tree_path_new_from_indices(index, -1);
+	for (i = 0; i < count; i++)
+	{
+		model->length--;
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+	}
+	gtk_tree_path_free(path);
+}
+
+/**
+ * playlist_model_move:
+ * @model: A #PlaylistModel
+ * @from: Row to move
+ * @to: New position of the row
+ */
+void
+playlist_model_move(PlaylistModel *model, guint from, guint to)
+{
+	IndexMap map = { 0, G_MAXUINT, 0, 0, 0, G_MAXUINT, 0 };
+	GtkTreePath *path;
+	gint *new_order;
+	guint i;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+	g_return_if_fail(from < model->length && to < model->length);
+
+	if (from == to)
+		return;
+
+	/* The rows in between close the gap and open one at the target */
+	map.moved = from;
+	map.moved_to = to;
+	if (from < to)
+	{
+		map.from = from + 1;
+		map.until = to + 1;
+		map.delta = -1;
+	}
+	else
+	{
+		map.from = to;
+		map.until = from;
+		map.delta = 1;
+	}
+	shift_rows(model, &map);
+	model->stamp++;
+
+	new_order = g_new(gint, model->length);
+	for (i = 0; i < model->length; i++)
+		new_order[i] = i;
+	if (from < to)
+		memmove(new_order + from, new_order + from + 1,
+			(to - from) * sizeof(gint));
+	else
+		memmove(new_order + to + 1, new_order + to,
+			(from - to) * sizeof(gint));
+	new_order[to] = from;
+
+	path = gtk_tree_path_new();
+	gtk_tree_model_rows_reordered(GTK_TREE_MODEL(model), path, NULL,
+				      new_order);
+	gtk_tree_path_free(path);
+	g_free(new_order);
+}
+
+/**
+ * playlist_model_set_item:
+ * @model: A #PlaylistModel
+ * @index: Row of the item
+ * @objectid: Object ID of the item
+ * @title: Title of the item
+ */
+void
+playlist_model_set_item(PlaylistModel *model, guint index,
+			const gchar *objectid, const gchar *title)
+{
+	PlaylistModelRow *row;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+
+	/* The playlist may have shrunk since the data was asked for */
+	if (index >= model->length)
+		return;
+
+	row = g_hash_table_lookup(model->rows, ROW_KEY(index));
+	if (row == NULL)
+	{
+		row = g_new0(PlaylistModelRow, 1);
+		g_hash_table_insert(model->rows, ROW_KEY(index), row);
+	}
+
+	g_free(row->title);
+	row->title = g_strdup(title);
+	string_pool_unref(row->objectid);
+	row->objectid = string_pool_ref(objectid);
+
+	row_changed(model, index);
+}
+
+/**
+ * playlist_model_release:
+ * @model: A #PlaylistModel
+ * @from: First row
+ * @to: Last row
+ *
+ * The data of the rows from @from to @to that have none is not coming, so
+ * make them empty placeholders again. They need data again when they are
+ * looked at the next time.
+ */
+void
+playlist_model_release(PlaylistModel *model, guint from, guint to)
+{
+	PlaylistModelRow *row;
+	guint i, j;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+
+	if (model->length == 0)
+		return;
+	to = MIN(to, model->length - 1);
+
+	for (i = from; i <= to; i++)
+	{
+		row = g_hash_table_lookup(model->rows, ROW_KEY(i));
+		if (row == NULL || row->objectid != NULL)
+			continue;
+
+		g_hash_table_remove(model->rows, ROW_KEY(i));
+		row_free(row);
+
+		/* Still waiting to be asked for */
+		for (j = 0; j < model->needed->len; j++)
+		{
+			if (g_array_index(model->needed, guint, j) == i)
+			{
+				g_array_remove_index(model->needed, j);
+				break;
+			}
+		}
+
+		/* Let the views look at it again */
+		row_changed(model, i);
+	}
+}
+
+/**
+ * playlist_model_set_current:
+ * @model: A #PlaylistModel
+ * @index: Row of the current item, or -1
+ */
+void
+playlist_model_set_current(PlaylistModel *model, gint index)
+{
+	gint old;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+
+	if (index >= (gint) model->length)
+		index = -1;
+
+	old = model->current;
+	model->current = index;
+
+	if (old >= 0 && old != index)
+		row_changed(model, old);
+	if (index >= 0)
+		row_changed(model, index);
+}
+
+guint
+playlist_model_get_length(PlaylistModel *model)
+{
+	g_return_val_if_fail(PLAYLIST_IS_MODEL(model), 0);
+
+	return model->length;
+}
+
+/**
+ * playlist_model_peek_row:
+ * @model: A #PlaylistModel
+ * @index: A row
+ *
+ * Get the data of a row without making it needed.
+ *
+ * Returns: the data of the row, or %NULL if it has not been looked at
+ */
+const PlaylistModelRow *
+playlist_model_peek_row(PlaylistModel *model, guint index)
+{
+	g_return_val_if_fail(PLAYLIST_IS_MODEL(model), NULL);
+
+	return g_hash_table_lookup(model->rows, ROW_KEY(index));
+}
+
+/**
+ * playlist_model_get_n_loaded:
+ * @model: A #PlaylistModel
+ *
+ * Returns: the number of rows that have storage
+ */
+guint
+playlist_model_get_n_loaded(PlaylistModel *model)
+{
+	g_return_val_if_fail(PLAYLIST_IS_MODEL(model), 0);
+
+	return g_hash_table_size(model->rows);
+}
+
+/**
+ * playlist_model_foreach:
+ * @model: A #PlaylistModel
+ * @func: Function to call
+ * @user_data: Data for @func
+ *
+ * Call @func for each row that has storage, in no particular order
+ */
+void
+playlist_model_foreach(PlaylistModel *model, PlaylistModelForeachFunc func,
+		       gpointer user_data)
+{
+	GHashTableIter hash_iter;
+	gpointer key, value;
+
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+	g_return_if_fail(func != NULL);
+
+	g_hash_table_iter_init(&hash_iter, model->rows);
+	while (g_hash_table_iter_next(&hash_iter, &key, &value) == TRUE)
+		func(GPOINTER_TO_UINT(key), value, user_data);
+}
+
+/**
+ * playlist_model_set_need_func:
+ * @model: A #PlaylistModel
+ * @func: Function to call when rows need data, or %NULL
+ * @user_data: Data for @func
+ *
+ * @func is called from inside the views' access to the model, so it should
+ * only schedule the fetching.
+ */
+void
+playlist_model_set_need_func(PlaylistModel *model,
+			     PlaylistModelNeedFunc func, gpointer user_data)
+{
+	g_return_if_fail(PLAYLIST_IS_MODEL(model));
+
+	model->need_func = func;
+	model->need_data = user_data;
+}
+
+static gint
+compare_index(gconstpointer a, gconstpointer b)
+{
+	guint index_a = *(const guint *) a;
+	guint index_b = *(const guint *) b;
+
+	return index_a < index_b ? -1 : index_a > index_b;
+}
+
+/**
+ * playlist_model_take_needed:
+ * @model: A #PlaylistModel
+ *
+ * Returns: the rows that have been looked at without data since the last
+ * call, in ascending order, to be freed with g_array_free()
+ */
+GArray *
+playlist_model_take_needed(PlaylistModel *model)
+{
+	GArray *needed;
+
+	g_return_val_if_fail(PLAYLIST_IS_MODEL(model), NULL);
+
+	needed = model->needed;
+	model->needed = g_array_new(FALSE, FALSE, sizeof(guint));
+	g_array_sort(needed, compare_index);
+
+	return needed;
+}
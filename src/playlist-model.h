@@ -0,0 +1,119 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+
+#ifndef __PLAYLISTMODEL_H__
+#define __PLAYLISTMODEL_H__
+
+#include <config.h>
+#include <gtk/gtk.h>
+
+#define PLAYLIST_TYPE_MODEL (playlist_model_get_type())
+#define PLAYLIST_MODEL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+					PLAYLIST_TYPE_MODEL, PlaylistModel))
+#define PLAYLIST_IS_MODEL(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), \
+					PLAYLIST_TYPE_MODEL))
+#define PLAYLIST_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), \
+				PLAYLIST_TYPE_MODEL, PlaylistModelClass))
+
+/** Columns exposed through the GtkTreeModel interface */
+enum {
+	PLAYLIST_MODEL_COLUMN_INDEX,
+	PLAYLIST_MODEL_COLUMN_CURRENT,
+	PLAYLIST_MODEL_COLUMN_TITLE,
+	PLAYLIST_MODEL_COLUMN_OBJECTID,
+	PLAYLIST_MODEL_N_COLUMNS
+};
+
+/** Data of a row that has been looked at. The object ID is a pooled
+    string. Both are %NULL until the item's metadata arrives. */
+typedef struct _PlaylistModelRow {
+	gchar *title;
+	const gchar *objectid;
+} PlaylistModelRow;
+
+typedef struct _PlaylistModel PlaylistModel;
+typedef struct _PlaylistModelClass PlaylistModelClass;
+
+/** Called when rows without data have been looked at, and
+    playlist_model_take_needed() has something to return */
+typedef void (*PlaylistModelNeedFunc)(PlaylistModel *model,
+				      gpointer user_data);
+
+typedef void (*PlaylistModelForeachFunc)(guint index,
+					 const PlaylistModelRow *row,
+					 gpointer user_data);
+
+struct _PlaylistModel {
+	GObject parent;
+
+	/*< private >*/
+
+	/* Changed whenever existing iterators become invalid */
+	gint stamp;
+
+	/* Number of rows, the size of the playlist */
+	guint length;
+
+	/* Row index -> PlaylistModelRow, only for the rows that have been
+	   looked at. All other rows are empty placeholders. */
+	GHashTable *rows;
+
+	/* Rows looked at without data, in the order they were looked at */
+	GArray *needed;
+	PlaylistModelNeedFunc need_func;
+	gpointer need_data;
+
+	/* Row of the current item, or -1 */
+	gint current;
+};
+
+struct _PlaylistModelClass {
+	GObjectClass parent_class;
+};
+
+GType playlist_model_get_type(void);
+
+PlaylistModel *playlist_model_new(void);
+
+void playlist_model_reset(PlaylistModel *model, guint length);
+void playlist_model_insert(PlaylistModel *model, guint index, guint count);
+void playlist_model_remove(PlaylistModel *model, guint index, guint count);
+void playlist_model_move(PlaylistModel *model, guint from, guint to);
+void playlist_model_set_item(PlaylistModel *model, guint index,
+			     const gchar *objectid, const gchar *title);
+void playlist_model_release(PlaylistModel *model, guint from, guint to);
+void playlist_model_set_current(PlaylistModel *model, gint index);
+
+guint playlist_model_get_length(PlaylistModel *model);
+const PlaylistModelRow *playlist_model_peek_row(PlaylistModel *model,
+						guint index);
+guint playlist_model_get_n_loaded(PlaylistModel *model);
+void playlist_model_foreach(PlaylistModel *model,
+			    PlaylistModelForeachFunc func, gpointer user_data);
+
+void playlist_model_set_need_func(PlaylistModel *model,
+				  PlaylistModelNeedFunc func,
+				  gpointer user_data);
+GArray *playlist_model_take_needed(PlaylistModel *model);
+
+#endif /* __PLAYLISTMODEL_H__ */
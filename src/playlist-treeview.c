@@ -27,6 +27,11 @@
 #include "source-treeview.h"
 #include "main.h"
 #include "gui.h"
+#include "string-pool.h"
+#include "playlist-model.h"
+#include "title-cache.h"
+#include "range-set.h"
+#include "interval-tree.h"
 
 #include <libmafw/mafw.h>
 #include <libmafw-shared/mafw-playlist-manager.h>
@@ -35,7 +40,10 @@
 #include <stdlib.h>
 
 static GtkWidget *playlist_treeview = NULL;
-static GtkTreeModel *playlist_model = NULL;
+static PlaylistModel *playlist_model = NULL;
+
+/* Rows of playlist_model that have no metadata yet */
+static RangeSet *missing_rows = NULL;
 
 static gint playing_index = -1;
 static gboolean update_current_idx;
@@ -45,20 +53,37 @@ static gboolean update_current_idx;
  *****************************************************************************/
 
 enum {
-	COLUMN_INDEX,
-	COLUMN_CURRENT,
-	COLUMN_TITLE,
-	COLUMN_OBJECTID,
-	COLUMNS
+	COLUMN_INDEX = PLAYLIST_MODEL_COLUMN_INDEX,
+	COLUMN_CURRENT = PLAYLIST_MODEL_COLUMN_CURRENT,
+	COLUMN_TITLE = PLAYLIST_MODEL_COLUMN_TITLE,
+	COLUMN_OBJECTID = PLAYLIST_MODEL_COLUMN_OBJECTID
 };
 
-static GPtrArray *pl_get_mds;
+/* Outstanding pl_get_mds_data by their rows. Cancelled requests are
+   removed at once, even if their results are still coming. */
+static IntervalTree *pl_get_mds;
 static guint playlist_updater_id;
 
+/* Metadata request statistics */
+static struct {
+	guint requests;
+	guint rows;
+	guint cancelled;
+	guint reissued;
+	guint duplicates;
+} md_stats;
+
 struct pl_get_mds_data {
-	gint from;
-	gint to;
+	guint from;
+	guint to;
 	gpointer get_md_id;
+
+	/* Cancelled before all the metadata arrived */
+	gboolean cancelled;
+
+	/* Asked for the rows around the visible range. Cancelled when they
+	   are scrolled away from. */
+	gboolean window;
 };
 
 /*****************************************************************************
@@ -66,35 +91,51 @@ struct pl_get_mds_data {
  *****************************************************************************/
 
 static gboolean playlist_updater(gpointer data);
+static void schedule_fetch(gboolean timed);
+static void fetch_check_shown(void);
+
+/**
+ * Cancel a metadata request. Its rows that did not get their metadata need
+ * to ask again when they are looked at.
+ */
+static void cancel_get_mds(struct pl_get_mds_data *pldat)
+{
+	pldat->cancelled = TRUE;
+	interval_tree_remove(pl_get_mds, pldat->from, pldat);
+	md_stats.cancelled++;
+
+	playlist_model_release(playlist_model, pldat->from, pldat->to);
+
+	/* This may free the request */
+	mafw_playlist_cancel_get_items_md(pldat->get_md_id);
+}
 
 static void cancel_all_get_mds(void)
 {
-	if (pl_get_mds)
-	{
-		guint i = 0;
-		struct pl_get_mds_data *pldat;
-		for (i = 0; (pldat = g_ptr_array_index(pl_get_mds, i)); i++)
-		{
-			mafw_playlist_cancel_get_items_md(pldat->get_md_id);
-		}
-	}
+	GPtrArray *requests;
+	guint i;
+
+	requests = interval_tree_find(pl_get_mds, 0, G_MAXUINT);
+	for (i = 0; i < requests->len; i++)
+		cancel_get_mds(g_ptr_array_index(requests, i));
+	g_ptr_array_free(requests, TRUE);
 }
 
 void
 display_playlist_contents(MafwPlaylist *playlist)
 {
 	GError* error = NULL;
-	guint size, i;
-	GtkTreeIter iter;
+	guint size;
 
 	g_assert (playlist != NULL);
 
-	/* Cancel any running requests */
+	/* Cancel any running requests, their rows are of another playlist */
 	if (playlist_updater_id)
 	{
 		g_source_remove(playlist_updater_id);
-		cancel_all_get_mds();
+		playlist_updater_id = 0;
 	}
+	cancel_all_get_mds();
 
 	update_current_idx = FALSE;
 	/* Clear playlist contents */
@@ -114,17 +155,17 @@ display_playlist_contents(MafwPlaylist *playlist)
 	if (size == 0)
 		return;
 
-	for (i = 0; i < size; i++)
-	{
-		gtk_list_store_append(GTK_LIST_STORE(playlist_model), &iter);
-		gtk_list_store_set (GTK_LIST_STORE (playlist_model), &iter,
-					    COLUMN_INDEX, i,
-					    -1);		
-	}
-	if (playlist_updater_id == 0)
-	{
-		playlist_updater_id = g_idle_add(playlist_updater, NULL);
-	}
+	/* Only the size is known now. The rows get their metadata when they
+	   are drawn. */
+	g_object_ref (playlist_model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (playlist_treeview), NULL);
+	playlist_model_reset (playlist_model, size);
+	range_set_add (missing_rows, 0, size);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (playlist_treeview),
+				 GTK_TREE_MODEL (playlist_model));
+	g_object_unref (playlist_model);
+
+	schedule_fetch(TRUE);
 }
 
 gchar *treeview_get_stored_title(guint index)
@@ -132,11 +173,12 @@ gchar *treeview_get_stored_title(guint index)
 	gchar *title = NULL;
 	GtkTreeIter iter;
 
-	if (gtk_tree_model_iter_nth_child(playlist_model,
+	/* Asking for a title that is not there makes it to be fetched */
+	if (gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(playlist_model),
 						  &iter, NULL, index)
 		    == TRUE)
 	{
-		gtk_tree_model_get (playlist_model, &iter,
+		gtk_tree_model_get (GTK_TREE_MODEL(playlist_model), &iter,
 				    COLUMN_TITLE, &title,
 				    -1);
 	}
@@ -146,7 +188,24 @@ gchar *treeview_get_stored_title(guint index)
 void
 clear_current_playlist_treeview (void)
 {
-	gtk_list_store_clear (GTK_LIST_STORE (playlist_model));
+	g_object_ref (playlist_model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (playlist_treeview), NULL);
+	playlist_model_reset (playlist_model, 0);
+	range_set_clear (missing_rows);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (playlist_treeview),
+				 GTK_TREE_MODEL (playlist_model));
+	g_object_unref (playlist_model);
+}
+
+/**
+ * Give the row @index its item, which is not missing any more
+ */
+static void
+store_item(guint index, const gchar *object_id, const gchar *title)
+{
+	playlist_model_set_item (playlist_model, index, object_id, title);
+	if (object_id != NULL)
+		range_set_remove (missing_rows, index, index + 1);
 }
 
 static void pl_get_md_cb(MafwPlaylist *pls,
@@ -155,12 +214,13 @@ static void pl_get_md_cb(MafwPlaylist *pls,
 				       GHashTable *metadata,
 				       struct pl_get_mds_data *pldat)
 {
-	GtkTreeIter iter;
 	GValue *value;
 	gchar *title;
 	gboolean from_uri = FALSE;
 
-	if (!gtk_tree_model_iter_nth_child (playlist_model, &iter, NULL, index))
+	/* The rows may have moved since the request was cancelled */
+	if (pldat->cancelled ||
+	    index >= playlist_model_get_length (playlist_model))
 		return;
 
 	/* Attempt to extract a sane title for the item */
@@ -188,119 +248,524 @@ static void pl_get_md_cb(MafwPlaylist *pls,
                 }
         }
 
-	/* Update the item's title */
-	gtk_list_store_set (GTK_LIST_STORE (playlist_model), &iter,
-				    COLUMN_OBJECTID, object_id,
-				    COLUMN_TITLE, title,
-				    -1);
+	/* Update the item's title. The object ID column keeps one copy of
+	   each object ID however many times it is on the playlist. */
+	if (object_id != NULL && !range_set_contains (missing_rows, index))
+		md_stats.duplicates++;
+	store_item (index, object_id, title);
+	if (object_id != NULL)
+		title_cache_store (object_id, title);
 	g_free(title);
+
+	fetch_check_shown();
 }
 
 static void pl_get_md_finished(struct pl_get_mds_data *pldat)
 {
-	g_ptr_array_remove(pl_get_mds, pldat);
+	if (!pldat->cancelled)
+		interval_tree_remove(pl_get_mds, pldat->from, pldat);
 	g_free(pldat);
 }
 
-static void get_playlist_mds(MafwPlaylist *current_playlist, gint from, gint to)
+static void get_playlist_mds(MafwPlaylist *current_playlist, guint from,
+			     guint to, gboolean window)
 {
-	gpointer pl_get_md_id;
 	struct pl_get_mds_data *pldat = g_new0(struct pl_get_mds_data, 1);
 
-	pl_get_md_id = mafw_playlist_get_items_md(current_playlist,
+	pldat->from = from;
+	pldat->to = to;
+	pldat->window = window;
+	interval_tree_insert(pl_get_mds, from, to, pldat);
+	md_stats.requests++;
+	md_stats.rows += to - from + 1;
+
+	pldat->get_md_id = mafw_playlist_get_items_md(current_playlist,
 							from, to,
 				MAFW_SOURCE_LIST(MAFW_METADATA_KEY_TITLE,
 						     MAFW_METADATA_KEY_URI),
 					(MafwPlaylistGetItemsCB)pl_get_md_cb,
 					pldat,
 					(GDestroyNotify)pl_get_md_finished);
-	if (!pl_get_mds)
-		pl_get_mds = g_ptr_array_new();
-	
-	pldat->from = from;
-	pldat->to = to;
-	pldat->get_md_id = pl_get_md_id;
-	g_ptr_array_add(pl_get_mds, pldat);
+}
+
+/*****************************************************************************
+ * Visible range fetching
+ *
+ * Metadata is asked for the rows on the screen, the rows within the
+ * read-ahead window around them and the rows that have been looked at
+ * otherwise. The requests for rows that have been scrolled away from are
+ * cancelled.
+ *****************************************************************************/
+
+/** Maximum number of rows asked for with one request */
+#define FETCH_BLOCK 25
+
+/** Default number of rows above and below the visible range to fetch */
+#define FETCH_DEFAULT_READ_AHEAD 50
+
+static guint read_ahead = FETCH_DEFAULT_READ_AHEAD;
+
+/* Measures the time from the view settling until the visible rows have
+   their titles. Negative until the first measurement. */
+static GTimer *fetch_timer = NULL;
+static gboolean fetch_timing = FALSE;
+static gdouble fetch_latency = -1.0;
 
+/**
+ * Get the rows of the playlist view that are on the screen
+ */
+static gboolean
+get_visible_rows(guint *first, guint *last)
+{
+	GtkTreePath *start, *end;
+
+	if (gtk_tree_view_get_visible_range(GTK_TREE_VIEW(playlist_treeview),
+					    &start, &end) == FALSE)
+		return FALSE;
+
+	*first = gtk_tree_path_get_indices(start)[0];
+	*last = gtk_tree_path_get_indices(end)[0];
+	gtk_tree_path_free(start);
+	gtk_tree_path_free(end);
+
+	return TRUE;
 }
 
+/**
+ * Check whether the metadata of a row has been asked for already
+ */
+static gboolean
+is_requested(guint index)
+{
+	return interval_tree_overlaps(pl_get_mds, index, index);
+}
+
+
+/**
+ * Give the rows from @from to @to their titles, from the title cache when
+ * their items have been seen before and with a metadata request otherwise
+ */
+static void
+fetch_run(MafwPlaylist *current_playlist, guint from, guint to,
+	  gboolean window)
+{
+	GError *error = NULL;
+	const gchar *title;
+	gchar **oids;
+	guint i, start = 0, cached;
+	gboolean in_run = FALSE;
+
+	/* Looking the items up in an empty or disabled cache would only
+	   cost a round trip */
+	title_cache_get_stats(&cached, NULL, NULL, NULL);
+	if (cached == 0)
+	{
+		get_playlist_mds(current_playlist, from, to, window);
+		return;
+	}
+
+	/* The object IDs are cheap to get compared to the metadata */
+	oids = mafw_playlist_get_items(current_playlist, from, to, &error);
+	if (oids == NULL)
+	{
+		if (error != NULL)
+			g_error_free(error);
+		get_playlist_mds(current_playlist, from, to, window);
+		return;
+	}
+
+	for (i = from; i <= to && oids[i - from] != NULL; i++)
+	{
+		title = title_cache_lookup(oids[i - from]);
+		if (title == NULL)
+		{
+			if (!in_run)
+				start = i;
+			in_run = TRUE;
+			continue;
+		}
+
+		if (in_run)
+			get_playlist_mds(current_playlist, start, i - 1,
+					 window);
+		in_run = FALSE;
+		store_item(i, oids[i - from], title);
+	}
+
+	/* The playlist may have fewer items than the view thinks */
+	if (i <= to && !in_run)
+		start = i;
+	if (i <= to || in_run)
+		get_playlist_mds(current_playlist, start, to, window);
+
+	g_strfreev(oids);
+}
+
+/**
+ * Get titles for the rows from @from to @to that neither have one nor have
+ * been asked for, in blocks of consecutive rows. Only the runs of missing
+ * rows are looked at.
+ */
+static void
+fetch_missing(MafwPlaylist *current_playlist, guint from, guint to,
+	      gboolean window)
+{
+	guint i, start, end, run = 0;
+	gboolean in_run;
+
+	while (from <= to &&
+	       range_set_next(missing_rows, from, &start, &end) &&
+	       start <= to)
+	{
+		end = MIN(end, to + 1);
+		in_run = FALSE;
+		for (i = start; i < end; i++)
+		{
+			if (in_run &&
+			    (is_requested(i) || i - run == FETCH_BLOCK))
+			{
+				fetch_run(current_playlist, run, i - 1, window);
+				in_run = FALSE;
+			}
+			if (!in_run && !is_requested(i))
+			{
+				run = i;
+				in_run = TRUE;
+			}
+		}
+		if (in_run)
+			fetch_run(current_playlist, run, end - 1, window);
+
+		/* Fetching may have changed the set, go on after the run */
+		from = end;
+	}
+}
+
+/**
+ * Cancel the read-ahead requests among the rows from @from to @to that do
+ * not touch the rows from @first to @last
+ */
+static void
+cancel_window_between(guint from, guint to, guint first, guint last)
+{
+	struct pl_get_mds_data *pldat;
+	GPtrArray *requests;
+	guint i;
+
+	requests = interval_tree_find(pl_get_mds, from, to);
+	for (i = 0; i < requests->len; i++)
+	{
+		pldat = g_ptr_array_index(requests, i);
+		if (pldat->window && (pldat->to < first || pldat->from > last))
+			cancel_get_mds(pldat);
+	}
+	g_ptr_array_free(requests, TRUE);
+}
+
+/**
+ * Cancel the read-ahead requests that do not touch the rows from @first to
+ * @last any more
+ */
+static void
+cancel_outside(guint first, guint last)
+{
+	if (first > 0)
+		cancel_window_between(0, first - 1, first, last);
+	if (last < G_MAXUINT)
+		cancel_window_between(last + 1, G_MAXUINT, first, last);
+}
+
+/**
+ * Stop the latency measurement when all the visible rows have their titles
+ */
+static void
+fetch_check_shown(void)
+{
+	guint first, last;
+
+	if (!fetch_timing)
+		return;
+
+	if (get_visible_rows(&first, &last) &&
+	    range_set_intersects(missing_rows, first, last + 1))
+		return;
+
+	fetch_timing = FALSE;
+	fetch_latency = g_timer_elapsed(fetch_timer, NULL) * 1000.0;
+	g_debug("Playlist titles shown in %.1f ms", fetch_latency);
+}
+
+/**
+ * Fetch the metadata of the rows around the visible range and of the rows
+ * that have been looked at without it
+ */
 static gboolean playlist_updater(gpointer data)
 {
 	MafwPlaylist *current_playlist;
-	GtkTreeIter iter;
-	gint i = 0;
-	gint from=-1, to=-1;
+	GArray *needed;
+	guint length, first, last;
+	guint i, from, to;
+
+	playlist_updater_id = 0;
 
+	needed = playlist_model_take_needed(playlist_model);
+	length = playlist_model_get_length(playlist_model);
 	current_playlist = MAFW_PLAYLIST(get_current_playlist ());
-        if (current_playlist == NULL)
+	if (current_playlist == NULL || length == 0)
 	{
-		goto updater_exit;
+		g_array_free(needed, TRUE);
+		fetch_check_shown();
+		return FALSE;
 	}
-	
-	if (!gtk_tree_model_get_iter_first(playlist_model, &iter))
-		goto updater_exit;
 
-	do
+	if (get_visible_rows(&first, &last))
 	{
-		gchar *cur_oid;
-		
-		gtk_tree_model_get(playlist_model, &iter,
-			    COLUMN_OBJECTID, &cur_oid,
-			    -1);
-		if (cur_oid)
+		first = first > read_ahead ? first - read_ahead : 0;
+		last = MIN(last + read_ahead, length - 1);
+
+		cancel_outside(first, last);
+		fetch_missing(current_playlist, first, last, TRUE);
+	}
+
+	/* Rows looked at elsewhere, mostly already covered by the above */
+	if (needed->len > 0)
+	{
+		from = to = g_array_index(needed, guint, 0);
+		for (i = 1; i < needed->len; i++)
 		{
-			if (from != -1)
+			if (g_array_index(needed, guint, i) != to + 1)
 			{
-				to = i;
-				get_playlist_mds(current_playlist, from, to);
-				from = -1;
+				fetch_missing(current_playlist, from, to,
+					      FALSE);
+				from = g_array_index(needed, guint, i);
 			}
-			g_free(cur_oid);
-		}
-		else
-		{
-			if (from == -1)
-				from = i;
+			to = g_array_index(needed, guint, i);
 		}
-		i++;
+		fetch_missing(current_playlist, from, to, FALSE);
+	}
+
+	g_array_free(needed, TRUE);
+	fetch_check_shown();
+	return FALSE;
+}
 
-	} while (gtk_tree_model_iter_next(playlist_model, &iter));
-	if (from != -1)
+/**
+ * Re-evaluate the rows to fetch once the view has settled. If @timed is
+ * set, measure how long the visible rows take to get their titles.
+ */
+static void
+schedule_fetch(gboolean timed)
+{
+	if (timed)
 	{
-		to = i-1;
-		get_playlist_mds(current_playlist, from, to);
+		if (fetch_timer == NULL)
+			fetch_timer = g_timer_new();
+		g_timer_start(fetch_timer);
+		fetch_timing = TRUE;
 	}
-updater_exit:
-	playlist_updater_id = 0;
-	return FALSE;
+
+	/* Let the view lay itself out first */
+	if (playlist_updater_id == 0)
+		playlist_updater_id = g_idle_add_full(G_PRIORITY_LOW,
+						      playlist_updater,
+						      NULL, NULL);
+}
+
+/**
+ * The view has drawn rows that have no metadata yet
+ */
+static void
+on_playlist_rows_needed(PlaylistModel *model, gpointer user_data)
+{
+	schedule_fetch(FALSE);
+}
+
+/**
+ * Scrolling or resizing the view changes the rows that are needed
+ */
+static void
+on_playlist_view_scrolled(GtkAdjustment *adjustment, gpointer user_data)
+{
+	schedule_fetch(TRUE);
+}
+
+/** The rows showing an item whose metadata has changed */
+typedef struct {
+	const gchar *objectid;
+	GArray *rows;
+} ChangedItem;
+
+static void
+collect_objectid_rows(guint index, const PlaylistModelRow *row,
+		      gpointer user_data)
+{
+	ChangedItem *changed = user_data;
+
+	if (row->objectid != NULL &&
+	    strcmp(row->objectid, changed->objectid) == 0)
+		g_array_append_val(changed->rows, index);
+}
+
+/**
+ * The metadata of @objectid has changed. The rows showing it need their
+ * titles again, and get them when they are in view.
+ */
+void
+playlist_treeview_item_changed(const gchar *objectid)
+{
+	ChangedItem changed;
+	guint i, index;
+
+	if (playlist_model == NULL || objectid == NULL)
+		return;
+
+	changed.objectid = objectid;
+	changed.rows = g_array_new(FALSE, FALSE, sizeof(guint));
+	playlist_model_foreach(playlist_model, collect_objectid_rows,
+			       &changed);
+
+	for (i = 0; i < changed.rows->len; i++)
+	{
+		index = g_array_index(changed.rows, guint, i);
+		range_set_add(missing_rows, index, index + 1);
+	}
+	if (changed.rows->len > 0)
+		schedule_fetch(FALSE);
+
+	g_array_free(changed.rows, TRUE);
+}
+
+/**
+ * Set the number of rows above and below the visible range of the playlist
+ * view whose metadata is fetched in advance
+ */
+void
+playlist_treeview_set_read_ahead(guint rows)
+{
+	read_ahead = rows;
+}
+
+/**
+ * Get the time from the playlist view last settling until its visible rows
+ * got their titles, in milliseconds. Negative if they have not got them
+ * yet.
+ */
+gdouble
+playlist_treeview_get_fetch_latency(void)
+{
+	return fetch_timing ? -1.0 : fetch_latency;
+}
+
+/**
+ * Get the number of metadata requests made for the playlist view and the
+ * rows they asked for, the number of requests cancelled, the rows asked
+ * for again after a cancellation, and the rows whose metadata arrived
+ * although they had it already. Any of the return locations can be %NULL.
+ */
+void
+playlist_treeview_get_fetch_stats(guint *requests, guint *rows,
+				  guint *cancelled, guint *reissued,
+				  guint *duplicates)
+{
+	if (requests != NULL)
+		*requests = md_stats.requests;
+	if (rows != NULL)
+		*rows = md_stats.rows;
+	if (cancelled != NULL)
+		*cancelled = md_stats.cancelled;
+	if (reissued != NULL)
+		*reissued = md_stats.reissued;
+	if (duplicates != NULL)
+		*duplicates = md_stats.duplicates;
 }
 
 /*****************************************************************************
  * Mafw signal handlers for the current playlist
  *****************************************************************************/
 
+/** Rows of a cancelled metadata request that are still worth fetching */
+struct pl_md_range {
+	guint from;
+	guint to;
+	gboolean window;
+};
+
 /**
- * Checks whether there is an ongoing playlist_get_items_md req, in the given range.
+ * Cancel the metadata requests that changing @nremoved rows at @from to
+ * @nreplaced rows makes out of date. Only the requests that touch the
+ * changed rows are cancelled, or the rows after them as well if they move.
+ * Returns the rows of the cancelled requests that are still valid, in
+ * their row numbers after the change.
  */
-static gboolean check_md_reqs(guint from, guint to)
+static GArray *cancel_changed_md_reqs(guint from, guint nremoved,
+				      guint nreplaced)
 {
-	gint i = 0;
-	
-	if (!pl_get_mds)
-		return FALSE;
-	for (i = 0; pl_get_mds->len > i; i++)
+	struct pl_get_mds_data *pldat;
+	struct pl_md_range range;
+	GPtrArray *requests;
+	GArray *valid;
+	guint last, i;
+
+	valid = g_array_new(FALSE, FALSE, sizeof(struct pl_md_range));
+
+	/* The results for the rows that move would go to the wrong rows */
+	if (nremoved != nreplaced)
+		last = G_MAXUINT;
+	else if (nremoved > 0)
+		last = from + nremoved - 1;
+	else
+		return valid;
+
+	requests = interval_tree_find(pl_get_mds, from, last);
+	for (i = 0; i < requests->len; i++)
 	{
-		struct pl_get_mds_data *pldat = g_ptr_array_index(pl_get_mds, i);
-		
-		if (!pldat)
-			continue;
-		if (pldat->from <= to && pldat->to >= from)
+		pldat = g_ptr_array_index(requests, i);
+		range.window = pldat->window;
+
+		/* The rows before the change stay where they are */
+		if (pldat->from < from)
 		{
-			mafw_playlist_cancel_get_items_md(pldat->get_md_id);
-			return TRUE;
+			range.from = pldat->from;
+			range.to = from - 1;
+			g_array_append_val(valid, range);
 		}
+
+		/* The rows after it move along */
+		if (pldat->to >= from + nremoved)
+		{
+			range.from = MAX(pldat->from, from + nremoved) -
+				nremoved + nreplaced;
+			range.to = pldat->to - nremoved + nreplaced;
+			g_array_append_val(valid, range);
+		}
+
+		cancel_get_mds(pldat);
 	}
-	return FALSE;
+	g_ptr_array_free(requests, TRUE);
+
+	return valid;
+}
+
+/**
+ * Ask again for the rows of cancelled requests that are still valid and
+ * still lack metadata. The changed rows themselves are fetched when they
+ * are looked at.
+ */
+static void reissue_md_reqs(MafwPlaylist *playlist, GArray *valid)
+{
+	struct pl_md_range *range;
+	guint rows = md_stats.rows;
+	guint i;
+
+	for (i = 0; i < valid->len; i++)
+	{
+		range = &g_array_index(valid, struct pl_md_range, i);
+		fetch_missing(playlist, range->from, range->to,
+			      range->window);
+	}
+	md_stats.reissued += md_stats.rows - rows;
+
+	g_array_free(valid, TRUE);
 }
 
 void
@@ -308,7 +773,8 @@ on_mafw_playlist_contents_changed(MafwPlaylist *playlist, guint from,
 				   guint nremoved, guint nreplaced)
 {
 	MafwPlaylist *current_playlist;
-	GtkTreeIter iter;
+	GArray *valid;
+	guint length;
 	guint i;
 
 	mtg_print_signal_gen (mafw_playlist_get_name (
@@ -334,21 +800,17 @@ on_mafw_playlist_contents_changed(MafwPlaylist *playlist, guint from,
 		return;
 	}
 
-	if (nremoved && check_md_reqs(from, from + nremoved) &&
-			playlist_updater_id == 0)
-		playlist_updater_id = g_idle_add(playlist_updater, NULL);
-	if (nreplaced && check_md_reqs(from, from + nreplaced) &&
-			playlist_updater_id == 0)
-		playlist_updater_id = g_idle_add(playlist_updater, NULL);
+	/* Cancel the requests the change makes out of date, before the
+	   rows move */
+	valid = cancel_changed_md_reqs(from, nremoved, nreplaced);
 
 	/* Remove first */
-	if (gtk_tree_model_iter_nth_child (playlist_model, &iter, NULL, from))
+	length = playlist_model_get_length (playlist_model);
+	if (from < length)
 	{
 		for (i = 0; i < nremoved; i++)
 		{
-			if (gtk_list_store_remove (
-				    GTK_LIST_STORE (playlist_model), &iter)
-			    == FALSE)
+			if (from == length - i - 1)
 			{
 				if (i != nremoved - 1)
 					g_warning ("%d != %d -1, probably " \
@@ -361,51 +823,37 @@ on_mafw_playlist_contents_changed(MafwPlaylist *playlist, guint from,
 			if (playing_index >= from + i)
 				playing_index--;
 		}
+		playlist_model_remove (playlist_model, from,
+				       MIN (nremoved, length - from));
+		range_set_delete (missing_rows, from,
+				  MIN (nremoved, length - from));
 	}
 
+	/* Then insert. The index column follows the row positions by
+	   itself. */
 	if (nreplaced > 0)
 	{
-		/* Then insert */
+		playlist_model_insert (playlist_model, from, nreplaced);
+		range_set_insert (missing_rows, from, nreplaced, TRUE);
+
+		/* If the insertion happened before the currently playing
+		   index, it must be incremented. */
 		for (i = 0; i < nreplaced; i++)
 		{
-			/* Make it the $from + $i:th item in the list. */
-			gtk_list_store_insert (GTK_LIST_STORE(playlist_model),
-					       &iter, from + i);
-			gtk_list_store_set (GTK_LIST_STORE (playlist_model), &iter,
-					    COLUMN_INDEX, from + i,
-					    -1);
-	
-			/* If the insertion happened before the currently playing
-			   index, it must be incremented. */
 			if (playing_index >= from + i)
 				playing_index++;
-	
-		}
-		if (playlist_updater_id == 0)
-		{
-			playlist_updater_id = g_idle_add(playlist_updater, NULL);
 		}
 	}
-	/* Refresh the indicies */
-	if (gtk_tree_model_iter_nth_child (playlist_model, &iter, NULL, from))
-	{
-		i = 0;
-		do
-		{
-			gtk_list_store_set (GTK_LIST_STORE (playlist_model),
-                                            &iter,
-                                            COLUMN_INDEX, from + i,
-                                            -1);
-			i++;
-		} while (gtk_tree_model_iter_next(playlist_model, &iter));
-	}
+
+	reissue_md_reqs (current_playlist, valid);
 }
 
 void
 on_mafw_playlist_item_moved (MafwPlaylist *playlist, guint from, guint to)
 {
-	GtkTreeIter it_from;
-	GtkTreeIter it_to;
+	GArray *valid;
+	gboolean missing;
+	guint count;
 
 	mtg_print_signal_gen (mafw_playlist_get_name (
 				      MAFW_PLAYLIST (playlist)),
@@ -416,30 +864,20 @@ on_mafw_playlist_item_moved (MafwPlaylist *playlist, guint from, guint to)
 	if (MAFW_PLAYLIST(get_current_playlist()) != playlist)
 		return;
 
-	/* Get the affected items and check that they exist */
-	g_assert(gtk_tree_model_iter_nth_child(playlist_model,
-					       &it_from, NULL, from));
-	g_assert(gtk_tree_model_iter_nth_child(playlist_model,
-					       &it_to, NULL, to));
-	/* Refresh the indicies */
-	gtk_list_store_set(GTK_LIST_STORE (playlist_model), &it_from,
-				    COLUMN_INDEX, to,
-				    -1);
-	gtk_list_store_set(GTK_LIST_STORE (playlist_model), &it_to,
-				    COLUMN_INDEX, from,
-				    -1);
+	/* Check that the affected items exist */
+	g_assert(from < playlist_model_get_length(playlist_model));
+	g_assert(to < playlist_model_get_length(playlist_model));
+
+	/* The rows between the two places move by one */
+	count = MAX(from, to) - MIN(from, to) + 1;
+	valid = cancel_changed_md_reqs(MIN(from, to), count, count);
 
 	/* Move the affected item from index $from to index $to */
-	if (from < to)
-	{
-		gtk_list_store_move_after(GTK_LIST_STORE(playlist_model),
-					  &it_from, &it_to);
-	}
-	else
-	{
-		gtk_list_store_move_before(GTK_LIST_STORE(playlist_model),
-					   &it_from, &it_to);
-	}
+	playlist_model_move(playlist_model, from, to);
+	missing = range_set_contains(missing_rows, from);
+	range_set_delete(missing_rows, from, 1);
+	range_set_insert(missing_rows, to, 1, missing);
+	reissue_md_reqs(playlist, valid);
 
 	/* Position of the currently playing item might have changed too */
 	if ((playing_index > from && playing_index > to) ||
@@ -462,7 +900,6 @@ on_mafw_playlist_item_moved (MafwPlaylist *playlist, guint from, guint to)
 void
 update_playing_item (int index)
 {
-	GtkTreeIter iter;
 	MafwPlaylist *current_playlist;
 	GError *error = NULL;
 	guint pls_size;
@@ -484,39 +921,12 @@ update_playing_item (int index)
 		return;
 
 
-	if (playing_index >= 0)
-	{
-		if (gtk_tree_model_iter_nth_child(playlist_model,
-						  &iter, NULL, playing_index)
-		    == TRUE)
-		{
-			gtk_list_store_set (GTK_LIST_STORE (playlist_model),
-					    &iter,
-					    COLUMN_CURRENT, "",
-					    -1);
-		}
-	}
-
 	playing_index = index;
+	playlist_model_set_current(playlist_model, playing_index);
 
-	if (playing_index >= 0)
-	{
-		if (gtk_tree_model_iter_nth_child(playlist_model,
-						  &iter, NULL, playing_index)
-		    == TRUE)
-		{
-			gtk_list_store_set (GTK_LIST_STORE (playlist_model),
-					    &iter,
-					    COLUMN_CURRENT,
-					    GTK_STOCK_GO_FORWARD,
-					    -1);
-			update_current_idx = FALSE;
-		}
-		else
-		{
-			update_current_idx = TRUE;
-		}
-	}
+	/* The row may not be on the view yet */
+	update_current_idx = playing_index >= 0 &&
+		playing_index >= playlist_model_get_length(playlist_model);
 }
 
 /*****************************************************************************
@@ -538,8 +948,8 @@ on_playlist_treeview_row_activated (GtkWidget *widget, GtkTreePath *path,
 		return;
 
 	/* Get the index of the currently selected item */
-	gtk_tree_model_get_iter (playlist_model, &iter, path);
-	gtk_tree_model_get (playlist_model, &iter,
+	gtk_tree_model_get_iter (GTK_TREE_MODEL (playlist_model), &iter, path);
+	gtk_tree_model_get (GTK_TREE_MODEL (playlist_model), &iter,
 			    COLUMN_INDEX, &index,
 			    -1);
 
@@ -878,6 +1288,7 @@ playlist_get_selected_oid (void)
 	GtkTreeSelection *selection;
 	GtkTreeModel *model;
 	GtkTreeIter iter;
+	gchar *pooled = NULL;
 	gchar *oid = NULL;
 
 	/* Get the tree view's selection object */
@@ -889,13 +1300,55 @@ playlist_get_selected_oid (void)
 	if (gtk_tree_selection_get_selected (selection, &model, &iter) == TRUE)
 	{
 		gtk_tree_model_get(GTK_TREE_MODEL(model), &iter,
-				   COLUMN_OBJECTID, &oid,
+				   COLUMN_OBJECTID, &pooled,
 				   -1);
+		oid = g_strdup(pooled);
+		string_pool_unref(pooled);
 	}
 
 	return oid;
 }
 
+/**
+ * Get the number of bytes saved by sharing the object IDs of the playlist
+ * items, compared to keeping a copy of the object ID on every row
+ */
+typedef struct {
+	GHashTable *distinct;
+	gsize saved;
+} SharedCount;
+
+static void
+count_shared_objectid (guint index, const PlaylistModelRow *row,
+		       gpointer user_data)
+{
+	SharedCount *count = user_data;
+
+	if (row->objectid == NULL)
+		return;
+
+	/* Pooled strings are the same pointer */
+	if (g_hash_table_lookup(count->distinct, row->objectid) != NULL)
+		count->saved += strlen(row->objectid) + 1;
+	else
+		g_hash_table_insert(count->distinct, (gpointer) row->objectid,
+				    GINT_TO_POINTER(TRUE));
+}
+
+gsize
+playlist_treeview_get_bytes_saved (void)
+{
+	SharedCount count;
+
+	/* Only the loaded rows have an object ID */
+	count.distinct = g_hash_table_new(g_direct_hash, g_direct_equal);
+	count.saved = 0;
+	playlist_model_foreach(playlist_model, count_shared_objectid, &count);
+	g_hash_table_destroy(count.distinct);
+
+	return count.saved;
+}
+
 gint
 get_current_playlist_index (void)
 {
@@ -930,6 +1383,7 @@ setup_playlist_treeview (GtkBuilder *builder)
 	GtkCellRenderer *text_renderer;
 	GtkCellRenderer *pxb_renderer;
 	GtkTreeViewColumn *column;
+	GtkAdjustment *adjustment;
 
 	playlist_treeview =
                 GTK_WIDGET(gtk_builder_get_object(builder,
@@ -943,16 +1397,27 @@ setup_playlist_treeview (GtkBuilder *builder)
                           G_CALLBACK (on_playlist_key_pressed),
                           NULL);
 
-	/* Create a list store model for playlist contents */
-	playlist_model = GTK_TREE_MODEL(
-		gtk_list_store_new(COLUMNS,
-				   G_TYPE_UINT,
-				   G_TYPE_STRING,
-				   G_TYPE_STRING,
-				   G_TYPE_STRING));
-
+	/* Create a model for playlist contents that fetches the rows when
+	   they are drawn. Fixed height mode keeps the view from measuring
+	   every row, which would fetch them all. */
+	playlist_model = playlist_model_new ();
+	missing_rows = range_set_new ();
+	pl_get_mds = interval_tree_new ();
+	playlist_model_set_need_func (playlist_model, on_playlist_rows_needed,
+				      NULL);
+
+	gtk_tree_view_set_fixed_height_mode (GTK_TREE_VIEW (playlist_treeview),
+					     TRUE);
 	gtk_tree_view_set_model (GTK_TREE_VIEW (playlist_treeview),
-				 playlist_model);
+				 GTK_TREE_MODEL (playlist_model));
+
+	/* Follow the visible range for fetching metadata */
+	adjustment = gtk_tree_view_get_vadjustment (
+		GTK_TREE_VIEW (playlist_treeview));
+	g_signal_connect (adjustment, "value-changed",
+			  G_CALLBACK (on_playlist_view_scrolled), NULL);
+	g_signal_connect (adjustment, "changed",
+			  G_CALLBACK (on_playlist_view_scrolled), NULL);
 
 	/* Cell renderers */
 	text_renderer = gtk_cell_renderer_text_new ();
@@ -965,6 +1430,8 @@ setup_playlist_treeview (GtkBuilder *builder)
 		"text",
 		COLUMN_INDEX,
 		NULL);
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width (column, 60);
 	gtk_tree_view_append_column (GTK_TREE_VIEW (playlist_treeview), column);
 
 	/* Current item pixbuf */
@@ -974,6 +1441,8 @@ setup_playlist_treeview (GtkBuilder *builder)
 		"stock-id",
 		COLUMN_CURRENT,
 		NULL);
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width (column, 40);
 	gtk_tree_view_append_column (GTK_TREE_VIEW (playlist_treeview), column);
 
 	/* Object ID column */
@@ -983,5 +1452,7 @@ setup_playlist_treeview (GtkBuilder *builder)
 		"text",
 		COLUMN_TITLE,
 		NULL);
+	gtk_tree_view_column_set_sizing (column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_expand (column, TRUE);
 	gtk_tree_view_append_column (GTK_TREE_VIEW (playlist_treeview), column);
 }
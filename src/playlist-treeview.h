@@ -54,6 +54,13 @@ void playlist_menu_changed(GtkCheckMenuItem *checkmenuitem, gpointer user_data);
 void playlist_get_focus(void);
 gboolean playlist_has_focus(void);
 gchar *playlist_get_selected_oid(void);
+gsize playlist_treeview_get_bytes_saved(void);
+void playlist_treeview_set_read_ahead(guint rows);
+gdouble playlist_treeview_get_fetch_latency(void);
+void playlist_treeview_item_changed(const gchar *objectid);
+void playlist_treeview_get_fetch_stats(guint *requests, guint *rows,
+				       guint *cancelled, guint *reissued,
+				       guint *duplicates);
 void update_playing_index_column(void);
 void select_playing_sort(gboolean select_it);
 void setup_playlist_treeview (GtkBuilder *builder);
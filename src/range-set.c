@@ -0,0 +1,292 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * A set of row numbers kept as sorted, disjoint ranges, for tracking runs
+ * of rows such as the rows of a long list that still lack their data.
+ * Looking something up takes a binary search over the ranges, so the cost
+ * depends on how fragmented the set is, not on the number of rows. Rows can
+ * be inserted and deleted in the middle, shifting the rows after them the
+ * way a list does.
+ *
+ * All ranges are half-open: a range from start to end has the rows start
+ * to end - 1.
+ */
+
+#include <config.h>
+
+#include "range-set.h"
+
+typedef struct _Range {
+	guint start;
+	guint end;
+} Range;
+
+struct _RangeSet {
+	/* Range array, sorted, with no two ranges overlapping or touching */
+	GArray *ranges;
+};
+
+#define RANGE(set, i) (&g_array_index((set)->ranges, Range, (i)))
+
+RangeSet *
+range_set_new(void)
+{
+	RangeSet *set;
+
+	set = g_new0(RangeSet, 1);
+	set->ranges = g_array_new(FALSE, FALSE, sizeof(Range));
+	return set;
+}
+
+void
+range_set_free(RangeSet *set)
+{
+	if (set == NULL)
+		return;
+
+	g_array_free(set->ranges, TRUE);
+	g_free(set);
+}
+
+void
+range_set_clear(RangeSet *set)
+{
+	g_array_set_size(set->ranges, 0);
+}
+
+/**
+ * Find the first range that ends after @index, or the number of ranges if
+ * there is none
+ */
+static guint
+find(RangeSet *set, guint index)
+{
+	guint low = 0, high = set->ranges->len, mid;
+
+	while (low < high)
+	{
+		mid = (low + high) / 2;
+		if (RANGE(set, mid)->end > index)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return low;
+}
+
+/**
+ * Add the rows from @start to @end - 1 to @set
+ */
+void
+range_set_add(RangeSet *set, guint start, guint end)
+{
+	Range range;
+	guint first, last;
+
+	if (start >= end)
+		return;
+
+	/* Merge with the ranges that overlap or touch the new one. The
+	   first of them is the first one ending at or after @start. */
+	first = start > 0 ? find(set, start - 1) : 0;
+	for (last = first; last < set->ranges->len; last++)
+	{
+		if (RANGE(set, last)->start > end)
+			break;
+	}
+
+	range.start = start;
+	range.end = end;
+	if (last > first)
+	{
+		range.start = MIN(start, RANGE(set, first)->start);
+		range.end = MAX(end, RANGE(set, last - 1)->end);
+		g_array_remove_range(set->ranges, first, last - first);
+	}
+	g_array_insert_val(set->ranges, first, range);
+}
+
+/**
+ * Remove the rows from @start to @end - 1 from @set
+ */
+void
+range_set_remove(RangeSet *set, guint start, guint end)
+{
+	Range *range, tail;
+	guint i;
+
+	if (start >= end)
+		return;
+
+	i = find(set, start);
+	while (i < set->ranges->len && RANGE(set, i)->start < end)
+	{
+		range = RANGE(set, i);
+		if (range->start < start && range->end > end)
+		{
+			/* Punch a hole in the middle */
+			tail.start = end;
+			tail.end = range->end;
+			range->end = start;
+			g_array_insert_val(set->ranges, i + 1, tail);
+			break;
+		}
+		else if (range->start < start)
+		{
+			range->end = start;
+			i++;
+		}
+		else if (range->end > end)
+		{
+			range->start = end;
+			break;
+		}
+		else
+		{
+			g_array_remove_index(set->ranges, i);
+		}
+	}
+}
+
+/**
+ * Insert @count rows before the row @index, moving the rows from @index on
+ * forward. The new rows are in @set if @add is set.
+ */
+void
+range_set_insert(RangeSet *set, guint index, guint count, gboolean add)
+{
+	Range *range, tail;
+	guint i;
+
+	if (count == 0)
+		return;
+
+	i = find(set, index);
+	if (i < set->ranges->len && RANGE(set, i)->start < index)
+	{
+		/* Split the range the new rows go into */
+		range = RANGE(set, i);
+		tail.start = index;
+		tail.end = range->end;
+		range->end = index;
+		g_array_insert_val(set->ranges, i + 1, tail);
+		i++;
+	}
+
+	for (; i < set->ranges->len; i++)
+	{
+		range = RANGE(set, i);
+		range->start += count;
+		range->end += count;
+	}
+
+	if (add)
+		range_set_add(set, index, index + count);
+}
+
+/**
+ * Delete the @count rows from @index on, moving the rows after them back
+ */
+void
+range_set_delete(RangeSet *set, guint index, guint count)
+{
+	Range *range, *prev;
+	guint i;
+
+	if (count == 0)
+		return;
+
+	range_set_remove(set, index, index + count);
+
+	i = find(set, index);
+	for (; i < set->ranges->len; i++)
+	{
+		range = RANGE(set, i);
+		range->start -= count;
+		range->end -= count;
+	}
+
+	/* The rows on both sides of the deleted ones may now touch */
+	i = find(set, index);
+	if (i > 0 && i < set->ranges->len)
+	{
+		prev = RANGE(set, i - 1);
+		range = RANGE(set, i);
+		if (prev->end == range->start)
+		{
+			prev->end = range->end;
+			g_array_remove_index(set->ranges, i);
+		}
+	}
+}
+
+gboolean
+range_set_contains(RangeSet *set, guint index)
+{
+	guint i;
+
+	i = find(set, index);
+	return i < set->ranges->len && RANGE(set, i)->start <= index;
+}
+
+/**
+ * Check whether any of the rows from @start to @end - 1 is in @set
+ */
+gboolean
+range_set_intersects(RangeSet *set, guint start, guint end)
+{
+	guint i;
+
+	if (start >= end)
+		return FALSE;
+
+	i = find(set, start);
+	return i < set->ranges->len && RANGE(set, i)->start < end;
+}
+
+/**
+ * Find the first run of rows in @set at or after the row @from. The run is
+ * returned as the rows from @start to @end - 1, where @start is at least
+ * @from.
+ *
+ * Returns %FALSE if there are no rows in @set from @from on.
+ */
+gboolean
+range_set_next(RangeSet *set, guint from, guint *start, guint *end)
+{
+	guint i;
+
+	i = find(set, from);
+	if (i >= set->ranges->len)
+		return FALSE;
+
+	*start = MAX(RANGE(set, i)->start, from);
+	*end = RANGE(set, i)->end;
+	return TRUE;
+}
+
+guint
+range_set_get_n_ranges(RangeSet *set)
+{
+	return set->ranges->len;
+}
@@ -0,0 +1,47 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __RANGESET_H__
+#define __RANGESET_H__
+
+#include <config.h>
+#include <glib.h>
+
+typedef struct _RangeSet RangeSet;
+
+RangeSet *range_set_new(void);
+void range_set_free(RangeSet *set);
+
+void range_set_clear(RangeSet *set);
+void range_set_add(RangeSet *set, guint start, guint end);
+void range_set_remove(RangeSet *set, guint start, guint end);
+void range_set_insert(RangeSet *set, guint index, guint count,
+		      gboolean add);
+void range_set_delete(RangeSet *set, guint index, guint count);
+
+gboolean range_set_contains(RangeSet *set, guint index);
+gboolean range_set_intersects(RangeSet *set, guint start, guint end);
+gboolean range_set_next(RangeSet *set, guint from, guint *start,
+			guint *end);
+guint range_set_get_n_ranges(RangeSet *set);
+
+#endif /* __RANGESET_H__ */
@@ -0,0 +1,1369 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * A flat list model for the source view. Rows are kept in a single array
+ * and all their strings live in one GStringChunk, so that a container with
+ * tens of thousands of items costs three pointers per row plus the string
+ * data, and the whole thing is released at once when the view moves to
+ * another container.
+ *
+ * The rows can be filtered by title. The filtered out rows stay in the
+ * array and only the row numbers of the shown ones are kept, so changing
+ * the filter tells the views about the rows that appear or disappear
+ * without copying any row. The GtkTreeModel interface and the iterators
+ * deal with the shown rows, the rest of the API with all of them.
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include <libmafw/mafw.h>
+
+#include "source-model.h"
+
+/** Initial size of the string arena, grows in chunks of this size */
+#define STRING_CHUNK_SIZE 16384
+
+static void source_model_tree_model_init(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(SourceModel, source_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL,
+					      source_model_tree_model_init));
+
+/*****************************************************************************
+ * Helpers
+ *****************************************************************************/
+
+#define ROW(model, n) (&g_array_index((model)->rows, SourceModelRow, (n)))
+
+/** Position of a row that the filter hides */
+#define POSITION_HIDDEN G_MAXUINT
+
+/* Iterators hold the row number and the position of the row among the
+   shown rows plus one, or 0 if the filter hides the row. */
+#define ITER_ROW(iter) GPOINTER_TO_UINT((iter)->user_data)
+#define ITER_POSITION(iter) (GPOINTER_TO_UINT((iter)->user_data2) - 1)
+
+static inline gboolean
+iter_is_valid(SourceModel *model, GtkTreeIter *iter)
+{
+	return iter != NULL && iter->stamp == model->stamp &&
+		ITER_ROW(iter) < model->length;
+}
+
+static inline gboolean
+iter_is_shown(SourceModel *model, GtkTreeIter *iter)
+{
+	return iter_is_valid(model, iter) && iter->user_data2 != NULL;
+}
+
+static inline void
+iter_set(SourceModel *model, GtkTreeIter *iter, guint row, guint position)
+{
+	iter->stamp = model->stamp;
+	iter->user_data = GUINT_TO_POINTER(row);
+	iter->user_data2 = position == POSITION_HIDDEN ? NULL
+		: GUINT_TO_POINTER(position + 1);
+	iter->user_data3 = NULL;
+}
+
+/**
+ * Number of rows shown through the GtkTreeModel interface
+ */
+static inline guint
+n_shown(SourceModel *model)
+{
+	if (model->shown == NULL)
+		return model->length;
+	if (model->unchanged == NULL)
+		return model->shown->len;
+	return model->shown->len + model->unchanged->len -
+		model->unchanged_from;
+}
+
+/**
+ * Row number of the row shown at @position
+ */
+static inline guint
+shown_row(SourceModel *model, guint position)
+{
+	if (model->shown == NULL)
+		return position;
+	if (position < model->shown->len)
+		return g_array_index(model->shown, guint, position);
+	return g_array_index(model->unchanged, guint,
+			     model->unchanged_from + position -
+			     model->shown->len);
+}
+
+static const gchar *
+store_string(SourceModel *model, const gchar *str)
+{
+	if (str == NULL)
+		return NULL;
+	return g_string_chunk_insert(model->strings, str);
+}
+
+/**
+ * Store a string that is likely to be shared by many rows, such as a MIME
+ * type. Only one copy of each distinct value is kept in the arena.
+ */
+static const gchar *
+store_interned(SourceModel *model, const gchar *str)
+{
+	if (str == NULL)
+		return NULL;
+	return g_string_chunk_insert_const(model->strings, str);
+}
+
+static SourceModelCategory
+row_category(const gchar *objectid, const gchar *mime)
+{
+	if (objectid == NULL)
+		return SOURCE_MODEL_CATEGORY_PLACEHOLDER;
+	else if (mime == NULL)
+		return SOURCE_MODEL_CATEGORY_SOURCE;
+	else if (strcmp(mime, MAFW_METADATA_VALUE_MIME_CONTAINER) == 0)
+		return SOURCE_MODEL_CATEGORY_CONTAINER;
+	else if (strstr(mime, "audio") != NULL)
+		return SOURCE_MODEL_CATEGORY_AUDIO;
+	else if (strstr(mime, "video") != NULL)
+		return SOURCE_MODEL_CATEGORY_VIDEO;
+	else if (strstr(mime, "image") != NULL)
+		return SOURCE_MODEL_CATEGORY_IMAGE;
+	else
+		return SOURCE_MODEL_CATEGORY_OTHER;
+}
+
+/**
+ * Store a new row after all the existing ones, without exposing it
+ */
+static void
+append_row(SourceModel *model, const gchar *title, const gchar *objectid,
+	   const gchar *mime)
+{
+	SourceModelRow row;
+
+	row.title = store_string(model, title);
+	row.objectid = store_string(model, objectid);
+	row.mime = store_interned(model, mime);
+	row.category = row_category(objectid, mime);
+	g_array_append_val(model->rows, row);
+
+	if (model->titles != NULL && model->titles_dirty == FALSE)
+		title_index_add(model->titles, model->rows->len - 1,
+				row.title);
+}
+
+/*****************************************************************************
+ * Object ID index
+ *
+ * Maps object IDs to row index + 1, so that a missing key (NULL) can be told
+ * apart from row 0. The keys point into the string arena. If the same object
+ * ID appears on several rows, the first one is indexed, just like a linear
+ * search would find it.
+ *****************************************************************************/
+
+static void
+index_add(SourceModel *model, guint index)
+{
+	const gchar *objectid = ROW(model, index)->objectid;
+	gpointer old;
+
+	if (objectid == NULL)
+		return;
+
+	old = g_hash_table_lookup(model->index, objectid);
+	if (old == NULL || GPOINTER_TO_UINT(old) - 1 > index)
+		g_hash_table_insert(model->index, (gpointer) objectid,
+				    GUINT_TO_POINTER(index + 1));
+}
+
+/**
+ * Drop the object ID of row @index from the index, falling back to a later
+ * row with the same object ID if there is one.
+ */
+static void
+index_forget(SourceModel *model, guint index)
+{
+	const gchar *objectid = ROW(model, index)->objectid;
+	guint i;
+
+	if (objectid == NULL ||
+	    GPOINTER_TO_UINT(g_hash_table_lookup(model->index, objectid))
+	    != index + 1)
+		return;
+
+	g_hash_table_remove(model->index, objectid);
+	for (i = index + 1; i < model->length; i++)
+	{
+		if (ROW(model, i)->objectid != NULL &&
+		    strcmp(ROW(model, i)->objectid, objectid) == 0)
+		{
+			index_add(model, i);
+			break;
+		}
+	}
+}
+
+static void
+index_rebuild(SourceModel *model)
+{
+	guint i;
+
+	g_hash_table_remove_all(model->index);
+	for (i = 0; i < model->length; i++)
+		index_add(model, i);
+}
+
+/**
+ * Remove the visible row @index and tell the views about it. The index is
+ * not updated and the filter must be off.
+ */
+static void
+delete_row(SourceModel *model, guint index)
+{
+	GtkTreePath *path;
+
+	g_array_remove_index(model->rows, index);
+	model->length--;
+	model->stamp++;
+	model->titles_dirty = TRUE;
+
+	path = gtk_tree_path_new_from_indices(index, -1);
+	gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+	gtk_tree_path_free(path);
+}
+
+/**
+ * Insert a new visible row at @index and tell the views about it. The index
+ * is not updated and the filter must be off.
+ */
+static void
+insert_row(SourceModel *model, guint index, const SourceModelRow *src)
+{
+	SourceModelRow row;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	row.title = store_string(model, src->title);
+	row.objectid = store_string(model, src->objectid);
+	row.mime = store_interned(model, src->mime);
+	row.category = src->category;
+	g_array_insert_val(model->rows, index, row);
+	model->length++;
+	model->stamp++;
+	model->titles_dirty = TRUE;
+
+	iter_set(model, &iter, index, index);
+	path = gtk_tree_path_new_from_indices(index, -1);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+	gtk_tree_path_free(path);
+}
+
+/**
+ * Copy the live strings into a new arena and drop the old one, which may
+ * hold the strings of rows that have been replaced or removed.
+ */
+static void
+compact_strings(SourceModel *model)
+{
+	GStringChunk *old;
+	SourceModelRow *row;
+	guint i;
+
+	old = model->strings;
+	model->strings = g_string_chunk_new(STRING_CHUNK_SIZE);
+
+	for (i = 0; i < model->rows->len; i++)
+	{
+		row = ROW(model, i);
+		row->title = store_string(model, row->title);
+		row->objectid = store_string(model, row->objectid);
+		row->mime = store_interned(model, row->mime);
+	}
+
+	/* The index keys pointed to the old arena */
+	index_rebuild(model);
+	g_string_chunk_free(old);
+}
+
+static gboolean
+str_equal0(const gchar *a, const gchar *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return strcmp(a, b) == 0;
+}
+
+/*****************************************************************************
+ * Title filter
+ *****************************************************************************/
+
+static gboolean
+row_matches(SourceModel *model, guint row)
+{
+	gchar *folded;
+	gboolean match;
+
+	folded = title_index_fold(ROW(model, row)->title);
+	match = folded != NULL && strstr(folded, model->needle) != NULL;
+	g_free(folded);
+
+	return match;
+}
+
+/**
+ * Show the rows in @rows, which is in ascending order and taken over, or
+ * all the rows if @rows is %NULL. Both the old and the new rows are in row
+ * order, so one pass over them finds the rows that appear and disappear.
+ * The views are told about those only, and the model is kept consistent
+ * with each signal: the rows before the change are from the new filter,
+ * the rest still from the old one.
+ */
+static void
+filter_set_shown(SourceModel *model, GArray *rows)
+{
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	GArray *old;
+	guint old_row;
+	guint new_row;
+	guint n_rows;
+	guint i;
+
+	old = model->shown;
+	if (old == NULL)
+	{
+		old = g_array_sized_new(FALSE, FALSE, sizeof(guint),
+					model->length);
+		for (i = 0; i < model->length; i++)
+			g_array_append_val(old, i);
+	}
+
+	n_rows = rows != NULL ? rows->len : model->length;
+	model->stamp++;
+	model->shown = g_array_sized_new(FALSE, FALSE, sizeof(guint), n_rows);
+	model->unchanged = old;
+	model->unchanged_from = 0;
+
+	i = 0;
+	while (model->unchanged_from < old->len || i < n_rows)
+	{
+		old_row = model->unchanged_from < old->len
+			? g_array_index(old, guint, model->unchanged_from)
+			: G_MAXUINT;
+		new_row = i >= n_rows ? G_MAXUINT
+			: rows != NULL ? g_array_index(rows, guint, i) : i;
+
+		if (old_row <= new_row)
+			model->unchanged_from++;
+		if (new_row <= old_row)
+		{
+			g_array_append_val(model->shown, new_row);
+			i++;
+		}
+
+		if (old_row < new_row)
+		{
+			path = gtk_tree_path_new_from_indices(
+				model->shown->len, -1);
+			gtk_tree_model_row_deleted(GTK_TREE_MODEL(model),
+						   path);
+			gtk_tree_path_free(path);
+		}
+		else if (new_row < old_row)
+		{
+			iter_set(model, &iter, new_row,
+				 model->shown->len - 1);
+			path = gtk_tree_path_new_from_indices(
+				model->shown->len - 1, -1);
+			gtk_tree_model_row_inserted(GTK_TREE_MODEL(model),
+						    path, &iter);
+			gtk_tree_path_free(path);
+		}
+	}
+
+	model->unchanged = NULL;
+	g_array_free(old, TRUE);
+
+	if (rows == NULL)
+	{
+		g_array_free(model->shown, TRUE);
+		model->shown = NULL;
+	}
+	else
+	{
+		g_array_free(rows, TRUE);
+	}
+}
+
+/**
+ * Show all the rows for a change that the filter does not follow. Returns
+ * the text to filter with again afterwards, see filter_resume().
+ */
+static gchar *
+filter_suspend(SourceModel *model)
+{
+	gchar *needle = model->needle;
+
+	model->needle = NULL;
+	if (model->shown != NULL)
+		filter_set_shown(model, NULL);
+
+	return needle;
+}
+
+static void
+filter_resume(SourceModel *model, gchar *needle)
+{
+	if (needle == NULL)
+		return;
+
+	/* Case folding folded text changes nothing */
+	filter_set_shown(model, source_model_match_titles(model, needle));
+	model->needle = needle;
+}
+
+/**
+ * Make the first pending row part of the model
+ */
+static void
+expose_row(SourceModel *model, GtkTreeIter *iter)
+{
+	GtkTreePath *path;
+	guint row;
+
+	row = model->length++;
+	index_add(model, row);
+
+	/* Rows that don't match are kept but not shown */
+	if (model->shown != NULL)
+	{
+		if (row_matches(model, row) == FALSE)
+		{
+			iter_set(model, iter, row, POSITION_HIDDEN);
+			return;
+		}
+		g_array_append_val(model->shown, row);
+	}
+
+	iter_set(model, iter, row, n_shown(model) - 1);
+	path = gtk_tree_path_new_from_indices(n_shown(model) - 1, -1);
+	gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, iter);
+	gtk_tree_path_free(path);
+}
+
+/*****************************************************************************
+ * GtkTreeModel interface
+ *****************************************************************************/
+
+static GtkTreeModelFlags
+source_model_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+source_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return SOURCE_MODEL_N_COLUMNS;
+}
+
+static GType
+source_model_get_column_type(GtkTreeModel *tree_model, gint column)
+{
+	g_return_val_if_fail(column >= 0 && column < SOURCE_MODEL_N_COLUMNS,
+			     G_TYPE_INVALID);
+	if (column == SOURCE_MODEL_COLUMN_CATEGORY)
+		return G_TYPE_INT;
+	return G_TYPE_STRING;
+}
+
+static gboolean
+source_model_get_iter(GtkTreeModel *tree_model, GtkTreeIter *iter,
+		      GtkTreePath *path)
+{
+	SourceModel *model = SOURCE_MODEL(tree_model);
+	gint index;
+
+	if (gtk_tree_path_get_depth(path) != 1)
+		return FALSE;
+
+	index = gtk_tree_path_get_indices(path)[0];
+	if (index < 0 || index >= n_shown(model))
+		return FALSE;
+
+	iter_set(model, iter, shown_row(model, index), index);
+	return TRUE;
+}
+
+static GtkTreePath *
+source_model_get_path(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	SourceModel *model = SOURCE_MODEL(tree_model);
+	GtkTreePath *path;
+
+	g_return_val_if_fail(iter_is_shown(model, iter), NULL);
+
+	path = gtk_tree_path_new();
+	gtk_tree_path_append_index(path, ITER_POSITION(iter));
+	return path;
+}
+
+static void
+source_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+		       gint column, GValue *value)
+{
+	SourceModel *model = SOURCE_MODEL(tree_model);
+	SourceModelRow *row;
+
+	g_return_if_fail(iter_is_valid(model, iter));
+
+	row = ROW(model, ITER_ROW(iter));
+
+	if (column == SOURCE_MODEL_COLUMN_CATEGORY)
+	{
+		g_value_init(value, G_TYPE_INT);
+		g_value_set_int(value, row->category);
+		return;
+	}
+
+	/* The arena outlives any GValue handed out here, so there is no
+	   need to copy the strings. */
+	g_value_init(value, G_TYPE_STRING);
+	switch (column)
+	{
+		case SOURCE_MODEL_COLUMN_TITLE:
+			g_value_set_static_string(value, row->title);
+			break;
+		case SOURCE_MODEL_COLUMN_OBJECTID:
+			g_value_set_static_string(value, row->objectid);
+			break;
+		case SOURCE_MODEL_COLUMN_MIME:
+			g_value_set_static_string(value, row->mime);
+			break;
+		default:
+			g_warning("Invalid source model column %d", column);
+			break;
+	}
+}
+
+static gboolean
+source_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	SourceModel *model = SOURCE_MODEL(tree_model);
+	guint position;
+
+	g_return_val_if_fail(iter_is_shown(model, iter), FALSE);
+
+	position = ITER_POSITION(iter) + 1;
+	if (position >= n_shown(model))
+	{
+		iter->stamp = 0;
+		return FALSE;
+	}
+
+	iter_set(model, iter, shown_row(model, position), position);
+	return TRUE;
+}
+
+static gboolean
+source_model_iter_nth_child(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			    GtkTreeIter *parent, gint n)
+{
+	SourceModel *model = SOURCE_MODEL(tree_model);
+
+	if (parent != NULL || n < 0 || n >= n_shown(model))
+		return FALSE;
+
+	iter_set(model, iter, shown_row(model, n), n);
+	return TRUE;
+}
+
+static gboolean
+source_model_iter_children(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			   GtkTreeIter *parent)
+{
+	return source_model_iter_nth_child(tree_model, iter, parent, 0);
+}
+
+static gboolean
+source_model_iter_has_child(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint
+source_model_iter_n_children(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	if (iter != NULL)
+		return 0;
+	return n_shown(SOURCE_MODEL(tree_model));
+}
+
+static gboolean
+source_model_iter_parent(GtkTreeModel *tree_model, GtkTreeIter *iter,
+			 GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+static void
+source_model_tree_model_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = source_model_get_flags;
+	iface->get_n_columns = source_model_get_n_columns;
+	iface->get_column_type = source_model_get_column_type;
+	iface->get_iter = source_model_get_iter;
+	iface->get_path = source_model_get_path;
+	iface->get_value = source_model_get_value;
+	iface->iter_next = source_model_iter_next;
+	iface->iter_children = source_model_iter_children;
+	iface->iter_has_child = source_model_iter_has_child;
+	iface->iter_n_children = source_model_iter_n_children;
+	iface->iter_nth_child = source_model_iter_nth_child;
+	iface->iter_parent = source_model_iter_parent;
+}
+
+/*****************************************************************************
+ * GObject
+ *****************************************************************************/
+
+static void
+source_model_finalize(GObject *object)
+{
+	SourceModel *model = SOURCE_MODEL(object);
+
+	g_hash_table_destroy(model->index);
+	title_index_free(model->titles);
+	if (model->shown != NULL)
+		g_array_free(model->shown, TRUE);
+	g_free(model->needle);
+	g_array_free(model->rows, TRUE);
+	g_string_chunk_free(model->strings);
+
+	G_OBJECT_CLASS(source_model_parent_class)->finalize(object);
+}
+
+static void
+source_model_class_init(SourceModelClass *klass)
+{
+	G_OBJECT_CLASS(klass)->finalize = source_model_finalize;
+}
+
+static void
+source_model_init(SourceModel *model)
+{
+	model->stamp = g_random_int();
+	model->rows = g_array_new(FALSE, FALSE, sizeof(SourceModelRow));
+	model->strings = g_string_chunk_new(STRING_CHUNK_SIZE);
+	model->index = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+/*****************************************************************************
+ * Public API
+ *****************************************************************************/
+
+SourceModel *
+source_model_new(void)
+{
+	return g_object_new(SOURCE_TYPE_MODEL, NULL);
+}
+
+/**
+ * source_model_append:
+ * @model: A #SourceModel
+ * @title: Row title
+ * @objectid: Row object ID
+ * @mime: Row MIME type, or %NULL for top-level sources
+ * @iter: Return location for an iterator pointing to the new row, or %NULL
+ *
+ * Copy the given strings into the model's arena and append a new row.
+ */
+void
+source_model_append(SourceModel *model, const gchar *title,
+		    const gchar *objectid, const gchar *mime,
+		    GtkTreeIter *iter)
+{
+	GtkTreeIter new_iter;
+
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	/* Keep the rows in arrival order */
+	source_model_flush(model, G_MAXUINT);
+
+	append_row(model, title, objectid, mime);
+	expose_row(model, &new_iter);
+
+	if (iter != NULL)
+		*iter = new_iter;
+}
+
+/**
+ * source_model_append_pending:
+ * @model: A #SourceModel
+ * @title: Row title
+ * @objectid: Row object ID
+ * @mime: Row MIME type
+ *
+ * Like source_model_append(), but the row is stored without telling the
+ * views about it. Pending rows become part of the model when they are
+ * flushed with source_model_flush(). Until then they are not visible through
+ * any of the other functions.
+ */
+void
+source_model_append_pending(SourceModel *model, const gchar *title,
+			    const gchar *objectid, const gchar *mime)
+{
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	append_row(model, title, objectid, mime);
+}
+
+/**
+ * source_model_flush:
+ * @model: A #SourceModel
+ * @max_rows: Maximum number of pending rows to make visible
+ *
+ * Make up to @max_rows pending rows part of the model, oldest first. The
+ * rows are already in place, so this only updates the index and emits the
+ * row-inserted signals.
+ *
+ * Returns the number of rows flushed.
+ */
+guint
+source_model_flush(SourceModel *model, guint max_rows)
+{
+	GtkTreeIter iter;
+	guint count;
+
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), 0);
+
+	count = MIN(max_rows, model->rows->len - model->length);
+	for (max_rows = count; max_rows > 0; max_rows--)
+		expose_row(model, &iter);
+
+	return count;
+}
+
+/**
+ * source_model_get_n_pending:
+ * @model: A #SourceModel
+ *
+ * Returns the number of rows waiting for source_model_flush().
+ */
+guint
+source_model_get_n_pending(SourceModel *model)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), 0);
+
+	return model->rows->len - model->length;
+}
+
+/**
+ * source_model_set:
+ * @model: A #SourceModel
+ * @iter: A valid iterator
+ *
+ * Replace the contents of the row at @iter. The arena is append-only, so the
+ * old strings stay in it until the model is cleared or source_model_merge()
+ * compacts it. Placeholder rows, such as those of paged mode, hold no
+ * strings, so filling them in wastes nothing. The row stays shown or hidden
+ * whatever its new title.
+ */
+void
+source_model_set(SourceModel *model, GtkTreeIter *iter,
+		 const gchar *title, const gchar *objectid, const gchar *mime)
+{
+	SourceModelRow *row;
+	GtkTreePath *path;
+	guint index;
+
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+	g_return_if_fail(iter_is_valid(model, iter));
+
+	index = ITER_ROW(iter);
+	row = ROW(model, index);
+
+	/* Usually the object stays the same and so can its index entry */
+	if (row->objectid == NULL || objectid == NULL ||
+	    strcmp(row->objectid, objectid) != 0)
+	{
+		index_forget(model, index);
+		row->objectid = store_string(model, objectid);
+		index_add(model, index);
+	}
+	row->title = store_string(model, title);
+	row->mime = store_interned(model, mime);
+	row->category = row_category(objectid, mime);
+	model->titles_dirty = TRUE;
+
+	if (iter->user_data2 == NULL)
+		return;
+
+	path = source_model_get_path(GTK_TREE_MODEL(model), iter);
+	gtk_tree_model_row_changed(GTK_TREE_MODEL(model), path, iter);
+	gtk_tree_path_free(path);
+}
+
+/**
+ * source_model_remove:
+ * @model: A #SourceModel
+ * @iter: A valid iterator
+ *
+ * Remove the row at @iter. All existing iterators become invalid. The rows
+ * after it move up, so this is O(n) in the number of rows.
+ */
+void
+source_model_remove(SourceModel *model, GtkTreeIter *iter)
+{
+	gchar *needle;
+	guint index;
+
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+	g_return_if_fail(iter_is_valid(model, iter));
+
+	index = ITER_ROW(iter);
+	needle = filter_suspend(model);
+	delete_row(model, index);
+	index_rebuild(model);
+	filter_resume(model, needle);
+}
+
+/**
+ * source_model_truncate:
+ * @model: A #SourceModel
+ * @length: New number of rows
+ *
+ * Remove all rows from index @length onwards. Pending rows are dropped too.
+ */
+void
+source_model_truncate(SourceModel *model, guint length)
+{
+	GtkTreePath *path;
+	guint position;
+
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	if (model->rows->len > length)
+		model->titles_dirty = TRUE;
+
+	g_array_set_size(model->rows, model->length);
+	if (model->length <= length)
+		return;
+
+	/* Views need one row-deleted per row. Remove from the tail so that
+	   nothing has to be shifted, and keep the model consistent with
+	   each signal emission. */
+	model->stamp++;
+	if (length == 0)
+		g_hash_table_remove_all(model->index);
+	while (model->length > length)
+	{
+		if (length > 0)
+			index_forget(model, model->length - 1);
+		model->length--;
+		g_array_set_size(model->rows, model->length);
+
+		/* The shown rows are in order, so the removed ones are at
+		   the end of them too */
+		position = model->length;
+		if (model->shown != NULL)
+		{
+			position = model->shown->len;
+			if (position == 0 ||
+			    g_array_index(model->shown, guint, position - 1)
+			    != model->length)
+				continue;
+			g_array_set_size(model->shown, --position);
+		}
+
+		path = gtk_tree_path_new_from_indices(position, -1);
+		gtk_tree_model_row_deleted(GTK_TREE_MODEL(model), path);
+		gtk_tree_path_free(path);
+	}
+}
+
+/**
+ * source_model_clear:
+ * @model: A #SourceModel
+ *
+ * Remove all rows and release their strings in one go. The title filter is
+ * dropped too.
+ */
+void
+source_model_clear(SourceModel *model)
+{
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	source_model_truncate(model, 0);
+
+	if (model->shown != NULL)
+	{
+		g_array_free(model->shown, TRUE);
+		model->shown = NULL;
+	}
+	g_free(model->needle);
+	model->needle = NULL;
+
+	/* Nothing references the arena anymore */
+	g_string_chunk_clear(model->strings);
+
+	if (model->titles != NULL)
+	{
+		title_index_clear(model->titles);
+		model->titles_dirty = FALSE;
+	}
+}
+
+/**
+ * source_model_copy:
+ * @dest: A #SourceModel whose contents are replaced
+ * @src: A #SourceModel to copy the rows from
+ *
+ * Replace the contents of @dest with a copy of the rows in @src, including
+ * those hidden by its title filter.
+ */
+void
+source_model_copy(SourceModel *dest, SourceModel *src)
+{
+	const SourceModelRow *row;
+	guint i;
+
+	g_return_if_fail(SOURCE_IS_MODEL(dest));
+	g_return_if_fail(SOURCE_IS_MODEL(src));
+	g_return_if_fail(dest != src);
+
+	source_model_clear(dest);
+	for (i = 0; i < src->length; i++)
+	{
+		row = ROW(src, i);
+		source_model_append(dest, row->title, row->objectid,
+				    row->mime, NULL);
+	}
+}
+
+/**
+ * source_model_merge:
+ * @dest: A #SourceModel whose contents are updated
+ * @src: A #SourceModel with the new contents
+ *
+ * Make the rows of @dest equal to the rows in @src, matching the rows by
+ * object ID. Unlike source_model_copy(), only the rows that differ are
+ * inserted, removed or changed, so the views keep their selection and
+ * scroll position for the rows that stay. Rows that have moved are removed
+ * and inserted again. Pending rows of @dest are dropped. The title filter of
+ * @dest is applied again afterwards.
+ *
+ * Returns the number of rows inserted, removed or changed.
+ */
+guint
+source_model_merge(SourceModel *dest, SourceModel *src)
+{
+	const SourceModelRow *new_row;
+	SourceModelRow *old_row;
+	GtkTreeIter iter;
+	GtkTreePath *path;
+	GHashTable *remaining;
+	gchar *needle;
+	guint changes = 0;
+	guint i;
+
+	g_return_val_if_fail(SOURCE_IS_MODEL(dest), 0);
+	g_return_val_if_fail(SOURCE_IS_MODEL(src), 0);
+	g_return_val_if_fail(dest != src, 0);
+
+	needle = filter_suspend(dest);
+	g_array_set_size(dest->rows, dest->length);
+
+	/* Row numbers change under the index, so it is rebuilt at the end.
+	   Until then lookups find nothing rather than the wrong row. */
+	g_hash_table_remove_all(dest->index);
+
+	/* Object IDs of the old rows that have not been matched yet */
+	remaining = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < dest->length; i++)
+	{
+		old_row = ROW(dest, i);
+		if (old_row->objectid != NULL)
+			g_hash_table_insert(remaining,
+					    (gpointer) old_row->objectid,
+					    (gpointer) old_row->objectid);
+	}
+
+	i = 0;
+	while (i < src->length)
+	{
+		new_row = ROW(src, i);
+
+		if (i < dest->length)
+		{
+			old_row = ROW(dest, i);
+
+			if (old_row->objectid != NULL &&
+			    str_equal0(old_row->objectid, new_row->objectid))
+			{
+				/* Same object, maybe new metadata */
+				g_hash_table_remove(remaining,
+						    old_row->objectid);
+				if (!str_equal0(old_row->title,
+						new_row->title) ||
+				    !str_equal0(old_row->mime, new_row->mime))
+				{
+					old_row->title = store_string(
+						dest, new_row->title);
+					dest->titles_dirty = TRUE;
+					old_row->mime = store_interned(
+						dest, new_row->mime);
+					old_row->category = new_row->category;
+					iter_set(dest, &iter, i, i);
+					path = gtk_tree_path_new_from_indices(
+						i, -1);
+					gtk_tree_model_row_changed(
+						GTK_TREE_MODEL(dest), path,
+						&iter);
+					gtk_tree_path_free(path);
+					changes++;
+				}
+				i++;
+				continue;
+			}
+
+			/* Gone from the container, or in the way of an
+			   object that comes later in the old order. In the
+			   latter case it is inserted again further down. */
+			if (old_row->objectid == NULL ||
+			    g_hash_table_lookup(src->index,
+						old_row->objectid) == NULL ||
+			    (new_row->objectid != NULL &&
+			     g_hash_table_lookup(remaining,
+						 new_row->objectid) != NULL))
+			{
+				if (old_row->objectid != NULL)
+					g_hash_table_remove(remaining,
+							    old_row->objectid);
+				delete_row(dest, i);
+				changes++;
+				continue;
+			}
+		}
+
+		insert_row(dest, i, new_row);
+		changes++;
+		i++;
+	}
+
+	/* Whatever is left after the new rows */
+	while (dest->length > src->length)
+	{
+		delete_row(dest, dest->length - 1);
+		changes++;
+	}
+
+	g_hash_table_destroy(remaining);
+
+	if (changes > 0)
+		compact_strings(dest);
+	else
+		index_rebuild(dest);
+
+	filter_resume(dest, needle);
+
+	return changes;
+}
+
+/**
+ * source_model_get_row:
+ * @model: A #SourceModel
+ * @iter: A valid iterator
+ *
+ * Direct access to a row without copying its strings. The returned pointer
+ * is only valid until the model is modified.
+ */
+const SourceModelRow *
+source_model_get_row(SourceModel *model, GtkTreeIter *iter)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), NULL);
+	g_return_val_if_fail(iter_is_valid(model, iter), NULL);
+
+	return ROW(model, ITER_ROW(iter));
+}
+
+static gboolean
+lookup_row(SourceModel *model, const gchar *objectid, GtkTreeIter *iter,
+	   gboolean hidden)
+{
+	gpointer value;
+	guint row;
+	guint low;
+	guint high;
+	guint middle;
+
+	value = g_hash_table_lookup(model->index, objectid);
+	if (value == NULL)
+		return FALSE;
+
+	row = GPOINTER_TO_UINT(value) - 1;
+	if (model->shown == NULL)
+	{
+		if (iter != NULL)
+			iter_set(model, iter, row, row);
+		return TRUE;
+	}
+
+	/* The shown rows are in order */
+	low = 0;
+	high = model->shown->len;
+	while (low < high)
+	{
+		middle = low + (high - low) / 2;
+		if (g_array_index(model->shown, guint, middle) < row)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == model->shown->len ||
+	    g_array_index(model->shown, guint, low) != row)
+	{
+		if (hidden == FALSE)
+			return FALSE;
+		low = POSITION_HIDDEN;
+	}
+
+	if (iter != NULL)
+		iter_set(model, iter, row, low);
+	return TRUE;
+}
+
+/**
+ * source_model_lookup:
+ * @model: A #SourceModel
+ * @objectid: Object ID to look for
+ * @iter: Return location for an iterator pointing to the row
+ *
+ * Find the first row with the given object ID in constant time, or in
+ * logarithmic time while filtering. Rows hidden by the filter are not found.
+ *
+ * Returns %TRUE if a row was found.
+ */
+gboolean
+source_model_lookup(SourceModel *model, const gchar *objectid,
+		    GtkTreeIter *iter)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), FALSE);
+	g_return_val_if_fail(objectid != NULL, FALSE);
+
+	return lookup_row(model, objectid, iter, FALSE);
+}
+
+/**
+ * source_model_find:
+ * @model: A #SourceModel
+ * @objectid: Object ID to look for
+ * @iter: Return location for an iterator pointing to the row, or %NULL
+ *
+ * Like source_model_lookup(), but finds the rows hidden by the title filter
+ * too. An iterator to a hidden row can only be given to
+ * source_model_get_row() and source_model_set().
+ *
+ * Returns %TRUE if a row was found.
+ */
+gboolean
+source_model_find(SourceModel *model, const gchar *objectid,
+		  GtkTreeIter *iter)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), FALSE);
+	g_return_val_if_fail(objectid != NULL, FALSE);
+
+	return lookup_row(model, objectid, iter, TRUE);
+}
+
+/**
+ * source_model_get_nth_row:
+ * @model: A #SourceModel
+ * @index: Row index
+ *
+ * Like source_model_get_row(), but by row number instead of iterator. The
+ * rows hidden by the title filter are counted.
+ */
+const SourceModelRow *
+source_model_get_nth_row(SourceModel *model, guint index)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), NULL);
+	g_return_val_if_fail(index < model->length, NULL);
+
+	return ROW(model, index);
+}
+
+/**
+ * source_model_get_length:
+ * @model: A #SourceModel
+ *
+ * Returns the number of rows, including those hidden by the title filter
+ * but not the pending ones
+ */
+guint
+source_model_get_length(SourceModel *model)
+{
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), 0);
+
+	return model->length;
+}
+
+/**
+ * source_model_get_bytes_saved:
+ * @model: A #SourceModel
+ *
+ * Tells how much memory interning the MIME types saves, compared to keeping
+ * a copy of the MIME type of every row.
+ *
+ * Returns: the number of bytes saved
+ */
+gsize
+source_model_get_bytes_saved(SourceModel *model)
+{
+	GHashTable *distinct;
+	SourceModelRow *row;
+	gsize saved = 0;
+	guint i;
+
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), 0);
+
+	distinct = g_hash_table_new(g_direct_hash, g_direct_equal);
+	for (i = 0; i < model->rows->len; i++)
+	{
+		row = ROW(model, i);
+		if (row->mime == NULL)
+			continue;
+
+		/* Interned strings are the same pointer */
+		if (g_hash_table_lookup(distinct, row->mime) != NULL)
+			saved += strlen(row->mime) + 1;
+		else
+			g_hash_table_insert(distinct, (gpointer) row->mime,
+					    GINT_TO_POINTER(TRUE));
+	}
+	g_hash_table_destroy(distinct);
+
+	return saved;
+}
+
+/**
+ * source_model_set_title_index:
+ * @model: A #SourceModel
+ * @enabled: Whether to index the titles
+ *
+ * Keep an index of the row titles for source_model_match_titles(). The
+ * index costs about as much memory as the titles themselves.
+ */
+void
+source_model_set_title_index(SourceModel *model, gboolean enabled)
+{
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	if (enabled == TRUE && model->titles == NULL)
+	{
+		model->titles = title_index_new();
+		model->titles_dirty = TRUE;
+	}
+	else if (enabled == FALSE)
+	{
+		title_index_free(model->titles);
+		model->titles = NULL;
+	}
+}
+
+/**
+ * source_model_match_titles:
+ * @model: A #SourceModel with a title index
+ * @needle: Text to search for
+ *
+ * Find the rows whose title contains @needle, ignoring case. Pending rows
+ * are left out, rows hidden by the title filter are not.
+ *
+ * Returns: a #GArray of row numbers in ascending order, to be freed with
+ * g_array_free()
+ */
+GArray *
+source_model_match_titles(SourceModel *model, const gchar *needle)
+{
+	GArray *rows;
+	guint i;
+
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), NULL);
+	g_return_val_if_fail(model->titles != NULL, NULL);
+
+	if (model->titles_dirty == TRUE)
+	{
+		title_index_clear(model->titles);
+		for (i = 0; i < model->rows->len; i++)
+			title_index_add(model->titles, i, ROW(model, i)->title);
+		model->titles_dirty = FALSE;
+	}
+
+	rows = title_index_lookup(model->titles, needle);
+
+	/* Leave out the pending rows */
+	for (i = rows->len; i > 0; i--)
+	{
+		if (g_array_index(rows, guint, i - 1) < model->length)
+			break;
+	}
+	g_array_set_size(rows, i);
+
+	return rows;
+}
+
+/**
+ * source_model_filter_titles:
+ * @model: A #SourceModel with a title index
+ * @needle: Text to search for, or %NULL
+ *
+ * Show only the rows whose title contains @needle, ignoring case, or all
+ * the rows if @needle is %NULL or empty. The rows appended later are
+ * filtered as they become visible. The views are told only about the rows
+ * that appear or disappear, so they keep the selection and the scroll
+ * position of the rows shown before and after.
+ */
+void
+source_model_filter_titles(SourceModel *model, const gchar *needle)
+{
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+	g_return_if_fail(needle == NULL || needle[0] == '\0' ||
+			 model->titles != NULL);
+
+	g_free(model->needle);
+	model->needle = NULL;
+
+	if (needle == NULL || needle[0] == '\0')
+	{
+		if (model->shown != NULL)
+			filter_set_shown(model, NULL);
+		return;
+	}
+
+	filter_set_shown(model, source_model_match_titles(model, needle));
+	model->needle = title_index_fold(needle);
+}
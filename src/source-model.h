@@ -0,0 +1,148 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __SOURCEMODEL_H__
+#define __SOURCEMODEL_H__
+
+#include <config.h>
+#include <gtk/gtk.h>
+
+#include "title-index.h"
+
+#define SOURCE_TYPE_MODEL (source_model_get_type())
+#define SOURCE_MODEL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+					SOURCE_TYPE_MODEL, SourceModel))
+#define SOURCE_IS_MODEL(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), \
+					SOURCE_TYPE_MODEL))
+#define SOURCE_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), \
+					SOURCE_TYPE_MODEL, SourceModelClass))
+
+/** Columns exposed through the GtkTreeModel interface */
+enum {
+	SOURCE_MODEL_COLUMN_TITLE,
+	SOURCE_MODEL_COLUMN_OBJECTID,
+	SOURCE_MODEL_COLUMN_MIME,
+	SOURCE_MODEL_COLUMN_CATEGORY,
+	SOURCE_MODEL_N_COLUMNS
+};
+
+/** Icon category of a row, derived from its object ID and MIME type when the
+    row is stored so that drawing the icon needs no string comparisons */
+typedef enum {
+	SOURCE_MODEL_CATEGORY_PLACEHOLDER, /* No object ID yet */
+	SOURCE_MODEL_CATEGORY_SOURCE,      /* No MIME type: a source */
+	SOURCE_MODEL_CATEGORY_CONTAINER,
+	SOURCE_MODEL_CATEGORY_AUDIO,
+	SOURCE_MODEL_CATEGORY_VIDEO,
+	SOURCE_MODEL_CATEGORY_IMAGE,
+	SOURCE_MODEL_CATEGORY_OTHER,
+	SOURCE_MODEL_N_CATEGORIES
+} SourceModelCategory;
+
+/** One row of the model. The strings point into the model's string arena
+    and stay valid until the row is removed or the model is cleared. Rows
+    with the same MIME type share one copy of it. */
+typedef struct _SourceModelRow {
+	const gchar *title;
+	const gchar *objectid;
+	const gchar *mime;
+	SourceModelCategory category;
+} SourceModelRow;
+
+typedef struct _SourceModel SourceModel;
+typedef struct _SourceModelClass SourceModelClass;
+
+struct _SourceModel {
+	GObject parent;
+
+	/*< private >*/
+
+	/* Changed whenever existing iterators become invalid */
+	gint stamp;
+
+	/* SourceModelRow array, one element per row. The rows from length
+	   onwards are pending and not visible through the model interface. */
+	GArray *rows;
+	guint length;
+
+	/* Backing storage for all the strings referenced from rows */
+	GStringChunk *strings;
+
+	/* Object ID -> row index + 1 */
+	GHashTable *index;
+
+	/* Title substring index, NULL unless enabled. Kept up to date while
+	   rows are appended, rebuilt on demand after other changes. */
+	TitleIndex *titles;
+	gboolean titles_dirty;
+
+	/* Folded text that the shown rows contain, NULL unless filtering */
+	gchar *needle;
+
+	/* Rows shown through the GtkTreeModel interface while filtering, in
+	   ascending order, or NULL when all of them are. While the filter
+	   changes, the shown rows go on from unchanged_from in unchanged. */
+	GArray *shown;
+	GArray *unchanged;
+	guint unchanged_from;
+};
+
+struct _SourceModelClass {
+	GObjectClass parent_class;
+};
+
+GType source_model_get_type(void);
+
+SourceModel *source_model_new(void);
+
+void source_model_append(SourceModel *model, const gchar *title,
+			 const gchar *objectid, const gchar *mime,
+			 GtkTreeIter *iter);
+void source_model_append_pending(SourceModel *model, const gchar *title,
+				 const gchar *objectid, const gchar *mime);
+guint source_model_flush(SourceModel *model, guint max_rows);
+guint source_model_get_n_pending(SourceModel *model);
+void source_model_set(SourceModel *model, GtkTreeIter *iter,
+		      const gchar *title, const gchar *objectid,
+		      const gchar *mime);
+void source_model_remove(SourceModel *model, GtkTreeIter *iter);
+void source_model_truncate(SourceModel *model, guint length);
+void source_model_clear(SourceModel *model);
+void source_model_copy(SourceModel *dest, SourceModel *src);
+guint source_model_merge(SourceModel *dest, SourceModel *src);
+
+const SourceModelRow *source_model_get_row(SourceModel *model,
+					   GtkTreeIter *iter);
+gboolean source_model_lookup(SourceModel *model, const gchar *objectid,
+			     GtkTreeIter *iter);
+gboolean source_model_find(SourceModel *model, const gchar *objectid,
+			   GtkTreeIter *iter);
+const SourceModelRow *source_model_get_nth_row(SourceModel *model,
+					       guint index);
+guint source_model_get_length(SourceModel *model);
+gsize source_model_get_bytes_saved(SourceModel *model);
+
+void source_model_set_title_index(SourceModel *model, gboolean enabled);
+GArray *source_model_match_titles(SourceModel *model, const gchar *needle);
+void source_model_filter_titles(SourceModel *model, const gchar *needle);
+
+#endif /* __SOURCEMODEL_H__ */
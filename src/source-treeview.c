@@ -20,14 +20,20 @@
  *
  */
 
-#include <sys/time.h>
 #include <string.h>
 #include <stdlib.h>
 #include <config.h>
 
+#include <glib/gstdio.h>
 #include <libmafw/mafw.h>
 
 #include "source-treeview.h"
+#include "source-model.h"
+#include "browse-cache.h"
+#include "title-cache.h"
+#include "browse-metrics.h"
+#include "browse-scheduler.h"
+#include "view-snapshot.h"
 #include "playlist-treeview.h"
 #include "metadata-view.h"
 #include "renderer-combo.h"
@@ -44,19 +50,23 @@ extern GtkWidget *main_window;
 /** GtkTreeView* that displays the model contents */
 static GtkWidget *treeview;
 
-/** A GtkListStore* that contains only the current container contents */
+/** A SourceModel* that contains only the current container contents */
 static GtkTreeModel *model;
 
-/** A cache that receives the items initially and that is purged every once
-    in a while to the real model. */
-static GtkTreeModel *cache;
-
 /** Button that is used to go up in the tree hierarchy */
 static GtkWidget* up_button;
 
 /** Browse view optimization mode */
 static SourceModelBehaviour model_behaviour;
 
+/** Filter and sort criteria of browse requests, see "Search and sort" */
+static gchar *search_filter = NULL;
+static const gchar *search_sort = "";
+
+/** Whether the search text filters the loaded rows locally. The model
+    keeps all the rows of the container but shows only the matching ones. */
+static gboolean local_filtered = FALSE;
+
 /*****************************************************************************
  * Function prototypes
  *****************************************************************************/
@@ -65,7 +75,25 @@ static void
 browse (MafwSource *source, const gchar *object_id, guint skip, guint count);
 
 static void
-cancel_browse (const gchar* objectid, guint browse_id);
+cancel_browse (guint browse_id);
+
+static void
+flush_pending_now (void);
+
+static void
+cache_current_container (void);
+
+static gchar *
+search_walk_filter (void);
+
+static void
+local_filter_reset (void);
+
+static void
+snapshot_forget (void);
+
+static void
+aggregate_cancel (void);
 
 static void
 display_sources(void);
@@ -79,43 +107,24 @@ on_source_up_button_clicked (GtkButton* button, gpointer user_data);
 static gboolean
 find_objectid (const gchar* objectid, GtkTreeIter* iter);
 
+static gboolean
+is_loaded (const gchar *objectid);
+
+static void
+browse_cb (MafwSource *source, guint browseid, gint remaining_count,
+	   guint index, const gchar *objectid, GHashTable *metadata,
+	   gpointer user_data, const GError *error);
+
 /*****************************************************************************
  * Source tree structure
  *****************************************************************************/
 
 enum {
-	COLUMN_TITLE,
-	COLUMN_OBJECTID,
-	COLUMN_MIME,
-	COLUMNS
+	COLUMN_TITLE = SOURCE_MODEL_COLUMN_TITLE,
+	COLUMN_OBJECTID = SOURCE_MODEL_COLUMN_OBJECTID,
+	COLUMN_MIME = SOURCE_MODEL_COLUMN_MIME
 };
 
-/*****************************************************************************
- * Performance measurement functions
- *****************************************************************************/
-
-static struct timeval perf_start_time;
-static struct timeval perf_end_time;
-static guint          perf_num;
-
-static void perf_start(void)
-{
-	memset(&perf_start_time, 0, sizeof(struct timeval));
-	memset(&perf_end_time, 0, sizeof(struct timeval));
-	perf_num = 0;
-
-	gettimeofday(&perf_start_time, NULL);
-}
-
-static void perf_end(void)
-{
-	gettimeofday(&perf_end_time, NULL);
-
-	printf("\nBrowsed %d items in %lu.%lu seconds\n", perf_num,
-	       perf_end_time.tv_sec - perf_start_time.tv_sec,
-	       perf_end_time.tv_usec - perf_start_time.tv_usec);
-}
-
 /*****************************************************************************
  * Hard key handlers
  *****************************************************************************/
@@ -231,11 +240,54 @@ typedef struct _ContainerStackItem
 	/** Last browse ID */
 	guint browseid;
 
+	/** Paged mode: a PageState for each known page of the container */
+	GByteArray *pages;
+
+	/** Paged mode: page requests in flight, browse ID -> PageRequest */
+	GHashTable *page_requests;
+
+	/** Showing all the items under the container instead of its
+	    children */
+	gboolean flatten;
+
+	/** Showing the contents of the path @objectid in all the sources */
+	gboolean aggregate;
+
+	/** Object IDs of the selected row and of the topmost visible row,
+	    saved when a child container is entered */
+	gchar *selected;
+	gchar *top;
+
+	/** Row numbers of the rows above, or -1. Paged contents are only
+	    known once the pages holding these rows have been loaded. */
+	gint selected_row;
+	gint top_row;
+
+	/** Copy of the contents, saved with the rows above if they were
+	    complete, or in paged mode with the placeholders of the pages
+	    that were not loaded */
+	SourceModel *contents;
+
 } ContainerStackItem;
 
 /** This queue keeps track of the current container path we are browsing in */
 static GQueue *container_stack = NULL;
 
+static void
+paged_reset (ContainerStackItem *item, gboolean keep_state);
+
+static gboolean
+paged_row_known (ContainerStackItem *item, gint row);
+
+static void
+paged_schedule_update (void);
+
+static void
+container_stack_drop_state (ContainerStackItem *item);
+
+static gboolean
+is_complete (ContainerStackItem *item);
+
 /**
  * container_stack_push:
  * @objectid: An object ID belonging to a container
@@ -252,6 +304,9 @@ static void container_stack_push(const gchar* objectid)
 
 	item = g_new0(ContainerStackItem, 1);
 	item->objectid = g_strdup(objectid);
+	item->browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+	item->selected_row = -1;
+	item->top_row = -1;
 
 	g_queue_push_head(container_stack, item);
 }
@@ -276,8 +331,14 @@ static gboolean container_stack_pop(gchar** objectid, guint* browseid)
 	item = g_queue_pop_head(container_stack);
 	if (item != NULL)
 	{
+		/* Outstanding page requests die with the stack item */
+		paged_reset(item, FALSE);
+		container_stack_drop_state(item);
+
 		if (objectid != NULL)
 			*objectid = item->objectid;
+		else
+			g_free(item->objectid);
 		if (browseid != NULL)
 			*browseid = item->browseid;
 
@@ -327,6 +388,21 @@ static gboolean container_stack_poke_browseid(guint browseid)
  * Container stack peek functions
  *****************************************************************************/
 
+/**
+ * container_stack_peek_item:
+ *
+ * Get the topmost container stack item without removing it.
+ *
+ * Returns the item or %NULL if the stack is empty
+ */
+static ContainerStackItem *container_stack_peek_item(void)
+{
+	if (container_stack == NULL)
+		return NULL;
+
+	return g_queue_peek_head(container_stack);
+}
+
 /**
  * container_stack_peek_objectid:
  * @objectid: A pointer to store the object ID to
@@ -385,6 +461,251 @@ static gboolean container_stack_peek_browseid(guint* browseid)
 	}
 }
 
+/*****************************************************************************
+ * Container stack view state
+ *
+ * When a child container is entered, the parent's stack item remembers the
+ * selected row, the topmost visible row and, if they were complete, the
+ * contents. Paged contents are kept as far as they were loaded, along with
+ * the pages that were. Going back up shows the parent as it was left, at
+ * once, and only the pages that were not loaded yet are requested. If the
+ * contents have to be browsed again, the rows are restored once the browse
+ * is complete.
+ *****************************************************************************/
+
+/**
+ * Forget the saved view state of @item
+ */
+static void
+container_stack_drop_state (ContainerStackItem *item)
+{
+	g_free (item->selected);
+	item->selected = NULL;
+	g_free (item->top);
+	item->top = NULL;
+	item->selected_row = -1;
+	item->top_row = -1;
+
+	if (item->contents != NULL)
+	{
+		g_object_unref (item->contents);
+		item->contents = NULL;
+	}
+}
+
+/**
+ * Save the view state of the topmost container before entering a child
+ * container
+ */
+static void
+container_stack_save_state (void)
+{
+	ContainerStackItem *item;
+	GtkTreeSelection *selection;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+
+	item = container_stack_peek_item ();
+	if (item == NULL)
+		return;
+
+	container_stack_drop_state (item);
+
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview));
+	if (gtk_tree_selection_get_selected (selection, NULL, &iter) == TRUE)
+	{
+		gtk_tree_model_get (model, &iter, COLUMN_OBJECTID,
+				    &item->selected, -1);
+		path = gtk_tree_model_get_path (model, &iter);
+		item->selected_row = gtk_tree_path_get_indices (path)[0];
+		gtk_tree_path_free (path);
+	}
+
+	if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (treeview), &path,
+					     NULL) == TRUE)
+	{
+		if (gtk_tree_model_get_iter (model, &iter, path) == TRUE)
+		{
+			gtk_tree_model_get (model, &iter, COLUMN_OBJECTID,
+					    &item->top, -1);
+			item->top_row = gtk_tree_path_get_indices (path)[0];
+		}
+		gtk_tree_path_free (path);
+	}
+
+	if (is_complete (item) == TRUE || item->pages != NULL)
+	{
+		/* Including the rows filtered out locally */
+		item->contents = source_model_new ();
+		source_model_copy (item->contents, SOURCE_MODEL (model));
+	}
+}
+
+/**
+ * Put the saved contents of the topmost container back to the model.
+ *
+ * Returns %FALSE if there were no saved contents.
+ */
+static gboolean
+container_stack_restore_contents (void)
+{
+	ContainerStackItem *item;
+
+	item = container_stack_peek_item ();
+	if (item == NULL)
+		return FALSE;
+
+	/* The loaded pages are of no use without their rows, nor if the
+	   model behaviour has changed since */
+	if (item->pages != NULL &&
+	    (item->contents == NULL || model_behaviour != SourceModelPaged))
+	{
+		paged_reset (item, FALSE);
+		if (item->contents != NULL)
+		{
+			g_object_unref (item->contents);
+			item->contents = NULL;
+		}
+	}
+
+	if (item->contents == NULL)
+		return FALSE;
+
+	/* Don't make the view follow every inserted row */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), NULL);
+
+	source_model_copy (SOURCE_MODEL (model), item->contents);
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), model);
+	g_object_unref (model);
+
+	g_object_unref (item->contents);
+	item->contents = NULL;
+
+	/* Nothing is being browsed for this container */
+	item->browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+
+	/* Fetch the pages that were not loaded when the container was
+	   left, if they are in view */
+	if (item->pages != NULL)
+		paged_schedule_update ();
+
+	return TRUE;
+}
+
+/**
+ * Select and scroll to the saved rows of the topmost container, once its
+ * contents are complete
+ */
+static void
+container_stack_restore_state (void)
+{
+	ContainerStackItem *item;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gint row;
+
+	item = container_stack_peek_item ();
+	if (item == NULL || item->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		return;
+
+	/* Paged contents arrive a page at a time. Scroll towards the saved
+	   rows so that their pages get loaded; this is called again when a
+	   page has been loaded. */
+	if (item->pages != NULL &&
+	    (paged_row_known (item, item->selected_row) == FALSE ||
+	     paged_row_known (item, item->top_row) == FALSE))
+	{
+		row = MAX (item->top_row, item->selected_row);
+		row = MIN (row, (gint) source_model_get_length (
+				   SOURCE_MODEL (model)) - 1);
+		if (row >= 0)
+		{
+			path = gtk_tree_path_new_from_indices (row, -1);
+			gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (treeview),
+						      path, NULL, TRUE,
+						      0.0, 0.0);
+			gtk_tree_path_free (path);
+		}
+		return;
+	}
+
+	if (item->selected != NULL &&
+	    find_objectid (item->selected, &iter) == TRUE)
+	{
+		path = gtk_tree_model_get_path (model, &iter);
+		gtk_tree_view_set_cursor (GTK_TREE_VIEW (treeview), path,
+					  NULL, FALSE);
+		gtk_tree_path_free (path);
+	}
+
+	/* After the cursor, which scrolls to itself */
+	if (item->top != NULL && find_objectid (item->top, &iter) == TRUE)
+	{
+		path = gtk_tree_model_get_path (model, &iter);
+		gtk_tree_view_scroll_to_cell (GTK_TREE_VIEW (treeview), path,
+					      NULL, TRUE, 0.0, 0.0);
+		gtk_tree_path_free (path);
+	}
+
+	container_stack_drop_state (item);
+}
+
+/**
+ * The contents of the container @objectid have changed, or of all the
+ * containers if @objectid is %NULL. Forget the saved copies of them.
+ */
+static void
+container_stack_invalidate (const gchar *objectid)
+{
+	ContainerStackItem *item;
+	GList *node;
+
+	if (container_stack == NULL)
+		return;
+
+	for (node = container_stack->head; node != NULL; node = node->next)
+	{
+		item = node->data;
+		if (item->contents == NULL)
+			continue;
+
+		if (objectid == NULL || strcmp (item->objectid, objectid) == 0)
+		{
+			g_object_unref (item->contents);
+			item->contents = NULL;
+		}
+	}
+}
+
+/**
+ * Forget the saved copies of the containers that include the item
+ * @objectid, since their copy of its metadata is out of date
+ */
+static void
+container_stack_invalidate_item (const gchar *objectid)
+{
+	ContainerStackItem *item;
+	GtkTreeIter iter;
+	GList *node;
+
+	if (container_stack == NULL)
+		return;
+
+	for (node = container_stack->head; node != NULL; node = node->next)
+	{
+		item = node->data;
+		if (item->contents != NULL &&
+		    source_model_lookup (item->contents, objectid,
+					 &iter) == TRUE)
+		{
+			g_object_unref (item->contents);
+			item->contents = NULL;
+		}
+	}
+}
+
 /*****************************************************************************
  * Source model behaviour
  *****************************************************************************/
@@ -395,14 +716,18 @@ static gboolean container_stack_peek_browseid(guint* browseid)
  * If @behaviour == #SourceModelNormal, each browse result item is appended
  * to the list model when the item arrives.
  *
- * If @behaviour == #SourceModelCached, each browse result item is appended
- * to a cache list model when the item arrives. The cache contents are purged
- * to the actual list model in intervals of 20 items.
+ * If @behaviour == #SourceModelCached, each browse result item is stored
+ * to the list model as a pending row when the item arrives. Pending rows are
+ * flushed to the view in batches that fit in the flush budget per frame.
  *
  * If @behaviour == #SourceModelDetached, the actual list model is detached
  * from the tree view when browse() is called, items are appended to the model
  * one by one, and the model is then re-attached when the last browse result
  * arrives.
+ *
+ * If @behaviour == #SourceModelPaged, the container is browsed in pages of
+ * %PAGE_SIZE items. Only the pages around the visible part of the view are
+ * requested, and the model holds placeholder rows for the rest.
  */
 void
 source_treeview_set_model_behaviour(SourceModelBehaviour behaviour)
@@ -411,15 +736,18 @@ source_treeview_set_model_behaviour(SourceModelBehaviour behaviour)
 	if (model_behaviour == behaviour)
 		return;
 
-	if ((behaviour == SourceModelNormal || behaviour == SourceModelCached)
+	if (behaviour != SourceModelDetached
 	    && gtk_tree_view_get_model (GTK_TREE_VIEW (treeview)) == NULL)
 	{
 		/* Model is currently detached, and user wants to see the
-		   attached model (cached or normal). Re-attach it. */
+		   attached model (cached, normal or paged). Re-attach it. */
 		gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), model);
 		g_object_unref (model);
 	}
 
+	/* Don't leave anything pending that the cached mode would flush */
+	flush_pending_now ();
+
 	model_behaviour = behaviour;
 }
 
@@ -429,19 +757,49 @@ source_treeview_get_model_behaviour(void)
 	return model_behaviour;
 }
 
+/**
+ * Get a short lowercase name for @behaviour, for reports
+ */
+const gchar *
+source_treeview_behaviour_name(SourceModelBehaviour behaviour)
+{
+	switch (behaviour)
+	{
+		case SourceModelDetached:
+			return "detached";
+		case SourceModelCached:
+			return "cached";
+		case SourceModelNormal:
+			return "normal";
+		case SourceModelPaged:
+			return "paged";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Get the number of bytes saved by sharing the MIME types of the rows of the
+ * current container
+ */
+gsize
+source_treeview_get_bytes_saved(void)
+{
+	return source_model_get_bytes_saved (SOURCE_MODEL (model));
+}
+
 /*****************************************************************************
  * Item adding/updating
  *****************************************************************************/
 
 /**
- * Update the metadata of the given item.
+ * Extract the displayed title and MIME type of an item from its metadata.
+ * The returned strings are owned by @metadata (or @objectid).
  */
 static void
-update_model_item (GtkTreeModel* tree_model, GtkTreeIter* iter,
-		   const gchar *objectid, GHashTable* metadata)
+get_item_strings (const gchar *objectid, GHashTable* metadata,
+		  const gchar **title, const gchar **mime)
 {
-	const gchar *title;
-	const gchar *mime;
 	GValue *mval;
 
 	if (metadata != NULL)
@@ -455,131 +813,2228 @@ update_model_item (GtkTreeModel* tree_model, GtkTreeIter* iter,
 		}
 
 		if (mval != NULL) {
-			title = g_value_get_string(mval);
-			if (title && strcmp(title, "") == 0) {
-				title = "Unknown";
+			*title = g_value_get_string(mval);
+			if (*title && strcmp(*title, "") == 0) {
+				*title = "Unknown";
 			}
 		} else {
-			title = objectid;
+			*title = objectid;
 		}
 
 		/* Mime type */
 		mval = mafw_metadata_first(metadata, MAFW_METADATA_KEY_MIME);
 		if (mval != NULL)
-			mime = g_value_get_string(mval);
+			*mime = g_value_get_string(mval);
 		else
-			mime = "unknown";
+			*mime = "unknown";
 	}
 	else
 	{
 		g_warning ("Got NULL metadata for objectid %s.\n", objectid);
 
-		title = objectid;
-		mime = "unknown";
+		*title = objectid;
+		*mime = "unknown";
 	}
-
-	/* Append the item */
-	gtk_list_store_set (GTK_LIST_STORE (tree_model), iter,
-			    COLUMN_TITLE, title,
-			    COLUMN_OBJECTID, objectid,
-			    COLUMN_MIME, mime,
-			    -1);
 }
 
 /**
- * Append the given object ID and its metadata to the end of the tree model
+ * Tag @title with the name of the source of @objectid, as the items are
+ * shown when browsing all sources. Returns a newly allocated string.
  */
-static void
-append_model_item (const gchar* objectid, GHashTable* metadata)
+static gchar *
+tag_title (const gchar *objectid, const gchar *title)
 {
-	GtkTreeModel* tree_model;
-	GtkTreeIter iter;
+	MafwExtension *extension = NULL;
+	gchar *uuid = NULL;
 
-	if (model_behaviour == SourceModelCached)
-		tree_model = cache;
-	else
-		tree_model = model;
+	mafw_source_split_objectid (objectid, &uuid, NULL);
+	if (uuid != NULL)
+		extension = mafw_registry_get_extension_by_uuid (
+			mafw_registry_get_instance (), uuid);
+	g_free (uuid);
 
-	gtk_list_store_append (GTK_LIST_STORE (tree_model), &iter);
-	update_model_item (tree_model, &iter, objectid, metadata);
+	if (extension == NULL)
+		return g_strdup (title);
+
+	return g_strdup_printf ("%s (%s)", title,
+				mafw_extension_get_name (extension));
 }
 
 /**
- * Bounce one item from the cache model into the real model
+ * Update the metadata of the given item.
  */
-static gboolean
-purge_foreach (GtkTreeModel *cache, GtkTreePath *path, GtkTreeIter *iter,
-	       gpointer data)
+static void
+update_model_item (GtkTreeModel* tree_model, GtkTreeIter* iter,
+		   const gchar *objectid, GHashTable* metadata)
 {
-	GtkTreeIter realiter;
-	gchar* title;
-	gchar* objectid;
-	gchar* mime;
-
-	gtk_tree_model_get (cache, iter,
-			    COLUMN_TITLE, &title,
-			    COLUMN_OBJECTID, &objectid,
-			    COLUMN_MIME, &mime,
-			    -1);
+	ContainerStackItem *item;
+	const gchar *title;
+	const gchar *mime;
+	gchar *tagged;
 
-	gtk_list_store_append (GTK_LIST_STORE (model), &realiter);
-	gtk_list_store_set (GTK_LIST_STORE (model), &realiter,
-			    COLUMN_TITLE, title,
-			    COLUMN_OBJECTID, objectid,
-			    COLUMN_MIME, mime,
-			    -1);
+	get_item_strings (objectid, metadata, &title, &mime);
 
-	g_free(title);
-	g_free(objectid);
-	g_free(mime);
+	/* Keep the source tag of an item shown with all sources */
+	item = container_stack_peek_item ();
+	if (item != NULL && item->aggregate == TRUE)
+	{
+		tagged = tag_title (objectid, title);
+		source_model_set (SOURCE_MODEL (tree_model), iter,
+				  tagged, objectid, mime);
+		g_free (tagged);
+		return;
+	}
 
-	return FALSE;
+	source_model_set (SOURCE_MODEL (tree_model), iter,
+			  title, objectid, mime);
 }
 
 /**
- * Bounce the complete contents of the cache model into the real model
+ * Append the given object ID and its metadata to the end of the tree model
  */
-static gboolean
-purge_cache_idle (gpointer data)
+static void
+append_model_item (const gchar* objectid, GHashTable* metadata)
 {
-	gtk_tree_model_foreach (cache, purge_foreach, NULL);
-	gtk_list_store_clear (GTK_LIST_STORE (cache));
-	return FALSE;
+	const gchar *title;
+	const gchar *mime;
+
+	get_item_strings (objectid, metadata, &title, &mime);
+	if (model_behaviour == SourceModelCached)
+		source_model_append_pending (SOURCE_MODEL (model),
+					     title, objectid, mime);
+	else
+		source_model_append (SOURCE_MODEL (model), title, objectid,
+				     mime, NULL);
 }
 
 /*****************************************************************************
- * Browse
+ * Cached mode flushing
  *****************************************************************************/
 
-#ifndef G_DEBUG_DISABLE
-static void
-print_metadata (gpointer key, gpointer value, gpointer user_data)
-{
-	gchar* contents;
+/** Default time that one flush may take, in milliseconds */
+#define FLUSH_DEFAULT_BUDGET 8
 
-        if (G_IS_VALUE (value))
-                contents = g_strdup_value_contents ((GValue*) value);
-        else {
-                GValue *real_value;
+/** Limits for the number of rows flushed at once */
+#define FLUSH_MIN_BATCH 10
+#define FLUSH_MAX_BATCH 5000
 
-                real_value = g_value_array_get_nth (value, 0);
-                contents = g_strdup_value_contents (real_value);
-        }
+/** A result arriving later than this after the previous one, in seconds,
+    means that the source is slow and the result is shown right away */
+#define FLUSH_SLOW_SOURCE_GAP 0.1
 
-	g_debug ("\t%s = %s\n", (gchar*) key, contents);
+/** Time budget for one flush, in seconds */
+static gdouble flush_budget = FLUSH_DEFAULT_BUDGET / 1000.0;
 
-	g_free (contents);
-}
-#endif
+/** Number of rows to flush next time */
+static guint flush_batch = FLUSH_MIN_BATCH;
+
+/** Idle source that flushes the pending rows, 0 if none */
+static guint flush_id = 0;
+
+/** Time since the previous browse result */
+static GTimer *flush_result_timer = NULL;
 
 /**
- * Browse result callback
+ * Flush one batch of pending rows and adjust the batch size according to how
+ * long it took.
  */
-static void
-browse_cb (MafwSource *source, guint browseid, gint remaining_count,
-	   guint index, const gchar *objectid, GHashTable *metadata,
-	   gpointer user_data, const GError *error)
+static gboolean
+flush_pending_idle (gpointer data)
+{
+	static GTimer *timer = NULL;
+	gdouble elapsed;
+	guint flushed;
+
+	if (timer == NULL)
+		timer = g_timer_new ();
+
+	g_timer_start (timer);
+	flushed = source_model_flush (SOURCE_MODEL (model), flush_batch);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	if (elapsed > flush_budget)
+	{
+		/* Too slow, the view would stutter */
+		flush_batch = MAX (flush_batch / 2, FLUSH_MIN_BATCH);
+	}
+	else if (elapsed < flush_budget / 2 && flushed == flush_batch &&
+		 source_model_get_n_pending (SOURCE_MODEL (model)) > 0)
+	{
+		/* Results are coming in faster than they are flushed and
+		   there is time for more */
+		flush_batch = MIN (flush_batch * 2, FLUSH_MAX_BATCH);
+	}
+
+	if (source_model_get_n_pending (SOURCE_MODEL (model)) > 0)
+		return TRUE;
+
+	flush_id = 0;
+	return FALSE;
+}
+
+/**
+ * Flush all pending rows immediately
+ */
+static void
+flush_pending_now (void)
+{
+	if (flush_id != 0)
+	{
+		g_source_remove (flush_id);
+		flush_id = 0;
+	}
+
+	source_model_flush (SOURCE_MODEL (model), G_MAXUINT);
+}
+
+/**
+ * A browse result has been added as a pending row. Decide when to show it.
+ */
+static void
+flush_pending (void)
+{
+	gboolean slow;
+
+	if (flush_result_timer == NULL)
+	{
+		flush_result_timer = g_timer_new ();
+		slow = TRUE;
+	}
+	else
+	{
+		slow = g_timer_elapsed (flush_result_timer, NULL) >
+			FLUSH_SLOW_SOURCE_GAP;
+	}
+	g_timer_start (flush_result_timer);
+
+	if (slow == TRUE)
+	{
+		/* Don't keep the user waiting for a batch to fill up */
+		flush_batch = FLUSH_MIN_BATCH;
+		flush_pending_now ();
+	}
+	else if (flush_id == 0)
+	{
+		/* Everything that arrives before the idle runs is flushed in
+		   the same batch. Use a lower priority than redrawing so that
+		   the view gets updated between batches. */
+		flush_id = g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+					    flush_pending_idle, NULL, NULL);
+	}
+}
+
+/**
+ * Set the time that one flush of the cached mode may take, in milliseconds
+ */
+void
+source_treeview_set_flush_budget (guint msec)
+{
+	flush_budget = MAX (msec, 1) / 1000.0;
+}
+
+/*****************************************************************************
+ * Paged browsing
+ *****************************************************************************/
+
+/** Number of items fetched with one browse request in paged mode */
+#define PAGE_SIZE 50
+
+/** Number of rows above and below the visible range that are kept loaded */
+#define PAGE_READ_AHEAD 100
+
+/** Most pages of placeholders added at once while the end of the container
+    is not known */
+#define PAGE_MAX_GROWTH 16
+
+typedef enum {
+	PageUnloaded,
+	PageRequested,
+	PageLoaded
+} PageState;
+
+/** An outstanding request for one page of the current container */
+typedef struct _PageRequest
+{
+	/** Page number, the first item is at page * PAGE_SIZE */
+	guint page;
+
+	/** Number of results received so far */
+	guint received;
+
+} PageRequest;
+
+/** Idle source that re-evaluates the visible range */
+static guint paged_update_id = 0;
+
+/**
+ * Cancel all outstanding page requests of @item. Unless @keep_state is set,
+ * forget which pages have been loaded as well.
+ */
+static void
+paged_reset (ContainerStackItem *item, gboolean keep_state)
+{
+	if (item->page_requests != NULL)
+	{
+		GHashTableIter iter;
+		gpointer key;
+		PageRequest *request;
+
+		g_hash_table_iter_init (&iter, item->page_requests);
+		while (g_hash_table_iter_next (&iter, &key,
+					       (gpointer *) &request))
+		{
+			cancel_browse (GPOINTER_TO_UINT (key));
+			if (item->pages != NULL &&
+			    request->page < item->pages->len)
+				item->pages->data[request->page] = PageUnloaded;
+		}
+		g_hash_table_remove_all (item->page_requests);
+	}
+
+	if (keep_state == FALSE)
+	{
+		if (item->page_requests != NULL)
+			g_hash_table_destroy (item->page_requests);
+		item->page_requests = NULL;
+
+		if (item->pages != NULL)
+			g_byte_array_free (item->pages, TRUE);
+		item->pages = NULL;
+	}
+}
+
+/**
+ * Cancel the requests of @item for the pages from @first_page onwards
+ */
+static void
+paged_cancel_from (ContainerStackItem *item, guint first_page)
+{
+	GHashTableIter iter;
+	gpointer key;
+	PageRequest *request;
+
+	g_hash_table_iter_init (&iter, item->page_requests);
+	while (g_hash_table_iter_next (&iter, &key, (gpointer *) &request))
+	{
+		if (request->page < first_page)
+			continue;
+
+		cancel_browse (GPOINTER_TO_UINT (key));
+		if (request->page < item->pages->len)
+			item->pages->data[request->page] = PageUnloaded;
+		g_hash_table_iter_remove (&iter);
+	}
+}
+
+/**
+ * Add placeholder rows for @count more pages at the end of the model
+ */
+static void
+paged_add_pages (ContainerStackItem *item, guint count)
+{
+	const guint8 state = PageUnloaded;
+	guint i;
+
+	for (i = 0; i < count; i++)
+		g_byte_array_append (item->pages, &state, 1);
+	for (i = 0; i < count * PAGE_SIZE; i++)
+		source_model_append (SOURCE_MODEL (model), NULL, NULL, NULL,
+				     NULL);
+}
+
+/**
+ * Whether the contents of @row of @item are known: its page has been loaded,
+ * or the container turned out to end before it. A @row of -1 is always known.
+ */
+static gboolean
+paged_row_known (ContainerStackItem *item, gint row)
+{
+	guint page;
+	guint len;
+
+	if (row < 0)
+		return TRUE;
+
+	page = row / PAGE_SIZE;
+	len = item->pages->len;
+	if (page < len)
+		return item->pages->data[page] == PageLoaded;
+
+	/* Beyond the pages added so far. Known only if the end is. */
+	return len > 0 && item->pages->data[len - 1] == PageLoaded &&
+		source_model_get_length (SOURCE_MODEL (model)) <
+		len * PAGE_SIZE;
+}
+
+/**
+ * Issue a browse request for one page of the topmost container
+ */
+static gboolean
+paged_request_page (MafwSource *source, ContainerStackItem *item, guint page)
+{
+	const gchar *const *metadata_keys;
+	PageRequest *request;
+	guint browse_id;
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	browse_id = browse_scheduler_submit (source, item->objectid,
+					     FALSE, /* Recursive */
+					     search_filter,
+					     search_sort,
+					     metadata_keys,
+					     page * PAGE_SIZE,
+					     PAGE_SIZE,
+					     BrowsePriorityNavigation,
+					     browse_cb,
+					     NULL);
+	if (browse_id == MAFW_SOURCE_INVALID_BROWSE_ID)
+		return FALSE;
+
+	request = g_new0 (PageRequest, 1);
+	request->page = page;
+	g_hash_table_insert (item->page_requests, GUINT_TO_POINTER (browse_id),
+			     request);
+	item->pages->data[page] = PageRequested;
+
+	return TRUE;
+}
+
+/**
+ * Request the pages that are visible or within the read-ahead margin, and
+ * cancel the requests for pages that have been scrolled away from.
+ */
+static gboolean
+paged_update_idle (gpointer data)
+{
+	ContainerStackItem *item;
+	MafwSource *source;
+	GtkTreePath *start, *end;
+	GHashTableIter iter;
+	gpointer key;
+	PageRequest *request;
+	guint first = 0, last = 0;
+	guint first_page, last_page, page;
+
+	paged_update_id = 0;
+
+	item = container_stack_peek_item ();
+	if (item == NULL || item->pages == NULL || item->pages->len == 0)
+		return FALSE;
+
+	source = get_selected_source ();
+	if (source == NULL)
+		return FALSE;
+
+	if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (treeview),
+					     &start, &end) == TRUE)
+	{
+		first = gtk_tree_path_get_indices (start)[0];
+		last = gtk_tree_path_get_indices (end)[0];
+		gtk_tree_path_free (start);
+		gtk_tree_path_free (end);
+	}
+
+	first = first > PAGE_READ_AHEAD ? first - PAGE_READ_AHEAD : 0;
+	last = last + PAGE_READ_AHEAD;
+	first_page = first / PAGE_SIZE;
+	last_page = MIN (last / PAGE_SIZE, item->pages->len - 1);
+
+	/* Cancel the requests that have gone out of range */
+	g_hash_table_iter_init (&iter, item->page_requests);
+	while (g_hash_table_iter_next (&iter, &key, (gpointer *) &request))
+	{
+		if (request->page >= first_page && request->page <= last_page)
+			continue;
+
+		cancel_browse (GPOINTER_TO_UINT (key));
+		if (request->page < item->pages->len)
+			item->pages->data[request->page] = PageUnloaded;
+		g_hash_table_iter_remove (&iter);
+	}
+
+	/* Fetch the pages that are needed and not loaded yet */
+	for (page = first_page; page <= last_page; page++)
+	{
+		if (item->pages->data[page] == PageUnloaded)
+			paged_request_page (source, item, page);
+	}
+
+	return FALSE;
+}
+
+static void
+paged_schedule_update (void)
+{
+	/* Let the view lay itself out first */
+	if (paged_update_id == 0)
+		paged_update_id = g_idle_add_full (G_PRIORITY_LOW,
+						   paged_update_idle,
+						   NULL, NULL);
+}
+
+/**
+ * Start browsing the topmost container of the container stack page by page
+ */
+static gboolean
+paged_browse_start (MafwSource *source)
+{
+	ContainerStackItem *item;
+
+	item = container_stack_peek_item ();
+	g_return_val_if_fail (item != NULL, FALSE);
+
+	paged_reset (item, FALSE);
+	item->pages = g_byte_array_new ();
+	item->page_requests = g_hash_table_new_full (g_direct_hash,
+						     g_direct_equal,
+						     NULL, g_free);
+
+	source_model_clear (SOURCE_MODEL (model));
+
+	/* The size of the container is unknown. Start with one page of
+	   placeholders and add more as long as pages come back full. */
+	paged_add_pages (item, 1);
+	if (paged_request_page (source, item, 0) == FALSE)
+		return FALSE;
+
+	paged_schedule_update ();
+	return TRUE;
+}
+
+/**
+ * A page request has delivered its last result
+ */
+static void
+paged_page_done (ContainerStackItem *item, guint browseid,
+		 PageRequest *request)
+{
+	guint page = request->page;
+	guint received = request->received;
+
+	g_hash_table_remove (item->page_requests, GUINT_TO_POINTER (browseid));
+	if (page >= item->pages->len)
+		return;
+
+	item->pages->data[page] = PageLoaded;
+
+	if (received < PAGE_SIZE)
+	{
+		/* This is the last page. Drop the placeholders beyond it and
+		   the requests for them. */
+		paged_cancel_from (item, page + 1);
+		source_model_truncate (SOURCE_MODEL (model),
+				       page * PAGE_SIZE + received);
+		g_byte_array_set_size (item->pages, page + 1);
+	}
+	else if (page + 1 == item->pages->len)
+	{
+		/* The container may have more items. Add more pages the
+		   longer it turns out to be, so that the pages within reach
+		   are fetched side by side and the scroll bar soon tells
+		   roughly how long the container is. */
+		paged_add_pages (item, MIN (item->pages->len,
+					    PAGE_MAX_GROWTH));
+	}
+
+	/* Done once the end is known and the pages before it have
+	   arrived */
+	if (g_hash_table_size (item->page_requests) == 0 &&
+	    paged_row_known (item, item->pages->len * PAGE_SIZE) == TRUE)
+		browse_metrics_end ();
+
+	paged_schedule_update ();
+
+	/* Coming back up, this may be the page of the saved rows */
+	container_stack_restore_state ();
+}
+
+/**
+ * Handle a browse result that belongs to a page request of @item
+ */
+static void
+paged_browse_result (ContainerStackItem *item, PageRequest *request,
+		     guint browseid, gint remaining_count,
+		     const gchar *objectid, GHashTable *metadata,
+		     const GError *error)
+{
+	GtkTreeIter iter;
+
+	if (error != NULL)
+	{
+		if (request->page < item->pages->len)
+			item->pages->data[request->page] = PageUnloaded;
+		g_hash_table_remove (item->page_requests,
+				     GUINT_TO_POINTER (browseid));
+
+		hildon_banner_show_information (main_window, NULL,
+						error->message);
+		return;
+	}
+
+	/* Empty results carry no object ID */
+	if (objectid != NULL)
+	{
+		guint row = request->page * PAGE_SIZE + request->received;
+
+		request->received++;
+		browse_metrics_result ();
+
+		if (request->received <= PAGE_SIZE &&
+		    gtk_tree_model_iter_nth_child (model, &iter, NULL, row))
+			update_model_item (model, &iter, objectid, metadata);
+	}
+
+	if (remaining_count == 0)
+		paged_page_done (item, browseid, request);
+}
+
+/**
+ * Scrolling or resizing the view changes the set of pages that are needed
+ */
+static void
+on_source_view_scrolled (GtkAdjustment *adjustment, gpointer user_data)
+{
+	ContainerStackItem *item;
+
+	item = container_stack_peek_item ();
+	if (item != NULL && item->pages != NULL)
+		paged_schedule_update ();
+}
+
+/*****************************************************************************
+ * Speculative prefetch
+ *
+ * When the cursor rests on a container for a while, its contents are browsed
+ * in the background into a side buffer. Activating the container then shows
+ * the buffer immediately, or takes over the browse if it is still running.
+ *****************************************************************************/
+
+/** Time the cursor must rest on a container before it is prefetched, in
+    milliseconds */
+#define PREFETCH_DWELL 300
+
+typedef struct _Prefetch
+{
+	/** Source and object ID of the prefetched container, or %NULL when
+	    there is no prefetch */
+	MafwSource *source;
+	gchar *objectid;
+
+	/** Dwell timer, running until the browse is started */
+	guint dwell_id;
+
+	/** Browse ID while the browse is running */
+	guint browseid;
+
+	/** Results received so far */
+	SourceModel *buffer;
+	gboolean complete;
+
+} Prefetch;
+
+static gboolean prefetch_enabled = FALSE;
+static Prefetch prefetch = { NULL, NULL, 0, MAFW_SOURCE_INVALID_BROWSE_ID,
+			     NULL, FALSE };
+
+static guint prefetch_started = 0;
+static guint prefetch_hits = 0;
+static guint prefetch_adopted = 0;
+static guint prefetch_misses = 0;
+static guint prefetch_cancelled = 0;
+
+/**
+ * Stop the current prefetch, if any, and drop its results
+ */
+static void
+prefetch_cancel (void)
+{
+	if (prefetch.dwell_id != 0)
+		g_source_remove (prefetch.dwell_id);
+
+	if (prefetch.browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+	{
+		browse_scheduler_cancel (prefetch.browseid, NULL);
+		prefetch_cancelled++;
+	}
+
+	if (prefetch.buffer != NULL)
+		g_object_unref (prefetch.buffer);
+	if (prefetch.source != NULL)
+		g_object_unref (prefetch.source);
+	g_free (prefetch.objectid);
+
+	memset (&prefetch, 0, sizeof (prefetch));
+	prefetch.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+}
+
+static gboolean
+prefetch_dwell_timeout (gpointer data)
+{
+	const gchar *const *metadata_keys;
+	guint browseid;
+
+	prefetch.dwell_id = 0;
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	prefetch.buffer = source_model_new ();
+	browseid = browse_scheduler_submit (prefetch.source,
+					    prefetch.objectid, FALSE,
+					    search_filter, search_sort,
+					    metadata_keys, 0, 0,
+					    BrowsePriorityPrefetch, browse_cb,
+					    &prefetch);
+
+	/* Errors are not shown for speculative browsing. Activating the
+	   container will tell the user. */
+	if (browseid == MAFW_SOURCE_INVALID_BROWSE_ID)
+	{
+		prefetch_cancel ();
+	}
+	else
+	{
+		prefetch.browseid = browseid;
+		prefetch_started++;
+	}
+
+	return FALSE;
+}
+
+/**
+ * Handle a browse result with the prefetch as user data.
+ *
+ * Returns %TRUE if the result was consumed, or %FALSE if the browse has been
+ * adopted as the current browse and the result belongs to the view.
+ */
+static gboolean
+prefetch_browse_result (MafwSource *source, guint browseid,
+			gint remaining_count, const gchar *objectid,
+			GHashTable *metadata, const GError *error)
+{
+	guint current_browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+	const gchar *title;
+	const gchar *mime;
+
+	if (prefetch.source != source || prefetch.browseid != browseid)
+	{
+		/* Adopted, or the tail of a cancelled prefetch */
+		container_stack_peek_browseid (&current_browseid);
+		return current_browseid != browseid;
+	}
+
+	if (error != NULL)
+	{
+		/* The browse is over, there is nothing to cancel */
+		prefetch.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+		prefetch_cancel ();
+		return TRUE;
+	}
+
+	/* Empty containers give one result without an item */
+	if (objectid != NULL)
+	{
+		get_item_strings (objectid, metadata, &title, &mime);
+		source_model_append (prefetch.buffer, title, objectid, mime,
+				     NULL);
+	}
+
+	if (remaining_count == 0)
+	{
+		prefetch.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+		prefetch.complete = TRUE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Start prefetching the selected container after the dwell time, unless it
+ * is being prefetched already.
+ */
+static void
+on_source_selection_changed (GtkTreeSelection *selection, gpointer user_data)
+{
+	MafwSource *source = NULL;
+	gchar *objectid = NULL;
+
+	if (prefetch_enabled == FALSE || model_behaviour == SourceModelPaged)
+		return;
+
+	if (selected_is_container () == TRUE)
+		objectid = get_selected_object_id ();
+
+	if (objectid != NULL && prefetch.objectid != NULL &&
+	    strcmp (objectid, prefetch.objectid) == 0)
+	{
+		g_free (objectid);
+		return;
+	}
+
+	/* The selection has moved on */
+	prefetch_cancel ();
+
+	/* Cached containers are shown without browsing anyway */
+	if (objectid != NULL && browse_cache_contains (objectid) == FALSE)
+		source = get_selected_source ();
+
+	if (source != NULL)
+	{
+		prefetch.source = g_object_ref (source);
+		prefetch.objectid = objectid;
+		prefetch.dwell_id = g_timeout_add (PREFETCH_DWELL,
+						   prefetch_dwell_timeout,
+						   NULL);
+	}
+	else
+	{
+		g_free (objectid);
+	}
+}
+
+/**
+ * Show the prefetched contents of the container @object_id, and take over
+ * its browse if it is still running.
+ *
+ * Returns %FALSE if the container has not been prefetched.
+ */
+static gboolean
+adopt_prefetch (MafwSource *source, const gchar *object_id)
+{
+	SourceModel *buffer;
+	guint browseid;
+	gboolean complete;
+
+	if (prefetch_enabled == FALSE || model_behaviour == SourceModelPaged)
+		return FALSE;
+
+	if (prefetch.buffer == NULL || prefetch.source != source ||
+	    strcmp (prefetch.objectid, object_id) != 0)
+	{
+		prefetch_misses++;
+		prefetch_cancel ();
+		return FALSE;
+	}
+
+	/* Take the results and the browse over before touching the view,
+	   since selection changes cancel the prefetch */
+	buffer = g_object_ref (prefetch.buffer);
+	browseid = prefetch.browseid;
+	complete = prefetch.complete;
+	prefetch.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+	prefetch_cancel ();
+
+	/* Don't make the view follow every inserted row */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), NULL);
+
+	source_model_copy (SOURCE_MODEL (model), buffer);
+
+	if (complete == TRUE)
+	{
+		prefetch_hits++;
+		container_stack_poke_browseid (MAFW_SOURCE_INVALID_BROWSE_ID);
+	}
+	else
+	{
+		prefetch_adopted++;
+		browse_metrics_start (object_id, model_behaviour);
+		if (source_model_get_length (buffer) > 0)
+			browse_metrics_result ();
+
+		/* The rest of the results go to the view, and the browse is
+		   as urgent as any other navigation now */
+		browse_scheduler_promote (browseid);
+		container_stack_poke_browseid (browseid);
+	}
+
+	/* The detached model stays detached until the last result */
+	if (complete == TRUE || model_behaviour != SourceModelDetached)
+	{
+		gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), model);
+		g_object_unref (model);
+	}
+
+	g_object_unref (buffer);
+
+	return TRUE;
+}
+
+/**
+ * Enable or disable speculative prefetching of the selected container
+ */
+void
+source_treeview_set_prefetch(gboolean enabled)
+{
+	prefetch_enabled = enabled;
+	if (enabled == FALSE)
+		prefetch_cancel ();
+}
+
+/**
+ * Get the number of prefetches started, the number of activations served
+ * completely or partially from a prefetch, the number of activations that
+ * missed, and the number of prefetches cancelled before they finished. Any
+ * of the return locations can be %NULL.
+ */
+void
+source_treeview_get_prefetch_stats(guint *started, guint *hit_count,
+				   guint *adopted_count, guint *miss_count,
+				   guint *cancelled_count)
+{
+	if (started != NULL)
+		*started = prefetch_started;
+	if (hit_count != NULL)
+		*hit_count = prefetch_hits;
+	if (adopted_count != NULL)
+		*adopted_count = prefetch_adopted;
+	if (miss_count != NULL)
+		*miss_count = prefetch_misses;
+	if (cancelled_count != NULL)
+		*cancelled_count = prefetch_cancelled;
+}
+
+/*****************************************************************************
+ * Container refresh
+ *
+ * When the current container changes, it is browsed again into a shadow
+ * model, and only the differences are applied to the view, so that the view
+ * does not flicker and keeps its selection and scroll position.
+ *****************************************************************************/
+
+typedef struct _Refresh
+{
+	/** Source and object ID of the refreshed container, or %NULL when
+	    there is no refresh */
+	MafwSource *source;
+	gchar *objectid;
+
+	/** Browse ID while the browse is running */
+	guint browseid;
+
+	/** New contents of the container */
+	SourceModel *shadow;
+
+	/** The container changed again while it was being browsed */
+	gboolean again;
+
+} Refresh;
+
+static Refresh refresh = { NULL, NULL, MAFW_SOURCE_INVALID_BROWSE_ID, NULL,
+			   FALSE };
+
+/**
+ * Stop the current refresh, if any, and drop its results
+ */
+static void
+refresh_cancel (void)
+{
+	if (refresh.browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		browse_scheduler_cancel (refresh.browseid, NULL);
+
+	if (refresh.shadow != NULL)
+		g_object_unref (refresh.shadow);
+	if (refresh.source != NULL)
+		g_object_unref (refresh.source);
+	g_free (refresh.objectid);
+
+	memset (&refresh, 0, sizeof (refresh));
+	refresh.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+}
+
+/**
+ * Start browsing the container @objectid into a new shadow model
+ */
+static void
+refresh_start (MafwSource *source, const gchar *objectid)
+{
+	const gchar *const *metadata_keys;
+	guint browseid;
+
+	refresh_cancel ();
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	refresh.source = g_object_ref (source);
+	refresh.objectid = g_strdup (objectid);
+	refresh.shadow = source_model_new ();
+
+	browseid = browse_scheduler_submit (source, objectid, FALSE,
+					    search_filter, search_sort,
+					    metadata_keys, 0, 0,
+					    BrowsePriorityRefresh, browse_cb,
+					    &refresh);
+	if (browseid == MAFW_SOURCE_INVALID_BROWSE_ID)
+		refresh_cancel ();
+	else
+		refresh.browseid = browseid;
+}
+
+/**
+ * Apply @contents to the model with source_model_merge(), keeping the
+ * selected row selected and the topmost visible row at the top.
+ */
+static void
+merge_model (SourceModel *contents)
+{
+	GtkTreeSelection *selection;
+	GtkTreePath *start = NULL;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	gchar *selected;
+	gchar *top = NULL;
+	gint top_index = -1;
+
+	selected = get_selected_object_id ();
+	if (gtk_tree_view_get_visible_range (GTK_TREE_VIEW (treeview), &start,
+					     NULL) == TRUE)
+	{
+		if (gtk_tree_model_get_iter (model, &iter, start) == TRUE)
+		{
+			gtk_tree_model_get (model, &iter,
+					    COLUMN_OBJECTID, &top, -1);
+			top_index = gtk_tree_path_get_indices (start)[0];
+		}
+		gtk_tree_path_free (start);
+	}
+
+	if (source_model_merge (SOURCE_MODEL (model), contents) > 0)
+	{
+		/* Rows inserted or removed above it move the top row */
+		if (top != NULL && find_objectid (top, &iter) == TRUE)
+		{
+			path = gtk_tree_model_get_path (model, &iter);
+			if (gtk_tree_path_get_indices (path)[0] != top_index)
+				gtk_tree_view_scroll_to_cell (
+					GTK_TREE_VIEW (treeview), path, NULL,
+					TRUE, 0.0, 0.0);
+			gtk_tree_path_free (path);
+		}
+
+		/* Moved rows are inserted again, which loses the
+		   selection */
+		selection = gtk_tree_view_get_selection (
+			GTK_TREE_VIEW (treeview));
+		if (selected != NULL &&
+		    gtk_tree_selection_count_selected_rows (selection) == 0 &&
+		    find_objectid (selected, &iter) == TRUE)
+			gtk_tree_selection_select_iter (selection, &iter);
+	}
+
+	g_free (selected);
+	g_free (top);
+}
+
+/**
+ * The shadow model is complete. Apply it if the view still shows the same
+ * container, and start over if the container changed in the meantime.
+ */
+static void
+refresh_done (void)
+{
+	ContainerStackItem *item;
+	MafwSource *source;
+	gchar *objectid;
+
+	item = container_stack_peek_item ();
+	if (item != NULL && strcmp (item->objectid, refresh.objectid) == 0 &&
+	    item->browseid == MAFW_SOURCE_INVALID_BROWSE_ID &&
+	    item->pages == NULL)
+	{
+		/* Compare against all the rows of the container */
+		flush_pending_now ();
+		merge_model (refresh.shadow);
+
+		if (refresh.again == TRUE)
+		{
+			source = g_object_ref (refresh.source);
+			objectid = g_strdup (refresh.objectid);
+			refresh_start (source, objectid);
+			g_object_unref (source);
+			g_free (objectid);
+			return;
+		}
+	}
+
+	refresh_cancel ();
+}
+
+/**
+ * Handle a browse result with the refresh as user data. Results of
+ * cancelled refreshes are ignored.
+ */
+static void
+refresh_browse_result (MafwSource *source, guint browseid,
+		       gint remaining_count, const gchar *objectid,
+		       GHashTable *metadata, const GError *error)
+{
+	const gchar *title;
+	const gchar *mime;
+
+	if (refresh.source != source || refresh.browseid != browseid)
+		return;
+
+	if (error != NULL)
+	{
+		/* The browse is over, there is nothing to cancel */
+		refresh.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+		refresh_cancel ();
+
+		hildon_banner_show_information (main_window, NULL,
+						error->message);
+		return;
+	}
+
+	/* Empty containers give one result without an item */
+	if (objectid != NULL)
+	{
+		get_item_strings (objectid, metadata, &title, &mime);
+		source_model_append (refresh.shadow, title, objectid, mime,
+				     NULL);
+	}
+
+	if (remaining_count == 0)
+	{
+		refresh.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+		refresh_done ();
+	}
+}
+
+/*****************************************************************************
+ * Flattened browsing
+ *
+ * Shows all the items under a container as one list. The container is
+ * browsed recursively, or, if the source fails to do that, walked one
+ * container at a time. Results go to the model as pending rows that are
+ * flushed in budgeted batches like in the cached mode, so that the view
+ * stays responsive however fast the items come in. The walk pauses while
+ * too many rows are waiting to be flushed. The flattened container is on
+ * the container stack like any other, so going up cancels it.
+ *****************************************************************************/
+
+/** The walk pauses while more rows than this are waiting to be flushed */
+#define FLATTEN_MAX_PENDING 2000
+
+/** How often to check whether a paused walk can go on, in milliseconds */
+#define FLATTEN_RESUME_INTERVAL 50
+
+/** Update the progress banner after this many items */
+#define FLATTEN_PROGRESS_STEP 100
+
+typedef struct _Flatten
+{
+	/** Source of the flattened container, or %NULL when not flattening */
+	MafwSource *source;
+
+	/** Browsing recursively rather than walking the tree */
+	gboolean recursive;
+
+	/** Walk: object IDs of the containers left to browse */
+	GQueue *containers;
+
+	/** Walk: object IDs of the containers queued so far, so that a
+	    container listed in several places is browsed only once */
+	GHashTable *visited;
+
+	/** Request in progress */
+	guint browseid;
+
+	/** Timeout source that resumes a paused walk */
+	guint resume_id;
+
+	/** Number of items and containers found so far */
+	guint items;
+	guint folders;
+
+	/** Progress banner */
+	GtkWidget *banner;
+
+} Flatten;
+
+static Flatten flatten = { NULL, FALSE, NULL, NULL,
+			   MAFW_SOURCE_INVALID_BROWSE_ID, 0, 0, 0, NULL };
+
+static void flatten_walk_next (void);
+
+/**
+ * Stop flattening, if in progress. The request itself is cancelled through
+ * the container stack.
+ */
+static void
+flatten_cancel (void)
+{
+	if (flatten.source == NULL)
+		return;
+
+	if (flatten.resume_id != 0)
+		g_source_remove (flatten.resume_id);
+	if (flatten.banner != NULL)
+		gtk_widget_destroy (flatten.banner);
+	if (flatten.containers != NULL)
+	{
+		g_queue_foreach (flatten.containers, (GFunc) g_free, NULL);
+		g_queue_free (flatten.containers);
+	}
+	if (flatten.visited != NULL)
+		g_hash_table_destroy (flatten.visited);
+	g_object_unref (flatten.source);
+
+	memset (&flatten, 0, sizeof (flatten));
+	flatten.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+}
+
+static void
+flatten_show_progress (void)
+{
+	gchar *text;
+
+	text = g_strdup_printf ("%u items in %u folders", flatten.items,
+				flatten.folders);
+	if (flatten.banner == NULL)
+		flatten.banner = hildon_banner_show_animation (main_window,
+							       NULL, text);
+	else
+		hildon_banner_set_text (HILDON_BANNER (flatten.banner), text);
+	g_free (text);
+}
+
+static void
+flatten_done (void)
+{
+	gchar *text;
+
+	flush_pending_now ();
+	browse_metrics_end ();
+	container_stack_poke_browseid (MAFW_SOURCE_INVALID_BROWSE_ID);
+
+	text = g_strdup_printf ("%u items in %u folders", flatten.items,
+				flatten.folders);
+	flatten_cancel ();
+	hildon_banner_show_information (main_window, NULL, text);
+	g_free (text);
+}
+
+/**
+ * Queue @objectid to be browsed by the walk, unless it has been already
+ */
+static void
+flatten_walk_push (const gchar *objectid)
+{
+	if (g_hash_table_lookup (flatten.visited, objectid) != NULL)
+		return;
+
+	g_hash_table_insert (flatten.visited, g_strdup (objectid),
+			     GINT_TO_POINTER (TRUE));
+	g_queue_push_tail (flatten.containers, g_strdup (objectid));
+}
+
+static gboolean
+flatten_resume_timeout (gpointer data)
+{
+	if (source_model_get_n_pending (SOURCE_MODEL (model)) >
+	    FLATTEN_MAX_PENDING)
+		return TRUE;
+
+	flatten.resume_id = 0;
+	flatten_walk_next ();
+	return FALSE;
+}
+
+/**
+ * Browse the next container of the walk, or finish if there are none left
+ */
+static void
+flatten_walk_next (void)
+{
+	const gchar *const *metadata_keys;
+	gchar *objectid;
+	gchar *filter;
+	guint browseid;
+
+	flatten.browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+
+	/* Let the view catch up first */
+	if (source_model_get_n_pending (SOURCE_MODEL (model)) >
+	    FLATTEN_MAX_PENDING)
+	{
+		flatten.resume_id = g_timeout_add (FLATTEN_RESUME_INTERVAL,
+						   flatten_resume_timeout,
+						   NULL);
+		return;
+	}
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	filter = search_walk_filter ();
+	while ((objectid = g_queue_pop_head (flatten.containers)) != NULL)
+	{
+		browseid = browse_scheduler_submit (flatten.source, objectid,
+						    FALSE, filter, search_sort,
+						    metadata_keys, 0, 0,
+						    BrowsePriorityNavigation,
+						    browse_cb, &flatten);
+		g_free (objectid);
+
+		/* Skip the containers that can't be browsed */
+		if (browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		{
+			flatten.browseid = browseid;
+			container_stack_poke_browseid (browseid);
+			g_free (filter);
+			return;
+		}
+	}
+	g_free (filter);
+
+	flatten_done ();
+}
+
+/**
+ * Start listing all the items under @objectid, which has just been pushed
+ * to the container stack
+ */
+static void
+flatten_start (MafwSource *source, const gchar *objectid)
+{
+	const gchar *const *metadata_keys;
+	guint browseid;
+
+	flatten_cancel ();
+
+	flatten.source = g_object_ref (source);
+	flatten.containers = g_queue_new ();
+	flatten.visited = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, NULL);
+	flatten.recursive = TRUE;
+
+	source_model_clear (SOURCE_MODEL (model));
+	browse_metrics_start (objectid, model_behaviour);
+	flatten_show_progress ();
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	browseid = browse_scheduler_submit (source, objectid, TRUE,
+					    search_filter, search_sort,
+					    metadata_keys, 0, 0,
+					    BrowsePriorityNavigation,
+					    browse_cb, &flatten);
+	if (browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+	{
+		flatten.browseid = browseid;
+		container_stack_poke_browseid (browseid);
+	}
+	else
+	{
+		/* Walk the tree instead */
+		flatten.recursive = FALSE;
+		flatten_walk_push (objectid);
+		flatten_walk_next ();
+	}
+}
+
+/**
+ * Handle a browse result with the flattening as user data. Results of
+ * cancelled requests are ignored, and so are the failures the scheduler
+ * reports for requests it could not submit: the submitter sees those from
+ * the invalid ID it gets back, and walking on from here would re-enter
+ * the walk.
+ */
+static void
+flatten_browse_result (MafwSource *source, guint browseid,
+		       gint remaining_count, const gchar *objectid,
+		       GHashTable *metadata, const GError *error)
+{
+	ContainerStackItem *item;
+	const gchar *title;
+	const gchar *mime;
+
+	if (browseid == MAFW_SOURCE_INVALID_BROWSE_ID ||
+	    flatten.source != source || flatten.browseid != browseid)
+		return;
+
+	if (error != NULL)
+	{
+		if (flatten.recursive == TRUE && flatten.items == 0 &&
+		    flatten.folders == 0)
+		{
+			/* The source doesn't browse recursively. Walk the
+			   tree instead. */
+			item = container_stack_peek_item ();
+			flatten.recursive = FALSE;
+			flatten_walk_push (item->objectid);
+			flatten_walk_next ();
+			return;
+		}
+
+		hildon_banner_show_information (main_window, NULL,
+						error->message);
+		if (flatten.recursive == TRUE)
+			flatten_done ();
+		else
+			flatten_walk_next ();
+		return;
+	}
+
+	/* Empty containers give one result without an item */
+	if (objectid != NULL)
+	{
+		get_item_strings (objectid, metadata, &title, &mime);
+		if (strcmp (mime, MAFW_METADATA_VALUE_MIME_CONTAINER) == 0)
+		{
+			flatten.folders++;
+			if (flatten.recursive == FALSE)
+				flatten_walk_push (objectid);
+		}
+		else
+		{
+			browse_metrics_result ();
+			source_model_append_pending (SOURCE_MODEL (model),
+						     title, objectid, mime);
+			flush_pending ();
+
+			if (++flatten.items % FLATTEN_PROGRESS_STEP == 0)
+				flatten_show_progress ();
+		}
+	}
+
+	if (remaining_count == 0)
+	{
+		if (flatten.recursive == TRUE)
+		{
+			flatten_done ();
+		}
+		else
+		{
+			flatten_show_progress ();
+			flatten_walk_next ();
+		}
+	}
+}
+
+/**
+ * Show all the items under the selected container as one list
+ */
+void
+source_treeview_flatten_selected(void)
+{
+	MafwSource *source;
+	gchar *object_id;
+
+	if (selected_is_container () == FALSE)
+	{
+		hildon_banner_show_information (NULL, "qgn_list_smiley_angry",
+						"Select a folder first");
+		return;
+	}
+
+	source = get_selected_source ();
+	if (source == NULL)
+		return;
+
+	object_id = get_selected_object_id ();
+	if (object_id == NULL)
+		return;
+
+	/* Leave the current container just like when entering one */
+	container_stack_save_state ();
+	refresh_cancel ();
+	flatten_cancel ();
+	aggregate_cancel ();
+	local_filter_reset ();
+	browse_scheduler_new_generation ();
+	if (container_stack_peek_item () != NULL)
+		paged_reset (container_stack_peek_item (), TRUE);
+
+	container_stack_push (object_id);
+	container_stack_peek_item ()->flatten = TRUE;
+
+	flatten_start (source, object_id);
+
+	g_free (object_id);
+}
+
+/*****************************************************************************
+ * Browsing all sources
+ *
+ * Shows the contents of the same path, like the root, in every source as
+ * one list. All the sources are browsed at the same time, and each one has
+ * its own request queue in the browse scheduler, so slow sources don't hold
+ * back the fast ones. Results are tagged with the name of their source and
+ * go to the model as pending rows like in the cached mode, as soon as they
+ * come in. The aggregated container is on the container stack like any
+ * other, with the path as its object ID.
+ *****************************************************************************/
+
+typedef struct _AggregatePart
+{
+	MafwSource *source;
+
+	/** Request in progress, or invalid when the source is done */
+	guint browseid;
+
+	/** Number of items received so far */
+	guint items;
+
+	/** Milliseconds until the first result and until the last one */
+	gdouble first;
+	gdouble total;
+
+	/** The browse ended in an error */
+	gboolean failed;
+
+} AggregatePart;
+
+typedef struct _Aggregate
+{
+	/** Path browsed in every source, or %NULL when not aggregating */
+	gchar *path;
+
+	/** AggregatePart for each source */
+	GPtrArray *parts;
+
+	/** Number of sources still being browsed */
+	guint running;
+
+	GTimer *timer;
+
+	/** Progress banner */
+	GtkWidget *banner;
+
+} Aggregate;
+
+static Aggregate aggregate = { NULL, NULL, 0, NULL, NULL };
+
+/**
+ * Stop browsing the sources, if in progress, and drop the state
+ */
+static void
+aggregate_cancel (void)
+{
+	AggregatePart *part;
+	guint i;
+
+	if (aggregate.path == NULL)
+		return;
+
+	for (i = 0; i < aggregate.parts->len; i++)
+	{
+		part = g_ptr_array_index (aggregate.parts, i);
+		if (part->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+			browse_scheduler_cancel (part->browseid, NULL);
+		g_object_unref (part->source);
+		g_free (part);
+	}
+	g_ptr_array_free (aggregate.parts, TRUE);
+
+	if (aggregate.banner != NULL)
+		gtk_widget_destroy (aggregate.banner);
+	g_timer_destroy (aggregate.timer);
+	g_free (aggregate.path);
+
+	memset (&aggregate, 0, sizeof (aggregate));
+}
+
+static void
+aggregate_show_progress (void)
+{
+	gchar *text;
+
+	text = g_strdup_printf ("%u of %u sources done",
+				aggregate.parts->len - aggregate.running,
+				aggregate.parts->len);
+	if (aggregate.banner == NULL)
+		aggregate.banner = hildon_banner_show_animation (main_window,
+								 NULL, text);
+	else
+		hildon_banner_set_text (HILDON_BANNER (aggregate.banner),
+					text);
+	g_free (text);
+}
+
+/**
+ * Show how long each source took, once all of them are done
+ */
+static void
+aggregate_report (void)
+{
+	AggregatePart *part;
+	GString *text;
+	guint i;
+
+	text = g_string_new (NULL);
+	for (i = 0; i < aggregate.parts->len; i++)
+	{
+		part = g_ptr_array_index (aggregate.parts, i);
+		if (i > 0)
+			g_string_append_c (text, '\n');
+		g_string_append_printf (text, "%s: ", mafw_extension_get_name (
+						MAFW_EXTENSION (part->source)));
+		if (part->failed == TRUE)
+			g_string_append (text, "failed");
+		else
+			g_string_append_printf (text, "%u items, first in %.0f "
+						"ms, all in %.0f ms",
+						part->items, part->first,
+						part->total);
+	}
+
+	g_print ("All sources browsed:\n%s\n", text->str);
+	hildon_banner_show_information (main_window, NULL, text->str);
+	g_string_free (text, TRUE);
+}
+
+/**
+ * Keep a request of a running source as the browse ID of the container, so
+ * that the container is complete when there are none
+ */
+static void
+aggregate_poke_browseid (void)
+{
+	AggregatePart *part;
+	guint i;
+
+	for (i = 0; i < aggregate.parts->len; i++)
+	{
+		part = g_ptr_array_index (aggregate.parts, i);
+		if (part->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		{
+			container_stack_poke_browseid (part->browseid);
+			return;
+		}
+	}
+
+	container_stack_poke_browseid (MAFW_SOURCE_INVALID_BROWSE_ID);
+}
+
+/**
+ * @part has delivered its last result
+ */
+static void
+aggregate_part_done (AggregatePart *part)
+{
+	part->browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+	part->total = g_timer_elapsed (aggregate.timer, NULL) * 1000.0;
+	aggregate.running--;
+
+	aggregate_poke_browseid ();
+	if (aggregate.running > 0)
+	{
+		aggregate_show_progress ();
+		return;
+	}
+
+	flush_pending_now ();
+	browse_metrics_end ();
+
+	if (aggregate.banner != NULL)
+	{
+		gtk_widget_destroy (aggregate.banner);
+		aggregate.banner = NULL;
+	}
+	aggregate_report ();
+}
+
+/**
+ * Start browsing the path of the aggregated container in @source
+ */
+static void
+aggregate_add_source (MafwSource *source)
+{
+	const gchar *const *metadata_keys;
+	AggregatePart *part;
+	const gchar *uuid;
+	gchar *objectid;
+
+	/* Not the metadata resolver, which is not listed either */
+	uuid = mafw_extension_get_uuid (MAFW_EXTENSION (source));
+	if (uuid == NULL || strcmp (uuid, "gnomevfs") == 0)
+		return;
+
+	metadata_keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+					   MAFW_METADATA_KEY_URI,
+					   MAFW_METADATA_KEY_MIME);
+
+	part = g_new0 (AggregatePart, 1);
+	part->source = g_object_ref (source);
+	g_ptr_array_add (aggregate.parts, part);
+
+	objectid = g_strconcat (uuid, "::", aggregate.path, NULL);
+	part->browseid = browse_scheduler_submit (source, objectid, FALSE,
+						  search_filter, search_sort,
+						  metadata_keys, 0, 0,
+						  BrowsePriorityNavigation,
+						  browse_cb, &aggregate);
+	g_free (objectid);
+
+	if (part->browseid == MAFW_SOURCE_INVALID_BROWSE_ID)
+		part->failed = TRUE;
+	else
+		aggregate.running++;
+}
+
+/**
+ * Start browsing @path in all the sources. The aggregated container has just
+ * been pushed to the container stack.
+ */
+static void
+aggregate_start (const gchar *path)
+{
+	MafwRegistry *registry;
+	GList *node;
+
+	aggregate_cancel ();
+
+	aggregate.path = g_strdup (path);
+	aggregate.parts = g_ptr_array_new ();
+	aggregate.timer = g_timer_new ();
+
+	source_model_clear (SOURCE_MODEL (model));
+	browse_metrics_start (path, model_behaviour);
+
+	registry = mafw_registry_get_instance ();
+	g_assert (registry != NULL);
+
+	for (node = mafw_registry_get_sources (registry); node != NULL;
+	     node = node->next)
+		aggregate_add_source (MAFW_SOURCE (node->data));
+
+	if (aggregate.running == 0)
+	{
+		browse_metrics_cancel ();
+		aggregate_cancel ();
+		hildon_banner_show_information (NULL, "qgn_list_smiley_angry",
+						"No sources available");
+		return;
+	}
+
+	aggregate_poke_browseid ();
+	aggregate_show_progress ();
+}
+
+/**
+ * Handle a browse result with the aggregation as user data. Results of
+ * cancelled requests are ignored.
+ */
+static void
+aggregate_browse_result (MafwSource *source, guint browseid,
+			 gint remaining_count, const gchar *objectid,
+			 GHashTable *metadata, const GError *error)
+{
+	AggregatePart *part = NULL;
+	const gchar *title;
+	const gchar *mime;
+	gchar *tagged;
+	guint i;
+
+	if (aggregate.path == NULL)
+		return;
+
+	for (i = 0; i < aggregate.parts->len && part == NULL; i++)
+	{
+		part = g_ptr_array_index (aggregate.parts, i);
+		if (part->source != source || part->browseid != browseid)
+			part = NULL;
+	}
+	if (part == NULL)
+		return;
+
+	if (error != NULL)
+	{
+		/* The other sources go on, the report tells about this one */
+		g_print ("Browsing %s failed: %s\n",
+			 mafw_extension_get_name (MAFW_EXTENSION (source)),
+			 error->message);
+		part->failed = TRUE;
+		aggregate_part_done (part);
+		return;
+	}
+
+	/* Empty containers give one result without an item */
+	if (objectid != NULL)
+	{
+		if (part->items++ == 0)
+			part->first = g_timer_elapsed (aggregate.timer, NULL) *
+				1000.0;
+		browse_metrics_result ();
+
+		get_item_strings (objectid, metadata, &title, &mime);
+		tagged = tag_title (objectid, title);
+		source_model_append_pending (SOURCE_MODEL (model), tagged,
+					     objectid, mime);
+		flush_pending ();
+		g_free (tagged);
+	}
+
+	if (remaining_count == 0)
+		aggregate_part_done (part);
+}
+
+/**
+ * A new source has appeared while all sources are being shown. Browse it
+ * too.
+ */
+static void
+aggregate_source_added (MafwSource *source)
+{
+	ContainerStackItem *item;
+
+	item = container_stack_peek_item ();
+	if (aggregate.path == NULL || item == NULL || item->aggregate == FALSE)
+		return;
+
+	aggregate_add_source (source);
+	aggregate_poke_browseid ();
+	aggregate_show_progress ();
+}
+
+/**
+ * @source is going away. Stop waiting for it.
+ */
+static void
+aggregate_source_removed (MafwSource *source)
+{
+	AggregatePart *part;
+	guint i;
+
+	if (aggregate.path == NULL)
+		return;
+
+	for (i = 0; i < aggregate.parts->len; i++)
+	{
+		part = g_ptr_array_index (aggregate.parts, i);
+		if (part->source == source &&
+		    part->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		{
+			browse_scheduler_cancel (part->browseid, NULL);
+			part->failed = TRUE;
+			aggregate_part_done (part);
+			return;
+		}
+	}
+}
+
+/**
+ * Show the contents of @path in all the sources as one list, starting from
+ * the top level
+ */
+void
+source_treeview_browse_all(const gchar *path)
+{
+	guint browseid;
+
+	g_return_if_fail (path != NULL);
+
+	/* Leave wherever we are, like going up to the top level */
+	local_filter_reset ();
+	cache_current_container ();
+	if (container_stack_peek_browseid (&browseid) == TRUE &&
+	    browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		cancel_browse (browseid);
+	while (container_stack_pop (NULL, NULL) == TRUE)
+	{
+		/* Just pop the container stack until it is empty. */
+	}
+	refresh_cancel ();
+	flatten_cancel ();
+	snapshot_forget ();
+	browse_scheduler_new_generation ();
+
+	container_stack_push (path);
+	container_stack_peek_item ()->aggregate = TRUE;
+
+	aggregate_start (path);
+}
+
+/*****************************************************************************
+ * Search and sort
+ *
+ * The search entry and the sort combo above the view narrow and order the
+ * browse results at the source. The filter and sort criteria apply to all
+ * browse requests of the view until they are changed. Changing them cancels
+ * the running browse, forgets the cached and prefetched contents, which
+ * were fetched with the old criteria, and browses the current container
+ * again. Typing is debounced.
+ *
+ * For sources that ignore filters, the search text can filter the rows that
+ * have been loaded instead. The model keeps all the rows and indexes their
+ * titles, but hides the ones that don't match, emitting signals only for
+ * the rows whose visibility changes. Pending rows are filtered as they are
+ * flushed. Leaving the container clears the search text.
+ *****************************************************************************/
+
+/** Time to wait for more typing before searching, in milliseconds */
+#define SEARCH_DELAY 300
+
+typedef struct _SortOption
+{
+	const gchar *label;
+	const gchar *criteria;
+
+} SortOption;
+
+static const SortOption sort_options[] = {
+	{ "Unsorted", "" },
+	{ "Title", "+" MAFW_METADATA_KEY_TITLE },
+	{ "Title, descending", "-" MAFW_METADATA_KEY_TITLE },
+	{ "Artist", "+" MAFW_METADATA_KEY_ARTIST ",+" MAFW_METADATA_KEY_ALBUM
+	  ",+" MAFW_METADATA_KEY_TRACK },
+	{ "Album", "+" MAFW_METADATA_KEY_ALBUM ",+" MAFW_METADATA_KEY_TRACK }
+};
+
+static GtkWidget *search_entry = NULL;
+static GtkWidget *sort_combo = NULL;
+
+/** Filter the loaded rows instead of asking the source to */
+static gboolean local_filter = FALSE;
+
+/** Timeout source that applies the search text, 0 if none */
+static guint search_timeout_id = 0;
+
+/**
+ * Filter for walking a tree: the containers, to find the items in them, and
+ * the items that match the search
+ */
+static gchar *
+search_walk_filter (void)
+{
+	if (search_filter == NULL)
+		return NULL;
+
+	return g_strdup_printf ("(|(%s=%s)%s)", MAFW_METADATA_KEY_MIME,
+				MAFW_METADATA_VALUE_MIME_CONTAINER,
+				search_filter);
+}
+
+/**
+ * Turn the search text into a filter. Text in parentheses is taken as a
+ * filter as it is, anything else matches the titles that contain it.
+ *
+ * Returns the filter, or %NULL if there is no text. Sets @valid to %FALSE if
+ * the text is not a valid filter.
+ */
+static gchar *
+search_text_to_filter (const gchar *text, gboolean *valid)
+{
+	MafwFilter *filter;
+	gchar *quoted;
+	gchar *result;
+
+	*valid = TRUE;
+	if (text == NULL || text[0] == '\0')
+		return NULL;
+
+	if (text[0] == '(')
+	{
+		filter = mafw_filter_parse (text);
+		if (filter == NULL)
+		{
+			*valid = FALSE;
+			return NULL;
+		}
+		mafw_filter_free (filter);
+		return g_strdup (text);
+	}
+
+	quoted = mafw_filter_quote (text);
+	result = g_strdup_printf ("(%s~%s)", MAFW_METADATA_KEY_TITLE, quoted);
+	g_free (quoted);
+
+	return result;
+}
+
+/**
+ * Show all the rows of the container again
+ */
+static void
+local_filter_clear (void)
+{
+	if (local_filtered == FALSE)
+		return;
+
+	source_model_filter_titles (SOURCE_MODEL (model), NULL);
+	source_model_set_title_index (SOURCE_MODEL (model), FALSE);
+	local_filtered = FALSE;
+}
+
+/**
+ * Stop filtering locally when leaving the container. The search text was
+ * meant for the container, so it goes too.
+ */
+static void
+local_filter_reset (void)
+{
+	if (local_filter == FALSE)
+		return;
+
+	local_filter_clear ();
+	if (search_entry != NULL)
+		gtk_entry_set_text (GTK_ENTRY (search_entry), "");
+}
+
+/**
+ * Show only the loaded rows whose title contains @text
+ */
+static void
+local_filter_apply (const gchar *text)
+{
+	if (text == NULL || text[0] == '\0')
+	{
+		local_filter_clear ();
+		return;
+	}
+
+	/* The source list is not filtered */
+	if (container_stack_peek_item () == NULL)
+		return;
+
+	/* The model only tells the view about the rows that appear or
+	   disappear, and filters the pending rows as they are flushed */
+	source_model_set_title_index (SOURCE_MODEL (model), TRUE);
+	source_model_filter_titles (SOURCE_MODEL (model), text);
+	local_filtered = TRUE;
+}
+
+/**
+ * Browse the current container again with the current criteria
+ */
+static void
+search_rebrowse (void)
+{
+	ContainerStackItem *item;
+	MafwSource *source;
+	gchar *objectid;
+
+	/* Whatever was fetched with the old criteria is of no use now */
+	local_filter_clear ();
+	browse_cache_clear ();
+	container_stack_invalidate (NULL);
+	prefetch_cancel ();
+	refresh_cancel ();
+
+	item = container_stack_peek_item ();
+	if (item == NULL)
+	{
+		/* The source list is not browsed */
+		return;
+	}
+
+	if (item->aggregate == TRUE)
+	{
+		browse_scheduler_new_generation ();
+		aggregate_start (item->objectid);
+		return;
+	}
+
+	source = get_selected_source ();
+	if (source == NULL)
+		return;
+
+	paged_reset (item, FALSE);
+	if (item->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		cancel_browse (item->browseid);
+	container_stack_poke_browseid (MAFW_SOURCE_INVALID_BROWSE_ID);
+	browse_scheduler_new_generation ();
+
+	objectid = g_strdup (item->objectid);
+	if (item->flatten == TRUE)
+	{
+		flatten_start (source, objectid);
+	}
+	else
+	{
+		flush_pending_now ();
+		source_model_clear (SOURCE_MODEL (model));
+		browse (source, objectid, 0, 0);
+	}
+	g_free (objectid);
+}
+
+/**
+ * Take the search text and the sort order from the widgets, and browse
+ * again if they changed
+ */
+static void
+search_apply (void)
+{
+	const gchar *criteria;
+	const gchar *text;
+	gchar *filter = NULL;
+	gboolean valid = TRUE;
+	gboolean local;
+	gint active;
+
+	if (search_timeout_id != 0)
+	{
+		g_source_remove (search_timeout_id);
+		search_timeout_id = 0;
+	}
+
+	/* Paged contents are never all loaded */
+	local = local_filter == TRUE && model_behaviour != SourceModelPaged;
+
+	text = gtk_entry_get_text (GTK_ENTRY (search_entry));
+	if (local == FALSE)
+		filter = search_text_to_filter (text, &valid);
+	if (valid == FALSE)
+	{
+		hildon_banner_show_information (NULL, "qgn_list_smiley_angry",
+						"Invalid filter");
+		return;
+	}
+
+	active = gtk_combo_box_get_active (GTK_COMBO_BOX (sort_combo));
+	if (active < 0 || (guint) active >= G_N_ELEMENTS (sort_options))
+		active = 0;
+	criteria = sort_options[active].criteria;
+
+	if (g_strcmp0 (filter, search_filter) != 0 ||
+	    strcmp (criteria, search_sort) != 0)
+	{
+		g_free (search_filter);
+		search_filter = filter;
+		search_sort = criteria;
+
+		search_rebrowse ();
+	}
+	else
+	{
+		g_free (filter);
+	}
+
+	if (local == TRUE)
+		local_filter_apply (text);
+}
+
+/**
+ * Make the search text filter the loaded rows instead of being sent to the
+ * source. The search text is cleared.
+ */
+void
+source_treeview_set_local_filter(gboolean enabled)
+{
+	local_filter_clear ();
+	local_filter = enabled;
+
+	/* Applies the change */
+	gtk_entry_set_text (GTK_ENTRY (search_entry), "");
+	search_apply ();
+}
+
+static gboolean
+search_timeout (gpointer data)
+{
+	search_timeout_id = 0;
+	search_apply ();
+	return FALSE;
+}
+
+static void
+on_search_entry_changed (GtkEditable *editable, gpointer user_data)
+{
+	/* Wait until the user stops typing */
+	if (search_timeout_id != 0)
+		g_source_remove (search_timeout_id);
+	search_timeout_id = g_timeout_add (SEARCH_DELAY, search_timeout, NULL);
+}
+
+static void
+on_search_entry_activate (GtkEntry *entry, gpointer user_data)
+{
+	search_apply ();
+}
+
+static void
+on_sort_combo_changed (GtkComboBox *combo, gpointer user_data)
+{
+	search_apply ();
+}
+
+static void
+setup_search (GtkBuilder *builder)
+{
+	GtkCellRenderer *renderer;
+	GtkListStore *store;
+	guint i;
+
+	search_entry = GTK_WIDGET (gtk_builder_get_object (
+					   builder, "source-search-entry"));
+	g_assert (search_entry != NULL);
+
+	sort_combo = GTK_WIDGET (gtk_builder_get_object (
+					 builder, "source-sort-combobox"));
+	g_assert (sort_combo != NULL);
+
+	store = gtk_list_store_new (1, G_TYPE_STRING);
+	for (i = 0; i < G_N_ELEMENTS (sort_options); i++)
+		gtk_list_store_insert_with_values (store, NULL, i,
+						   0, sort_options[i].label,
+						   -1);
+	gtk_combo_box_set_model (GTK_COMBO_BOX (sort_combo),
+				 GTK_TREE_MODEL (store));
+	g_object_unref (store);
+
+	renderer = gtk_cell_renderer_text_new ();
+	gtk_cell_layout_pack_start (GTK_CELL_LAYOUT (sort_combo), renderer,
+				    TRUE);
+	gtk_cell_layout_add_attribute (GTK_CELL_LAYOUT (sort_combo), renderer,
+				       "text", 0);
+	gtk_combo_box_set_active (GTK_COMBO_BOX (sort_combo), 0);
+
+	g_signal_connect (search_entry, "changed",
+			  G_CALLBACK (on_search_entry_changed), NULL);
+	g_signal_connect (search_entry, "activate",
+			  G_CALLBACK (on_search_entry_activate), NULL);
+	g_signal_connect (sort_combo, "changed",
+			  G_CALLBACK (on_sort_combo_changed), NULL);
+}
+
+/*****************************************************************************
+ * Browse
+ *****************************************************************************/
+
+#ifndef G_DEBUG_DISABLE
+static void
+print_metadata (gpointer key, gpointer value, gpointer user_data)
+{
+	gchar* contents;
+
+        if (G_IS_VALUE (value))
+                contents = g_strdup_value_contents ((GValue*) value);
+        else {
+                GValue *real_value;
+
+                real_value = g_value_array_get_nth (value, 0);
+                contents = g_strdup_value_contents (real_value);
+        }
+
+	g_debug ("\t%s = %s\n", (gchar*) key, contents);
+
+	g_free (contents);
+}
+#endif
+
+/**
+ * Browse result callback
+ */
+static void
+browse_cb (MafwSource *source, guint browseid, gint remaining_count,
+	   guint index, const gchar *objectid, GHashTable *metadata,
+	   gpointer user_data, const GError *error)
 {
+	ContainerStackItem *item;
+	PageRequest *request;
+	guint current_browseid = MAFW_SOURCE_INVALID_BROWSE_ID;
+
 	#ifndef G_DEBUG_DISABLE
 	mtg_print_signal (MAFW_EXTENSION(source), "browse-result",
 			  "BrowseID: %u, Remaining count: %d, Index: %u "
@@ -587,6 +3042,59 @@ browse_cb (MafwSource *source, guint browseid, gint remaining_count,
 			  objectid);
 	#endif
 
+	/* Flattened results go to the model as they are */
+	if (user_data == &flatten)
+	{
+		flatten_browse_result (source, browseid, remaining_count,
+				       objectid, metadata, error);
+		return;
+	}
+
+	/* Results from all sources go to the model as they are */
+	if (user_data == &aggregate)
+	{
+		aggregate_browse_result (source, browseid, remaining_count,
+					 objectid, metadata, error);
+		return;
+	}
+
+	/* Refresh results go to the shadow model */
+	if (user_data == &refresh)
+	{
+		refresh_browse_result (source, browseid, remaining_count,
+				       objectid, metadata, error);
+		return;
+	}
+
+	/* Prefetch results go to the side buffer until they are adopted */
+	if (user_data == &prefetch &&
+	    prefetch_browse_result (source, browseid, remaining_count,
+				    objectid, metadata, error) == TRUE)
+		return;
+
+	/* Results of paged browsing are placed by their page */
+	item = container_stack_peek_item ();
+	if (item != NULL && item->page_requests != NULL)
+	{
+		request = g_hash_table_lookup (item->page_requests,
+					       GUINT_TO_POINTER (browseid));
+		if (request != NULL)
+		{
+			paged_browse_result (item, request, browseid,
+					     remaining_count, objectid,
+					     metadata, error);
+			return;
+		}
+	}
+
+	/* Anything else belongs to the current browse. Results of cancelled
+	   requests, such as of pages scrolled away from, may still arrive
+	   and must not end it. Submit failures come with an invalid ID. */
+	if (browseid != MAFW_SOURCE_INVALID_BROWSE_ID &&
+	    (container_stack_peek_browseid (&current_browseid) == FALSE ||
+	     current_browseid != browseid))
+		return;
+
 	if (error != NULL)
 	{
 		/* The model should be detached here, but in case we end up in
@@ -606,25 +3114,38 @@ browse_cb (MafwSource *source, guint browseid, gint remaining_count,
 				NULL,
 				error->message);
 
-		perf_end();
+		/* There is nothing left to cancel. Errors of stale browses
+		   must not end the measurement of the current one. */
+		if (container_stack_peek_browseid (&current_browseid) == TRUE &&
+		    current_browseid == browseid)
+		{
+			container_stack_poke_browseid (
+				MAFW_SOURCE_INVALID_BROWSE_ID);
+			browse_metrics_cancel ();
+		}
 	}
 	else
 	{
 		/* Normal browse results. */
-		guint current_browseid = 0;
+		gboolean current = FALSE;
 
                 #ifndef G_DEBUG_DISABLE
 		if (metadata != NULL)
 			g_hash_table_foreach (metadata, print_metadata, NULL);
                 #endif
 
-		perf_num++;
-
 		/* Append results only if they belong to the current action */
 		if (container_stack_peek_browseid (&current_browseid) == TRUE)
+			current = (current_browseid == browseid);
+
+		if (current == TRUE)
 		{
-			if (current_browseid == browseid)
-				append_model_item (objectid, metadata);
+			/* Empty containers give one result without an item */
+			if (objectid != NULL)
+				browse_metrics_result ();
+			append_model_item (objectid, metadata);
+			if (model_behaviour == SourceModelCached)
+				flush_pending ();
 		}
 
 		if (remaining_count == 0)
@@ -641,26 +3162,106 @@ browse_cb (MafwSource *source, guint browseid, gint remaining_count,
 					GTK_TREE_VIEW (treeview), model);
 				g_object_unref (model);
 			}
-			else if (model_behaviour == SourceModelCached)
+
+			/* Termination signal */
+			if (current == TRUE)
+				browse_metrics_end ();
+
+			/* Invalidate the current browse ID */
+			container_stack_poke_browseid(
+				MAFW_SOURCE_INVALID_BROWSE_ID);
+
+			/* Coming back up, return to the rows that were
+			   shown. They must not be pending any more. */
+			if (current == TRUE)
 			{
-				g_idle_add_full (G_PRIORITY_HIGH_IDLE + 10,
-						 purge_cache_idle, NULL, NULL);
+				if (model_behaviour == SourceModelCached)
+					flush_pending_now ();
+				container_stack_restore_state ();
 			}
+		}
+	}
+}
+
+/**
+ * Check whether the model has all of the contents of @item, the topmost
+ * container.
+ */
+static gboolean
+is_complete (ContainerStackItem *item)
+{
+	/* Browse still in progress */
+	if (item->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		return FALSE;
+
+	/* Paged contents are incomplete by nature */
+	if (item->pages != NULL)
+		return FALSE;
+
+	/* Not the container's own contents */
+	if (item->flatten == TRUE)
+		return FALSE;
+
+	/* Cached mode results still waiting to be flushed */
+	if (source_model_get_n_pending (SOURCE_MODEL (model)) > 0)
+		return FALSE;
+
+	return TRUE;
+}
+
+/**
+ * Store the contents of the topmost container to the browse cache, if they
+ * have been browsed completely.
+ */
+static void
+cache_current_container (void)
+{
+	ContainerStackItem *item;
+
+	item = container_stack_peek_item ();
+	if (item == NULL || is_complete (item) == FALSE)
+		return;
+
+	/* Not a container of any source */
+	if (item->aggregate == TRUE)
+		return;
+
+	browse_cache_store (item->objectid, SOURCE_MODEL (model));
+}
+
+/**
+ * Fill the model from the browse cache instead of browsing the container.
+ *
+ * Returns %TRUE if the container was found from the cache.
+ */
+static gboolean
+restore_cached_container (const gchar *object_id)
+{
+	gboolean found;
 
-			/* Termination signal */
-			perf_end();
+	if (browse_cache_contains (object_id) == FALSE)
+	{
+		/* Count the miss without touching the view */
+		browse_cache_restore (object_id, SOURCE_MODEL (model));
+		return FALSE;
+	}
 
-			/* Invalidate the current browse ID */
-			container_stack_poke_browseid(
-				MAFW_SOURCE_INVALID_BROWSE_ID);
-		}
-		else if ((perf_num % 20) == 0 &&
-			 model_behaviour == SourceModelCached)
-		{
-			g_idle_add_full (G_PRIORITY_HIGH_IDLE + 10,
-					 purge_cache_idle, NULL, NULL);
-		}
+	/* Don't make the view follow every inserted row */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), NULL);
+
+	found = browse_cache_restore (object_id, SOURCE_MODEL (model));
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), model);
+	g_object_unref (model);
+
+	if (found == TRUE)
+	{
+		/* Nothing is being browsed for this container */
+		container_stack_poke_browseid (MAFW_SOURCE_INVALID_BROWSE_ID);
 	}
+
+	return found;
 }
 
 /**
@@ -676,24 +3277,43 @@ browse (MafwSource* source, const gchar *object_id, guint skip, guint count)
 					   MAFW_METADATA_KEY_URI,
 					   MAFW_METADATA_KEY_MIME);
 
+	/* Show the container immediately if its contents are known */
+	if (model_behaviour != SourceModelPaged && skip == 0 && count == 0 &&
+	    restore_cached_container (object_id) == TRUE)
+		return;
+
+	browse_metrics_start (object_id, model_behaviour);
+
+	if (model_behaviour == SourceModelPaged)
+	{
+		if (paged_browse_start (source) == FALSE)
+		{
+			browse_metrics_cancel ();
+			container_stack_pop (NULL, NULL);
+		}
+		return;
+	}
+
 	if (model_behaviour == SourceModelDetached)
 	{
 		g_object_ref (model);
 		gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), NULL);
 	}
 
-	browse_id = mafw_source_browse(source, object_id,
-					FALSE, /* Recursive */
-					NULL,  /* Filter */
-					"",    /* Sorting */
-					metadata_keys,
-					skip,
-					count,
-					browse_cb,
-					NULL);
+	browse_id = browse_scheduler_submit (source, object_id,
+					     FALSE, /* Recursive */
+					     search_filter,
+					     search_sort,
+					     metadata_keys,
+					     skip,
+					     count,
+					     BrowsePriorityNavigation,
+					     browse_cb,
+					     NULL);
 
 	if (browse_id == MAFW_SOURCE_INVALID_BROWSE_ID)
 	{
+		browse_metrics_cancel ();
 		container_stack_pop(NULL, NULL);
 		if (model_behaviour == SourceModelDetached)
 		{
@@ -707,7 +3327,7 @@ browse (MafwSource* source, const gchar *object_id, guint skip, guint count)
 	{
 		/* Clear the contents of the model so that new browse results
 		   can be placed to it. */
-		gtk_list_store_clear (GTK_LIST_STORE (model));
+		source_model_clear (SOURCE_MODEL (model));
 
 
 		/* Put the new browse ID to the top of the container stack */
@@ -716,21 +3336,12 @@ browse (MafwSource* source, const gchar *object_id, guint skip, guint count)
 }
 
 /**
- * Cancel an ongoing browse action with given browse ID and object ID
+ * Cancel an ongoing browse action with the given browse ID
  */
 static void
-cancel_browse (const gchar* objectid, guint browseid)
+cancel_browse (guint browseid)
 {
-	MafwRegistry* registry;
-	MafwExtension* extension;
-	gchar* uuid;
-	mafw_source_split_objectid (objectid, &uuid, NULL);
-	if (uuid == NULL)
-		return;
-
-	/* Get a registry instance */
-	registry = mafw_registry_get_instance ();
-	g_assert (registry != NULL);
+	GError* error = NULL;
 
 	/* Re-attach the model only if it is currently detached */
 	if (model_behaviour == SourceModelDetached &&
@@ -740,34 +3351,13 @@ cancel_browse (const gchar* objectid, guint browseid)
 		g_object_unref (model);
 	}
 
-	/* Find a source matching the UUID */
-	extension = mafw_registry_get_extension_by_uuid (registry, uuid);
-	if (extension == NULL)
+	if (browse_scheduler_cancel (browseid, &error) == FALSE)
 	{
-		/* Unable to find a source. Go to top level. */
-		gchar* msg;
-		msg = g_strdup_printf("No source for UUID %s", uuid);
 		hildon_banner_show_information (NULL,
-						"qgn_list_smiley_angry",
-						msg);
-		g_free(msg);
-	}
-	else
-	{
-		GError* error = NULL;
-
-		if (mafw_source_cancel_browse (MAFW_SOURCE (extension),
-                                               browseid,
-                                               &error) == FALSE)
-		{
-			hildon_banner_show_information (NULL,
 						"qgn_list_smiley_angry",
 						error->message);
-			g_error_free (error);
-		}
+		g_error_free (error);
 	}
-
-	g_free (uuid);
 }
 
 /*****************************************************************************
@@ -783,6 +3373,14 @@ on_source_treeview_row_activated (GtkTreeView *treeview,
 				  GtkTreeViewColumn *column,
 				  gpointer user_data)
 {
+	gchar *selected;
+
+	/* Placeholders of pages still being loaded are nothing yet */
+	selected = get_selected_object_id ();
+	if (selected == NULL)
+		return;
+	g_free (selected);
+
 	if (selected_is_container () == FALSE)
 	{
 		/* An item was clicked. Add it to the playlist. */
@@ -804,17 +3402,32 @@ on_source_treeview_row_activated (GtkTreeView *treeview,
 		if (object_id == NULL)
 			return;
 
-		/* TODO: Cancel previous browse. */
+		/* Remember how the parent looks for coming back */
+		container_stack_save_state ();
+
+		/* The parent's changes don't matter anymore */
+		refresh_cancel ();
+		flatten_cancel ();
+		aggregate_cancel ();
+		local_filter_reset ();
+
+		/* Nor does the rest of its contents, if it is still being
+		   browsed */
+		browse_scheduler_new_generation ();
+
+		/* The parent's pages are about to be cleared from the model.
+		   Keep track of the ones that were loaded for coming back. */
+		if (container_stack_peek_item () != NULL)
+			paged_reset (container_stack_peek_item (), TRUE);
 
 		/* Push the to-be-browsed object ID to the top of the
 		   container stack so that we can go back again. */
 		container_stack_push(object_id);
 
-		/* Start performance measurement */
-		perf_start ();
-
-		/* Browse the selected container */
-		browse (source, object_id, 0, 0);
+		/* Browse the selected container, unless it has been
+		   prefetched */
+		if (adopt_prefetch (source, object_id) == FALSE)
+			browse (source, object_id, 0, 0);
 
 		g_free (object_id);
 	}
@@ -830,11 +3443,20 @@ on_source_up_button_clicked (GtkButton* button, gpointer user_data)
 	gchar* objectid = NULL;
 	guint browseid;
 
+	/* Remember the contents of the container we are leaving, all of
+	   them */
+	local_filter_reset ();
+	cache_current_container ();
+	refresh_cancel ();
+	flatten_cancel ();
+	aggregate_cancel ();
+
 	if (container_stack_pop (&objectid, &browseid) == TRUE)
 	{
 		/* Cancel the current browse operation */
 		if (browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
-			cancel_browse (objectid, browseid);
+			cancel_browse (browseid);
+		browse_scheduler_new_generation ();
 
 		g_free (objectid);
 		objectid = NULL;
@@ -844,6 +3466,13 @@ on_source_up_button_clicked (GtkButton* button, gpointer user_data)
 			/* We are back at the top level. Display all sources. */
 			display_sources ();
 		}
+		else if (container_stack_peek_item ()->aggregate == TRUE)
+		{
+			/* Back to the list of all sources */
+			if (container_stack_restore_contents () == FALSE)
+				aggregate_start (objectid);
+			container_stack_restore_state ();
+		}
 		else
 		{
 			MafwRegistry* registry;
@@ -875,16 +3504,17 @@ on_source_up_button_clicked (GtkButton* button, gpointer user_data)
 			}
 			else
 			{
-				/* Clear the contents of the model so that new
-				   browse results can be placed to it. */
-				gtk_list_store_clear (GTK_LIST_STORE (model));
-
-				/* Start performance measurement */
-				perf_start ();
-
-				/* Browse the container */
-				browse (MAFW_SOURCE (extension), objectid,
-                                        0, 0);
+				/* Show the container as it was left, or
+				   browse it again */
+				if (container_stack_restore_contents () ==
+				    FALSE)
+				{
+					source_model_clear (
+						SOURCE_MODEL (model));
+					browse (MAFW_SOURCE (extension),
+						objectid, 0, 0);
+				}
+				container_stack_restore_state ();
 			}
 
 			g_free (uuid);
@@ -913,6 +3543,16 @@ on_source_container_changed (MafwSource* source, const gchar* objectid)
 {
 	gchar* current_oid = NULL;
 
+	/* Whatever was cached for the container is out of date now */
+	if (objectid != NULL)
+	{
+		browse_cache_invalidate (objectid);
+		container_stack_invalidate (objectid);
+	}
+	if (objectid != NULL && prefetch.objectid != NULL &&
+	    strcmp (objectid, prefetch.objectid) == 0)
+		prefetch_cancel ();
+
 	if (container_stack_peek_objectid (&current_oid) == FALSE)
 	{
 		/* On top level, nothing to do. Containers can't change
@@ -922,14 +3562,45 @@ on_source_container_changed (MafwSource* source, const gchar* objectid)
 	else if (current_oid != NULL && objectid != NULL &&
 		 strcmp (current_oid, objectid) == 0)
 	{
-		/* The container that we are currently in has changed.
-		   Clear the container's contents and fetch them again.
-		   There is no need to create a new entry to container stack,
-		   because we are already in the container that we need to
-		   browse. */
-		gtk_list_store_clear (GTK_LIST_STORE (model));
-		perf_start ();
-		browse (source, objectid, 0, 0);
+		ContainerStackItem *item = container_stack_peek_item ();
+
+		/* Refreshing works on all the rows */
+		local_filter_reset ();
+
+		if (item->flatten == TRUE)
+		{
+			/* Only the container itself is known to have
+			   changed, so list everything again */
+			cancel_browse (item->browseid);
+			browse_scheduler_new_generation ();
+			flatten_start (source, objectid);
+		}
+		else if (model_behaviour == SourceModelPaged ||
+		    item->browseid != MAFW_SOURCE_INVALID_BROWSE_ID)
+		{
+			/* The container that we are currently in has
+			   changed, and there is nothing complete to compare
+			   the new contents with. Clear the container's
+			   contents and fetch them again. There is no need to
+			   create a new entry to container stack, because we
+			   are already in the container that we need to
+			   browse. */
+			refresh_cancel ();
+			source_model_clear (SOURCE_MODEL (model));
+			browse (source, objectid, 0, 0);
+		}
+		else if (refresh.objectid != NULL &&
+			 strcmp (refresh.objectid, objectid) == 0)
+		{
+			/* Browse again once the running refresh is done */
+			refresh.again = TRUE;
+		}
+		else
+		{
+			/* Fetch the new contents aside and apply only the
+			   differences */
+			refresh_start (source, objectid);
+		}
 	}
 	else
 	{
@@ -944,57 +3615,377 @@ on_source_container_changed (MafwSource* source, const gchar* objectid)
  * Metadata changed signal handling
  *****************************************************************************/
 
+/** Time to collect metadata-changed signals before fetching the new
+    metadata, in milliseconds */
+#define METADATA_CHANGED_DELAY 100
+
+/** MafwSource -> set of its changed object IDs that are in the model */
+static GHashTable *changed_objects = NULL;
+static guint changed_timeout_id = 0;
+
+/**
+ * Forget the collected changes of @source, or of all sources if %NULL, and
+ * stop waiting to fetch them when none are left
+ */
+static void
+changed_cancel (MafwSource *source)
+{
+	if (changed_objects != NULL && source != NULL)
+		g_hash_table_remove (changed_objects, source);
+
+	if (changed_objects != NULL &&
+	    (source == NULL || g_hash_table_size (changed_objects) == 0))
+	{
+		g_hash_table_destroy (changed_objects);
+		changed_objects = NULL;
+	}
+
+	if (changed_objects == NULL && changed_timeout_id != 0)
+	{
+		g_source_remove (changed_timeout_id);
+		changed_timeout_id = 0;
+	}
+}
+
 /**
- * Metadata result callback. Called after changed metadata is requested from
- * on_source_metadata_changed().
+ * Metadata results callback. Called after changed metadata is requested from
+ * fetch_changed_metadata().
  */
 static void
-metadata_cb (MafwSource* self, const gchar* objectid, GHashTable *metadata,
-	     gpointer user_data, const GError* error)
+metadatas_cb (MafwSource* self, GHashTable *metadatas, gpointer user_data,
+	      const GError* error)
 {
+	GHashTableIter hiter;
 	GtkTreeIter iter;
+	gpointer objectid;
+	gpointer metadata;
 
+	/* Apply what was received even if some objects failed */
 	if (error != NULL)
 	{
 		hildon_banner_show_information (NULL,
 						"qgn_list_smiley_angry",
 						error->message);
-		return;
 	}
 
-	/* Find the item that we fetched metadata for and update it */
-	if (find_objectid (objectid, &iter) == TRUE)
+	if (metadatas == NULL)
+		return;
+
+	g_hash_table_iter_init (&hiter, metadatas);
+	while (g_hash_table_iter_next (&hiter, &objectid, &metadata))
 	{
-		update_model_item (model, &iter, objectid, metadata);
+		/* Items that are not in the container anymore are too
+		   late. Those filtered out locally are updated too. */
+		if (source_model_find (SOURCE_MODEL (model), objectid,
+				       &iter) == TRUE)
+			update_model_item (model, &iter, objectid, metadata);
 	}
-	else
+}
+
+/**
+ * Fetch the metadata of all the objects that have changed since the last
+ * time, with one request per source.
+ */
+static gboolean
+fetch_changed_metadata (gpointer data)
+{
+	const gchar *const *keys;
+	GHashTable *changed;
+	GHashTableIter source_iter;
+	GHashTableIter object_iter;
+	GPtrArray *objectids;
+	gpointer source;
+	gpointer objects;
+	gpointer objectid;
+
+	keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
+				  MAFW_METADATA_KEY_URI,
+				  MAFW_METADATA_KEY_MIME);
+
+	/* Changes signalled from the callbacks start a new batch */
+	changed = changed_objects;
+	changed_objects = NULL;
+	changed_timeout_id = 0;
+
+	objectids = g_ptr_array_new ();
+
+	g_hash_table_iter_init (&source_iter, changed);
+	while (g_hash_table_iter_next (&source_iter, &source, &objects))
 	{
-		/* Too late, the item is not in the view now, no need 
-                   to update anything. */
+		/* The view may have moved on since the signals */
+		g_ptr_array_set_size (objectids, 0);
+		g_hash_table_iter_init (&object_iter, objects);
+		while (g_hash_table_iter_next (&object_iter, &objectid, NULL))
+		{
+			if (is_loaded (objectid) == TRUE)
+				g_ptr_array_add (objectids, objectid);
+		}
+
+		if (objectids->len == 0)
+			continue;
+
+		g_ptr_array_add (objectids, NULL);
+		mafw_source_get_metadatas (MAFW_SOURCE (source),
+					   (const gchar **) objectids->pdata,
+					   keys, metadatas_cb, NULL);
 	}
+
+	g_ptr_array_free (objectids, TRUE);
+	g_hash_table_destroy (changed);
+
+	return FALSE;
 }
 
 static void
 on_source_metadata_changed (MafwSource* source, const gchar* objectid)
 {
+	GHashTable *objects;
 	GtkTreeIter iter;
 
-	if (find_objectid (objectid, &iter) == TRUE)
+	if (objectid == NULL)
+		return;
+
+	/* Cached containers with the item have its old metadata */
+	browse_cache_invalidate_item (objectid);
+	container_stack_invalidate_item (objectid);
+	title_cache_invalidate (objectid);
+	playlist_treeview_item_changed (objectid);
+	if (prefetch.buffer != NULL &&
+	    source_model_lookup (prefetch.buffer, objectid, &iter) == TRUE)
+		prefetch_cancel ();
+
+	/* Only items in the current container need to be fetched */
+	if (is_loaded (objectid) == FALSE)
+		return;
+
+	/* Collect the changes for a moment, since they tend to come in
+	   bursts, and fetch them all at once. Don't save the iter, it
+	   might be invalid by then. */
+	if (changed_objects == NULL)
+		changed_objects = g_hash_table_new_full (
+			g_direct_hash, g_direct_equal, g_object_unref,
+			(GDestroyNotify) g_hash_table_destroy);
+
+	objects = g_hash_table_lookup (changed_objects, source);
+	if (objects == NULL)
+	{
+		objects = g_hash_table_new_full (g_str_hash, g_str_equal,
+						 g_free, NULL);
+		g_hash_table_insert (changed_objects, g_object_ref (source),
+				     objects);
+	}
+
+	if (g_hash_table_lookup (objects, objectid) == NULL)
+	{
+		gchar *key = g_strdup (objectid);
+		g_hash_table_insert (objects, key, key);
+	}
+
+	if (changed_timeout_id == 0)
+		changed_timeout_id = g_timeout_add (METADATA_CHANGED_DELAY,
+						    fetch_changed_metadata,
+						    NULL);
+}
+
+/**
+ * Stop waiting for changed metadata at exit
+ */
+void
+source_treeview_shutdown (void)
+{
+	changed_cancel (NULL);
+}
+
+/*****************************************************************************
+ * Last view snapshot
+ *
+ * At exit, the path to the shown container and the container's contents
+ * are saved to a file. At the next start they are shown from the file at
+ * once, and the container is browsed again in the background like after a
+ * change, once its source has appeared. A snapshot that is too old, or
+ * whose source does not appear in time, is not used.
+ *****************************************************************************/
+
+/** Milliseconds to wait for the source of the restored view */
+#define SNAPSHOT_SOURCE_WAIT 10000
+
+/** UUID of the source that the restored view is waiting for */
+static gchar *snapshot_uuid = NULL;
+static guint snapshot_timeout_id = 0;
+
+/**
+ * Stop waiting for the source of the restored view
+ */
+static void
+snapshot_forget (void)
+{
+	if (snapshot_timeout_id != 0)
+	{
+		g_source_remove (snapshot_timeout_id);
+		snapshot_timeout_id = 0;
+	}
+
+	g_free (snapshot_uuid);
+	snapshot_uuid = NULL;
+}
+
+/**
+ * The source of the restored view has not appeared, so its contents cannot
+ * be checked. Go back to the top level.
+ */
+static gboolean
+snapshot_timeout (gpointer data)
+{
+	snapshot_timeout_id = 0;
+
+	hildon_banner_show_information (NULL, "qgn_list_smiley_angry",
+					"The source of the last view is not "
+					"available");
+	display_sources ();
+
+	return FALSE;
+}
+
+/**
+ * Browse the restored container again when its source appears, and apply
+ * the differences to the view
+ */
+static void
+snapshot_source_added (MafwSource *source)
+{
+	ContainerStackItem *item;
+	const gchar *uuid;
+
+	if (snapshot_uuid == NULL)
+		return;
+
+	uuid = mafw_extension_get_uuid (MAFW_EXTENSION (source));
+	if (uuid == NULL || strcmp (uuid, snapshot_uuid) != 0)
+		return;
+
+	snapshot_forget ();
+
+	item = container_stack_peek_item ();
+	if (item != NULL)
+		refresh_start (source, item->objectid);
+}
+
+/**
+ * Show the view that was saved at the last exit, if there is a recent
+ * enough one. Must be called before any sources are added.
+ */
+void
+source_treeview_restore_view (void)
+{
+	ViewSnapshot *snapshot;
+	GError *error = NULL;
+	gchar *filename;
+	guint i;
+
+	filename = view_snapshot_get_default_filename ();
+	snapshot = view_snapshot_load (filename, &error);
+	g_free (filename);
+
+	if (snapshot == NULL)
+	{
+		/* Not having a snapshot is normal */
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_warning ("%s", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	if (view_snapshot_is_fresh (snapshot, VIEW_SNAPSHOT_MAX_AGE) == FALSE ||
+	    view_snapshot_get_path_length (snapshot) == 0)
+	{
+		view_snapshot_free (snapshot);
+		return;
+	}
+
+	for (i = 0; i < view_snapshot_get_path_length (snapshot); i++)
+		container_stack_push (view_snapshot_get_path (snapshot, i));
+
+	/* Don't make the view follow every inserted row */
+	g_object_ref (model);
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), NULL);
+
+	source_model_clear (SOURCE_MODEL (model));
+	view_snapshot_fill (snapshot, SOURCE_MODEL (model));
+
+	gtk_tree_view_set_model (GTK_TREE_VIEW (treeview), model);
+	g_object_unref (model);
+
+	snapshot_uuid = g_strdup (view_snapshot_get_uuid (snapshot));
+	snapshot_timeout_id = g_timeout_add (SNAPSHOT_SOURCE_WAIT,
+					     snapshot_timeout, NULL);
+
+	view_snapshot_free (snapshot);
+}
+
+/**
+ * Save the path to the shown container and its contents for the next
+ * start. Only completely browsed, unfiltered contents are saved. Otherwise,
+ * and on the top level, the next start shows the sources.
+ */
+void
+source_treeview_save_view (void)
+{
+	ContainerStackItem *item;
+	SourceModel *contents;
+	GError *error = NULL;
+	GPtrArray *path;
+	gchar *filename;
+	gchar *uuid = NULL;
+	GList *node;
+
+	filename = view_snapshot_get_default_filename ();
+
+	item = container_stack_peek_item ();
+	if (item == NULL || is_complete (item) == FALSE ||
+	    search_filter != NULL)
 	{
-		const gchar *const *keys;
+		g_unlink (filename);
+		g_free (filename);
+		return;
+	}
+
+	/* Including the rows filtered out locally */
+	contents = SOURCE_MODEL (model);
 
-		keys = MAFW_SOURCE_LIST (MAFW_METADATA_KEY_TITLE,
-					  MAFW_METADATA_KEY_URI,
-					  MAFW_METADATA_KEY_MIME);
+	/* Showing all sources is not a path in one of them */
+	if (((ContainerStackItem *) container_stack->tail->data)->aggregate ==
+	    TRUE)
+	{
+		g_unlink (filename);
+		g_free (filename);
+		return;
+	}
 
+	/* From the root of the source to the shown container */
+	path = g_ptr_array_new ();
+	for (node = container_stack->tail; node != NULL; node = node->prev)
+	{
+		item = node->data;
+		g_ptr_array_add (path, item->objectid);
+	}
 
-		/* The changed item is present in the current model.
-		   We need to get its info. Don't save the iter until
-		   metadata_cb is called, since it might be already invalid
-		   because get_metadata() is async. */
-		mafw_source_get_metadata (source, objectid, keys, metadata_cb,
-					   NULL);
+	mafw_source_split_objectid (g_ptr_array_index (path, 0), &uuid, NULL);
+	if (uuid == NULL ||
+	    view_snapshot_save (filename, uuid, path, contents,
+				&error) == FALSE)
+	{
+		if (error != NULL)
+		{
+			g_warning ("Unable to save the view: %s",
+				   error->message);
+			g_error_free (error);
+		}
+		g_unlink (filename);
 	}
+
+	g_ptr_array_free (path, TRUE);
+	g_free (uuid);
+	g_free (filename);
 }
 
 /*****************************************************************************
@@ -1002,13 +3993,12 @@ on_source_metadata_changed (MafwSource* source, const gchar* objectid)
  *****************************************************************************/
 
 /**
- * Append a single source to the current list store
+ * Append a single source to the current model
  */
 static void
 append_source (MafwSource *source)
 {
 	const gchar *name;
-	GtkTreeIter iter;
 	gchar *oid;
 
 	name = mafw_extension_get_name (MAFW_EXTENSION (source));
@@ -1023,19 +4013,14 @@ append_source (MafwSource *source)
 	oid = g_strconcat(mafw_extension_get_uuid (
                                   MAFW_EXTENSION(source)), "::", NULL);
 
-	/* Append the source to the list store */
-	gtk_list_store_append (GTK_LIST_STORE (model), &iter);
-	gtk_list_store_set (GTK_LIST_STORE (model), &iter,
-			    COLUMN_TITLE, name,
-			    COLUMN_OBJECTID, oid,
-			    COLUMN_MIME, NULL,
-			    -1);
+	/* Append the source to the model */
+	source_model_append (SOURCE_MODEL (model), name, oid, NULL, NULL);
 
 	g_free(oid);
 }
 
 /**
- * Clear the current list store contents and display all available sources
+ * Clear the current model contents and display all available sources
  */
 static void
 display_sources(void)
@@ -1048,8 +4033,17 @@ display_sources(void)
 		/* Just pop the container stack until it is empty. */
 	}
 
-	/* Clear the contents of the current list store */
-	gtk_list_store_clear (GTK_LIST_STORE (model));
+	/* Nothing to refresh on the top level, nor to browse or filter */
+	refresh_cancel ();
+	flatten_cancel ();
+	aggregate_cancel ();
+	changed_cancel (NULL);
+	local_filter_reset ();
+	snapshot_forget ();
+	browse_scheduler_new_generation ();
+
+	/* Clear the contents of the current model */
+	source_model_clear (SOURCE_MODEL (model));
 
 	registry = MAFW_REGISTRY(mafw_registry_get_instance());
 	if (registry == NULL)
@@ -1085,20 +4079,23 @@ add_source (MafwSource *source)
 	if (container_stack_peek_objectid(NULL) == FALSE)
 	{
 		append_source (source);
-
-		/* Listen to container change signals */
-		g_signal_connect(source, "container-changed",
-				 (GCallback) on_source_container_changed, NULL);
-
-		/* Listen to metadata change signals */
-		g_signal_connect(source, "metadata-changed",
-				 (GCallback) on_source_metadata_changed, NULL);
 	}
 	else
 	{
-		/* We are inside some other server's container. No need to
-		   do anything with the newly-found source. */
+		/* We are inside some other server's container, or inside
+		   this one if the view was restored from the snapshot, or
+		   showing all sources */
+		snapshot_source_added (source);
+		aggregate_source_added (source);
 	}
+
+	/* Listen to container change signals */
+	g_signal_connect(source, "container-changed",
+			 (GCallback) on_source_container_changed, NULL);
+
+	/* Listen to metadata change signals */
+	g_signal_connect(source, "metadata-changed",
+			 (GCallback) on_source_metadata_changed, NULL);
 }
 
 /**
@@ -1110,6 +4107,15 @@ remove_source (MafwSource *source)
 {
 	gchar *oid;
 
+	if (prefetch.source == source)
+		prefetch_cancel ();
+	if (refresh.source == source)
+		refresh_cancel ();
+	if (flatten.source == source)
+		flatten_cancel ();
+	aggregate_source_removed (source);
+	changed_cancel (source);
+
 	/* If the container stack is empty, we are on top level and can
 	   remove all destroyed sources from the view. Otherwise, if we are
 	   inside the destroyed source, we must return to top level. */
@@ -1143,7 +4149,7 @@ remove_source (MafwSource *source)
 				  "::", NULL);
 
 		if (find_objectid (oid, &iter) == TRUE)
-			gtk_list_store_remove (GTK_LIST_STORE (model), &iter);
+			source_model_remove (SOURCE_MODEL (model), &iter);
 
 		g_free(oid);
 	}
@@ -1163,29 +4169,17 @@ find_objectid (const gchar* objectid, GtkTreeIter* iter)
 	g_return_val_if_fail (objectid != NULL, FALSE);
 	g_return_val_if_fail (iter != NULL, FALSE);
 
-	if (gtk_tree_model_get_iter_first (model, iter) == FALSE)
-		return FALSE;
-
-	do
-	{
-		gchar* oid;
-		gtk_tree_model_get (model, iter,
-				    COLUMN_OBJECTID, &oid,
-				    -1);
-
-		if (oid != NULL && strcmp (oid, objectid) == 0)
-		{
-			g_free (oid);
-			return TRUE;
-		}
-		else
-		{
-			g_free (oid);
-		}
-
-	} while (gtk_tree_model_iter_next (model, iter) == TRUE);
+	return source_model_lookup (SOURCE_MODEL (model), objectid, iter);
+}
 
-	return FALSE;
+/**
+ * Check whether @objectid is in the current container, whether it is shown
+ * or filtered out locally
+ */
+static gboolean
+is_loaded (const gchar *objectid)
+{
+	return source_model_find (SOURCE_MODEL (model), objectid, NULL);
 }
 
 /**
@@ -1197,6 +4191,7 @@ selected_is_container (void)
 	GtkTreeSelection *selection;
 	GtkTreeModel *model = NULL;
 	gchar* mime = NULL;
+	gchar *objectid = NULL;
 	GtkTreeIter iter;
 
 	/* Get the selection object */
@@ -1209,9 +4204,18 @@ selected_is_container (void)
 
 	/* Get the selected item's MIME type */
 	gtk_tree_model_get (model, &iter,
+			    COLUMN_OBJECTID, &objectid,
 			    COLUMN_MIME, &mime,
 			    -1);
 
+	/* Placeholders of pages still being loaded have neither */
+	if (objectid == NULL)
+	{
+		g_free (mime);
+		return FALSE;
+	}
+	g_free (objectid);
+
 	/* Accept either NULL mime type (top-level sources) or a container
 	   mimetype (normal containers) */
 	if (mime == NULL ||
@@ -1261,14 +4265,17 @@ get_selected_object_id (void)
 MafwSource*
 get_selected_source (void)
 {
-	gchar* object_id;
+	gchar* object_id = NULL;
 	MafwExtension *extension;
 	gchar* uuid;
 
 	/* First try getting the object ID from the current container we're
-	   in. If that fails, try to get the object ID from a selected item. */
-	if (container_stack_peek_objectid (&object_id) == FALSE)
+	   in. If that fails, try to get the object ID from a selected item.
+	   All sources are shown together, so there it is the item's. */
+	if (container_stack_peek_objectid (&object_id) == FALSE ||
+	    container_stack_peek_item ()->aggregate == TRUE)
 	{
+		g_free (object_id);
 		object_id = get_selected_object_id ();
 		if (object_id == NULL)
 			return NULL;
@@ -1341,6 +4348,9 @@ enum {
 
 static GdkPixbuf* mimeimages[qgn_list_MAX];
 
+/** Icon of each row category, pointing into mimeimages */
+static GdkPixbuf* category_images[SOURCE_MODEL_N_CATEGORIES];
+
 static void mimeimage_init(void)
 {
         GtkIconTheme* theme = NULL;
@@ -1385,6 +4395,25 @@ static void mimeimage_init(void)
 					 HILDON_ICON_PIXEL_SIZE_SMALL,
 					 GTK_ICON_LOOKUP_NO_SVG,
 					 NULL);
+
+	/* Placeholders of pages that have not been loaded have no icon */
+	category_images[SOURCE_MODEL_CATEGORY_PLACEHOLDER] = NULL;
+
+	/* Rows without a MIME type are the top-level sources. No need to
+	   check the device type because only CDS-capable devices are in
+	   our list. */
+	category_images[SOURCE_MODEL_CATEGORY_SOURCE] =
+		mimeimages[qgn_list_filemanager];
+	category_images[SOURCE_MODEL_CATEGORY_CONTAINER] =
+		mimeimages[qgn_list_gene_fldr_cls];
+	category_images[SOURCE_MODEL_CATEGORY_AUDIO] =
+		mimeimages[qgn_list_gene_music_file];
+	category_images[SOURCE_MODEL_CATEGORY_VIDEO] =
+		mimeimages[qgn_list_gene_video_file];
+	category_images[SOURCE_MODEL_CATEGORY_IMAGE] =
+		mimeimages[qgn_list_gene_image_file];
+	category_images[SOURCE_MODEL_CATEGORY_OTHER] =
+		mimeimages[qgn_list_gene_notsupported];
 }
 
 static void render_mimeimage_datafunc(GtkTreeViewColumn *column,
@@ -1393,70 +4422,22 @@ static void render_mimeimage_datafunc(GtkTreeViewColumn *column,
 				      GtkTreeIter *iter,
 				      gpointer data)
 {
-        GdkPixbuf *pixbuf = NULL;
-        gchar *mime = NULL;
-
-        g_return_if_fail(renderer != NULL);
-        g_return_if_fail(model != NULL);
-
-        /* If it is expander, then it is a container */
-        gtk_tree_model_get(model, iter,
-			   COLUMN_MIME, &mime, -1);
-
-        if (mime != NULL)
-        {
-                if (strcmp(mime, MAFW_METADATA_VALUE_MIME_CONTAINER) == 0)
-                {
-			pixbuf = mimeimages[qgn_list_gene_fldr_cls];
-		}
-		else if (strstr(mime, "audio") != NULL)
-		{
-			pixbuf = mimeimages[qgn_list_gene_music_file];
-                }
-		else if (strstr(mime, "video") != NULL)
-		{
-			pixbuf = mimeimages[qgn_list_gene_video_file];
-		}
-		else if (strstr(mime, "image") != NULL)
-		{
-			pixbuf = mimeimages[qgn_list_gene_image_file];
-		}
-                else
-                {
-                        pixbuf = mimeimages[qgn_list_gene_notsupported];
-                }
-        }
-        else
-        {
-                /* The node didn't have class, expect it to be device.
-                 * No need to check device type because only CDS-capable
-                 * devices are in our list */
-                pixbuf = mimeimages[qgn_list_filemanager];
-        }
+	const SourceModelRow *row;
 
-        g_free(mime);
+	/* Runs for every visible row on every repaint, so the icon has been
+	   chosen beforehand, when the row was stored */
+	row = source_model_get_row ((SourceModel *) model, iter);
+	g_return_if_fail (row != NULL);
 
-        if (pixbuf != NULL)
-        {
-                /* Set pixbuf */
-                g_object_set(G_OBJECT(renderer),
-                             "pixbuf", pixbuf,
-                             NULL);
-        }
+	g_object_set (G_OBJECT (renderer),
+		      "pixbuf", category_images[row->category],
+		      NULL);
 }
 
 static void
 create_playlist_treemodel (void)
 {
-	model = GTK_TREE_MODEL (gtk_list_store_new (COLUMNS,
-						    G_TYPE_STRING,
-						    G_TYPE_STRING,
-						    G_TYPE_STRING));
-
-	cache = GTK_TREE_MODEL (gtk_list_store_new (COLUMNS,
-						    G_TYPE_STRING,
-						    G_TYPE_STRING,
-						    G_TYPE_STRING));
+	model = GTK_TREE_MODEL (source_model_new ());
 }
 
 static void
@@ -1491,6 +4472,9 @@ setup_treeview_columns (GtkWidget *treeview)
 void
 setup_source_treeview (GtkBuilder *builder)
 {
+	GtkTreeSelection *selection;
+	GtkAdjustment *adjustment;
+
 	/* Default to detached model, since it's the fastest */
 	model_behaviour = SourceModelDetached;
 
@@ -1520,5 +4504,20 @@ setup_source_treeview (GtkBuilder *builder)
 			  G_CALLBACK (on_source_treeview_key_pressed),
 			  NULL);
 
+	/* Prefetch the container under the cursor */
+	selection = gtk_tree_view_get_selection (GTK_TREE_VIEW (treeview));
+	g_signal_connect (selection, "changed",
+			  G_CALLBACK (on_source_selection_changed), NULL);
+
+	/* Follow the visible range for paged browsing */
+	adjustment = gtk_tree_view_get_vadjustment (GTK_TREE_VIEW (treeview));
+	g_signal_connect (adjustment, "value-changed",
+			  G_CALLBACK (on_source_view_scrolled), NULL);
+	g_signal_connect (adjustment, "changed",
+			  G_CALLBACK (on_source_view_scrolled), NULL);
+
+	/* Search and sort bar above the view */
+	setup_search (builder);
+
 	mimeimage_init();
 }
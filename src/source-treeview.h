@@ -31,7 +31,8 @@
 typedef enum _SourceModelBehaviour {
 	SourceModelDetached,
 	SourceModelCached,
-	SourceModelNormal
+	SourceModelNormal,
+	SourceModelPaged
 } SourceModelBehaviour;
 
 gboolean selected_is_container (void);
@@ -46,5 +47,19 @@ MafwSource *get_selected_source(void);
 
 void source_treeview_set_model_behaviour(SourceModelBehaviour behaviour);
 SourceModelBehaviour source_treeview_get_model_behaviour(void);
+const gchar *source_treeview_behaviour_name(SourceModelBehaviour behaviour);
+gsize source_treeview_get_bytes_saved(void);
+void source_treeview_set_flush_budget(guint msec);
+void source_treeview_set_prefetch(gboolean enabled);
+void source_treeview_flatten_selected(void);
+void source_treeview_browse_all(const gchar *path);
+void source_treeview_set_local_filter(gboolean enabled);
+void source_treeview_restore_view(void);
+void source_treeview_save_view(void);
+void source_treeview_shutdown(void);
+void source_treeview_get_prefetch_stats(guint *started, guint *hit_count,
+					guint *adopted_count,
+					guint *miss_count,
+					guint *cancelled_count);
 
 #endif /* __SOURCETREEVIEW_H__ */
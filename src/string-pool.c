@@ -0,0 +1,138 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include "string-pool.h"
+
+/*****************************************************************************
+ * String pool
+ *
+ * Reference counted strings, one copy of each distinct value. Used for the
+ * columns of tree models where the same long value appears on many rows.
+ * Unlike quarks, pooled strings are released once no row refers to them.
+ *****************************************************************************/
+
+typedef struct _PooledString
+{
+	gchar *str;
+	guint refs;
+
+} PooledString;
+
+/** String -> PooledString, keyed by the pooled copy */
+static GHashTable *pool = NULL;
+
+/** Total size of the pooled strings, terminators included */
+static gsize pool_bytes = 0;
+
+/**
+ * Get the pooled copy of @str, adding it to the pool if needed. Every call
+ * must be paired with string_pool_unref() on the returned string.
+ */
+const gchar *
+string_pool_ref (const gchar *str)
+{
+	PooledString *entry;
+
+	if (str == NULL)
+		return NULL;
+
+	if (pool == NULL)
+		pool = g_hash_table_new (g_str_hash, g_str_equal);
+
+	entry = g_hash_table_lookup (pool, str);
+	if (entry == NULL)
+	{
+		entry = g_new (PooledString, 1);
+		entry->str = g_strdup (str);
+		entry->refs = 0;
+		g_hash_table_insert (pool, entry->str, entry);
+		pool_bytes += strlen (entry->str) + 1;
+	}
+
+	entry->refs++;
+	return entry->str;
+}
+
+/**
+ * Drop a reference taken with string_pool_ref()
+ */
+void
+string_pool_unref (const gchar *str)
+{
+	PooledString *entry;
+
+	if (str == NULL)
+		return;
+
+	g_return_if_fail (pool != NULL);
+
+	entry = g_hash_table_lookup (pool, str);
+	g_return_if_fail (entry != NULL && entry->str == str);
+
+	if (--entry->refs > 0)
+		return;
+
+	g_hash_table_remove (pool, entry->str);
+	pool_bytes -= strlen (entry->str) + 1;
+	g_free (entry->str);
+	g_free (entry);
+}
+
+static gpointer
+pooled_string_copy (gpointer boxed)
+{
+	return (gpointer) string_pool_ref (boxed);
+}
+
+static void
+pooled_string_free (gpointer boxed)
+{
+	string_pool_unref (boxed);
+}
+
+GType
+string_pool_string_get_type (void)
+{
+	static GType type = 0;
+
+	if (type == 0)
+		type = g_boxed_type_register_static ("MtgPooledString",
+						     pooled_string_copy,
+						     pooled_string_free);
+	return type;
+}
+
+/**
+ * Get the number of distinct strings in the pool and the memory they take.
+ * Either return location can be %NULL.
+ */
+void
+string_pool_get_stats (guint *strings, gsize *bytes)
+{
+	if (strings != NULL)
+		*strings = pool != NULL ? g_hash_table_size (pool) : 0;
+	if (bytes != NULL)
+		*bytes = pool_bytes;
+}
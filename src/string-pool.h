@@ -0,0 +1,41 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __STRINGPOOL_H__
+#define __STRINGPOOL_H__
+
+#include <config.h>
+#include <glib-object.h>
+
+/** Boxed type of pooled strings. Copying a value of this type takes a
+    reference to the pooled copy of the string instead of duplicating it,
+    so a tree model column of this type stores each distinct string once. */
+#define STRING_POOL_TYPE_STRING (string_pool_string_get_type())
+
+GType string_pool_string_get_type(void);
+
+const gchar *string_pool_ref(const gchar *str);
+void string_pool_unref(const gchar *str);
+
+void string_pool_get_stats(guint *strings, gsize *bytes);
+
+#endif /* __STRINGPOOL_H__ */
@@ -0,0 +1,231 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include "title-cache.h"
+
+/*****************************************************************************
+ * Title cache
+ *
+ * Keeps the display titles of playlist items by object ID, shared by all
+ * playlists, so that items seen before need no metadata request when a
+ * playlist is shown again or another playlist has the same items. The least
+ * recently used title is evicted when the cache is full.
+ *****************************************************************************/
+
+typedef struct _TitleCacheEntry
+{
+	/** Object ID of the item */
+	gchar *objectid;
+
+	/** Title shown for the item */
+	gchar *title;
+
+} TitleCacheEntry;
+
+/** Entries in LRU order, the most recently used one at the head */
+static GQueue *lru = NULL;
+
+/** Object ID -> GList link in the lru queue */
+static GHashTable *by_objectid = NULL;
+
+static guint capacity = TITLE_CACHE_DEFAULT_CAPACITY;
+static guint hits = 0;
+static guint misses = 0;
+
+static void
+title_cache_init (void)
+{
+	if (lru != NULL)
+		return;
+
+	lru = g_queue_new ();
+	by_objectid = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static void
+entry_free (TitleCacheEntry *entry)
+{
+	g_free (entry->title);
+	g_free (entry->objectid);
+	g_free (entry);
+}
+
+/**
+ * Drop the entry at @link from the cache
+ */
+static void
+remove_link (GList *link)
+{
+	TitleCacheEntry *entry = link->data;
+
+	g_hash_table_remove (by_objectid, entry->objectid);
+	g_queue_delete_link (lru, link);
+	entry_free (entry);
+}
+
+/**
+ * Evict the least recently used entries until there are at most @size left
+ */
+static void
+shrink (guint size)
+{
+	while (g_queue_get_length (lru) > size)
+		remove_link (g_queue_peek_tail_link (lru));
+}
+
+/**
+ * Store @title as the title of the item @objectid, replacing any older one.
+ */
+void
+title_cache_store (const gchar *objectid, const gchar *title)
+{
+	TitleCacheEntry *entry;
+	GList *link;
+
+	g_return_if_fail (objectid != NULL);
+	g_return_if_fail (title != NULL);
+
+	title_cache_init ();
+	if (capacity == 0)
+		return;
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link != NULL)
+	{
+		/* Reuse the entry and make it the most recent one */
+		entry = link->data;
+		g_queue_unlink (lru, link);
+		g_queue_push_head_link (lru, link);
+
+		if (strcmp (entry->title, title) == 0)
+			return;
+		g_free (entry->title);
+	}
+	else
+	{
+		shrink (capacity - 1);
+
+		entry = g_new0 (TitleCacheEntry, 1);
+		entry->objectid = g_strdup (objectid);
+		g_queue_push_head (lru, entry);
+		g_hash_table_insert (by_objectid, entry->objectid,
+				     g_queue_peek_head_link (lru));
+	}
+
+	entry->title = g_strdup (title);
+}
+
+/**
+ * Get the cached title of the item @objectid.
+ *
+ * Returns the title, owned by the cache and valid until the cache is next
+ * changed, or %NULL on a cache miss.
+ */
+const gchar *
+title_cache_lookup (const gchar *objectid)
+{
+	TitleCacheEntry *entry;
+	GList *link;
+
+	g_return_val_if_fail (objectid != NULL, NULL);
+
+	title_cache_init ();
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link == NULL)
+	{
+		misses++;
+		return NULL;
+	}
+
+	hits++;
+
+	entry = link->data;
+	g_queue_unlink (lru, link);
+	g_queue_push_head_link (lru, link);
+
+	return entry->title;
+}
+
+/**
+ * Forget the cached title of the item @objectid
+ */
+void
+title_cache_invalidate (const gchar *objectid)
+{
+	GList *link;
+
+	g_return_if_fail (objectid != NULL);
+
+	if (lru == NULL)
+		return;
+
+	link = g_hash_table_lookup (by_objectid, objectid);
+	if (link != NULL)
+		remove_link (link);
+}
+
+/**
+ * Empty the cache. The hit and miss counters are not reset.
+ */
+void
+title_cache_clear (void)
+{
+	if (lru == NULL)
+		return;
+
+	shrink (0);
+}
+
+/**
+ * Set the maximum number of cached titles. Zero disables the cache.
+ */
+void
+title_cache_set_capacity (guint new_capacity)
+{
+	capacity = new_capacity;
+
+	if (lru != NULL)
+		shrink (capacity);
+}
+
+/**
+ * Get the current number of cached titles, the maximum number of them, and
+ * the number of cache hits and misses so far. Any of the return locations
+ * can be %NULL.
+ */
+void
+title_cache_get_stats (guint *size, guint *max_size, guint *hit_count,
+		       guint *miss_count)
+{
+	if (size != NULL)
+		*size = lru != NULL ? g_queue_get_length (lru) : 0;
+	if (max_size != NULL)
+		*max_size = capacity;
+	if (hit_count != NULL)
+		*hit_count = hits;
+	if (miss_count != NULL)
+		*miss_count = misses;
+}
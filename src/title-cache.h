@@ -0,0 +1,41 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __TITLECACHE_H__
+#define __TITLECACHE_H__
+
+#include <config.h>
+#include <glib.h>
+
+/** Number of playlist item titles kept in the title cache */
+#define TITLE_CACHE_DEFAULT_CAPACITY 4096
+
+void title_cache_store(const gchar *objectid, const gchar *title);
+const gchar *title_cache_lookup(const gchar *objectid);
+void title_cache_invalidate(const gchar *objectid);
+void title_cache_clear(void);
+
+void title_cache_set_capacity(guint new_capacity);
+void title_cache_get_stats(guint *size, guint *max_size, guint *hit_count,
+			   guint *miss_count);
+
+#endif /* __TITLECACHE_H__ */
@@ -0,0 +1,304 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * A substring index over row titles, for filtering the rows that have been
+ * loaded without asking the source. Titles are case folded once when they
+ * are added. Every three consecutive bytes of a folded title form a
+ * trigram, and each trigram maps to the rows that contain it. A lookup
+ * intersects the rows of the trigrams of the search text, starting from the
+ * rarest, and checks only the rows left, since the trigrams may be in
+ * another order in the title. Search texts shorter than a trigram are
+ * matched against the folded titles directly, which still saves folding
+ * every title again.
+ *
+ * Working on bytes rather than characters is fine for UTF-8, since a valid
+ * UTF-8 string is a substring of another exactly when its bytes are.
+ */
+
+#include <string.h>
+#include <config.h>
+
+#include "title-index.h"
+
+/** Initial size of the folded title arena */
+#define FOLDED_CHUNK_SIZE 16384
+
+struct _TitleIndex {
+	/* Folded title of each row, NULL for rows without a title */
+	GPtrArray *folded;
+	GStringChunk *strings;
+
+	/* Trigram -> GArray of the rows containing it, in ascending order */
+	GHashTable *trigrams;
+};
+
+#define TRIGRAM(s) ((guint) (guchar) (s)[0] << 16 | \
+		    (guint) (guchar) (s)[1] << 8 | \
+		    (guint) (guchar) (s)[2])
+
+static void
+posting_free(gpointer data)
+{
+	g_array_free(data, TRUE);
+}
+
+TitleIndex *
+title_index_new(void)
+{
+	TitleIndex *index;
+
+	index = g_new0(TitleIndex, 1);
+	index->folded = g_ptr_array_new();
+	index->strings = g_string_chunk_new(FOLDED_CHUNK_SIZE);
+	index->trigrams = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+						NULL, posting_free);
+	return index;
+}
+
+void
+title_index_free(TitleIndex *index)
+{
+	if (index == NULL)
+		return;
+
+	g_hash_table_destroy(index->trigrams);
+	g_string_chunk_free(index->strings);
+	g_ptr_array_free(index->folded, TRUE);
+	g_free(index);
+}
+
+/**
+ * title_index_fold:
+ * @str: A string, or %NULL
+ *
+ * Returns: @str in the form that the index compares, to be freed with
+ * g_free()
+ */
+gchar *
+title_index_fold(const gchar *str)
+{
+	if (str == NULL)
+		return NULL;
+	return g_utf8_casefold(str, -1);
+}
+
+/**
+ * title_index_add:
+ * @index: A #TitleIndex
+ * @row: Row number, greater than that of any row added before
+ * @title: Title of the row, or %NULL
+ */
+void
+title_index_add(TitleIndex *index, guint row, const gchar *title)
+{
+	GArray *rows;
+	gchar *folded;
+	gsize length;
+	gsize i;
+	guint key;
+
+	g_return_if_fail(index != NULL);
+	g_return_if_fail(row >= index->folded->len);
+
+	/* Rows are numbered by their position */
+	while (index->folded->len < row)
+		g_ptr_array_add(index->folded, NULL);
+
+	if (title == NULL)
+	{
+		g_ptr_array_add(index->folded, NULL);
+		return;
+	}
+
+	folded = title_index_fold(title);
+	g_ptr_array_add(index->folded,
+			g_string_chunk_insert(index->strings, folded));
+
+	length = strlen(folded);
+	for (i = 0; i + 3 <= length; i++)
+	{
+		key = TRIGRAM(folded + i);
+		rows = g_hash_table_lookup(index->trigrams,
+					   GUINT_TO_POINTER(key));
+		if (rows == NULL)
+		{
+			rows = g_array_new(FALSE, FALSE, sizeof(guint));
+			g_hash_table_insert(index->trigrams,
+					    GUINT_TO_POINTER(key), rows);
+		}
+
+		/* A trigram can occur several times in one title */
+		if (rows->len == 0 ||
+		    g_array_index(rows, guint, rows->len - 1) != row)
+			g_array_append_val(rows, row);
+	}
+
+	g_free(folded);
+}
+
+/**
+ * title_index_clear:
+ * @index: A #TitleIndex
+ *
+ * Remove all rows from the index.
+ */
+void
+title_index_clear(TitleIndex *index)
+{
+	g_return_if_fail(index != NULL);
+
+	g_hash_table_remove_all(index->trigrams);
+	g_ptr_array_set_size(index->folded, 0);
+	g_string_chunk_clear(index->strings);
+}
+
+static gint
+compare_length(gconstpointer a, gconstpointer b)
+{
+	const GArray *rows_a = *(const GArray **) a;
+	const GArray *rows_b = *(const GArray **) b;
+
+	return rows_a->len < rows_b->len ? -1 : rows_a->len > rows_b->len;
+}
+
+/**
+ * Keep only those of @rows that are in @other too. Both are in ascending
+ * order, so each row is searched for only past the previous one.
+ */
+static void
+intersect(GArray *rows, const GArray *other)
+{
+	guint kept = 0;
+	guint from = 0;
+	guint low;
+	guint high;
+	guint middle;
+	guint row;
+	guint i;
+
+	for (i = 0; i < rows->len; i++)
+	{
+		row = g_array_index(rows, guint, i);
+
+		low = from;
+		high = other->len;
+		while (low < high)
+		{
+			middle = low + (high - low) / 2;
+			if (g_array_index(other, guint, middle) < row)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		if (low == other->len)
+			break;
+
+		from = low;
+		if (g_array_index(other, guint, low) == row)
+			g_array_index(rows, guint, kept++) = row;
+	}
+
+	g_array_set_size(rows, kept);
+}
+
+/**
+ * title_index_lookup:
+ * @index: A #TitleIndex
+ * @needle: Text to search for
+ *
+ * Find the rows whose title contains @needle, ignoring case.
+ *
+ * Returns: a #GArray of row numbers in ascending order, to be freed with
+ * g_array_free()
+ */
+GArray *
+title_index_lookup(TitleIndex *index, const gchar *needle)
+{
+	GArray *result;
+	GArray *candidates = NULL;
+	GPtrArray *lists;
+	GArray *rows;
+	const gchar *folded_title;
+	gchar *folded;
+	gsize length;
+	guint row;
+	gsize i;
+
+	g_return_val_if_fail(index != NULL, NULL);
+
+	result = g_array_new(FALSE, FALSE, sizeof(guint));
+	folded = title_index_fold(needle != NULL ? needle : "");
+	length = strlen(folded);
+
+	lists = g_ptr_array_new();
+	for (i = 0; i + 3 <= length; i++)
+	{
+		rows = g_hash_table_lookup(index->trigrams,
+					   GUINT_TO_POINTER(
+						   TRIGRAM(folded + i)));
+		if (rows == NULL)
+		{
+			/* No title has it */
+			g_ptr_array_free(lists, TRUE);
+			g_free(folded);
+			return result;
+		}
+		g_ptr_array_add(lists, rows);
+	}
+
+	if (lists->len > 0)
+	{
+		/* The rarest trigram gives the fewest rows to start from */
+		g_ptr_array_sort(lists, compare_length);
+		rows = g_ptr_array_index(lists, 0);
+		candidates = g_array_sized_new(FALSE, FALSE, sizeof(guint),
+					       rows->len);
+		g_array_append_vals(candidates, rows->data, rows->len);
+		for (i = 1; i < lists->len && candidates->len > 0; i++)
+			intersect(candidates, g_ptr_array_index(lists, i));
+
+		for (i = 0; i < candidates->len; i++)
+		{
+			row = g_array_index(candidates, guint, i);
+			folded_title = g_ptr_array_index(index->folded, row);
+			if (strstr(folded_title, folded) != NULL)
+				g_array_append_val(result, row);
+		}
+		g_array_free(candidates, TRUE);
+	}
+	else
+	{
+		/* Too short for trigrams */
+		for (row = 0; row < index->folded->len; row++)
+		{
+			folded_title = g_ptr_array_index(index->folded, row);
+			if (folded_title != NULL &&
+			    strstr(folded_title, folded) != NULL)
+				g_array_append_val(result, row);
+		}
+	}
+
+	g_ptr_array_free(lists, TRUE);
+	g_free(folded);
+	return result;
+}
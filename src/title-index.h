@@ -0,0 +1,40 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __TITLEINDEX_H__
+#define __TITLEINDEX_H__
+
+#include <config.h>
+#include <glib.h>
+
+typedef struct _TitleIndex TitleIndex;
+
+TitleIndex *title_index_new(void);
+void title_index_free(TitleIndex *index);
+
+void title_index_add(TitleIndex *index, guint row, const gchar *title);
+void title_index_clear(TitleIndex *index);
+GArray *title_index_lookup(TitleIndex *index, const gchar *needle);
+
+gchar *title_index_fold(const gchar *str);
+
+#endif /* __TITLEINDEX_H__ */
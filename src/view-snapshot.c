@@ -0,0 +1,430 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/*
+ * A snapshot of the browse view, saved at exit so that the next start can
+ * show the same container at once. The file is laid out to be used in
+ * place through a memory map:
+ *
+ *   SnapshotHeader
+ *   guint32 path[n_path]       Container object IDs, the root first
+ *   guint32 rows[n_rows][3]    Title, object ID and MIME type of each row
+ *   gchar strings[n_strings]   NUL-terminated strings
+ *
+ * The path and row entries are offsets into the strings, or NO_STRING.
+ * Equal strings, like the MIME types of most rows, are stored once. The
+ * file is only read back on the machine that wrote it, so the numbers are
+ * in host byte order; the magic number tells if that is not the case.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <config.h>
+
+#include "view-snapshot.h"
+
+#define SNAPSHOT_MAGIC 0x4d544756 /* "MTGV" */
+#define SNAPSHOT_VERSION 1
+
+/** Offset of a missing string */
+#define NO_STRING G_MAXUINT32
+
+/** Number of offsets stored for each row */
+#define ROW_FIELDS 3
+
+typedef struct _SnapshotHeader {
+	guint32 magic;
+	guint32 version;
+
+	/* Seconds since the epoch when the snapshot was saved */
+	gint64 timestamp;
+
+	/* UUID of the source that the path is in */
+	guint32 uuid;
+
+	guint32 n_path;
+	guint32 n_rows;
+	guint32 n_strings;
+} SnapshotHeader;
+
+struct _ViewSnapshot {
+	GMappedFile *file;
+
+	const SnapshotHeader *header;
+	const guint32 *path;
+	const guint32 *rows;
+	const gchar *strings;
+};
+
+/**
+ * view_snapshot_get_default_filename:
+ *
+ * Returns: the file that the view is saved to at exit, to be freed with
+ * g_free()
+ */
+gchar *
+view_snapshot_get_default_filename(void)
+{
+	return g_build_filename(g_get_user_cache_dir(), "mafw-test-gui",
+				"last-view", NULL);
+}
+
+/*****************************************************************************
+ * Saving
+ *****************************************************************************/
+
+/**
+ * Append @str to @strings unless an equal string is there already.
+ *
+ * Returns the offset of the string in @strings.
+ */
+static guint32
+add_string(GString *strings, GHashTable *offsets, const gchar *str)
+{
+	gpointer value;
+	guint32 offset;
+
+	if (str == NULL)
+		return NO_STRING;
+
+	if (g_hash_table_lookup_extended(offsets, str, NULL, &value) == TRUE)
+		return GPOINTER_TO_UINT(value);
+
+	offset = strings->len;
+	g_hash_table_insert(offsets, (gpointer) str, GUINT_TO_POINTER(offset));
+	g_string_append_len(strings, str, strlen(str) + 1);
+
+	return offset;
+}
+
+/**
+ * view_snapshot_save:
+ * @filename: File to write
+ * @uuid: UUID of the source that the containers are in
+ * @path: Object IDs of the containers from the source's root to the shown
+ *        one
+ * @model: Contents of the shown container
+ * @error: Return location for an error, or %NULL
+ *
+ * Replace @filename with a snapshot of the view. The file is written in
+ * one go, so a crash while saving leaves the old snapshot in place.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+view_snapshot_save(const gchar *filename, const gchar *uuid,
+		   GPtrArray *path, SourceModel *model, GError **error)
+{
+	const SourceModelRow *row;
+	SnapshotHeader header;
+	GHashTable *offsets;
+	GString *strings;
+	GString *data;
+	gchar *dirname;
+	guint32 offset;
+	guint n_rows;
+	gboolean ok;
+	guint i;
+
+	g_return_val_if_fail(filename != NULL, FALSE);
+	g_return_val_if_fail(uuid != NULL, FALSE);
+	g_return_val_if_fail(path != NULL, FALSE);
+	g_return_val_if_fail(SOURCE_IS_MODEL(model), FALSE);
+
+	n_rows = source_model_get_length(model);
+
+	memset(&header, 0, sizeof(header));
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.timestamp = time(NULL);
+	header.n_path = path->len;
+	header.n_rows = n_rows;
+
+	/* The strings are collected first and the offsets pointing to them
+	   go to the file before them */
+	offsets = g_hash_table_new(g_str_hash, g_str_equal);
+	strings = g_string_new(NULL);
+	data = g_string_sized_new(sizeof(header) +
+				  (path->len + n_rows * ROW_FIELDS) *
+				  sizeof(guint32));
+
+	header.uuid = add_string(strings, offsets, uuid);
+	g_string_append_len(data, (const gchar *) &header, sizeof(header));
+
+	for (i = 0; i < path->len; i++)
+	{
+		offset = add_string(strings, offsets,
+				    g_ptr_array_index(path, i));
+		g_string_append_len(data, (const gchar *) &offset,
+				    sizeof(offset));
+	}
+
+	for (i = 0; i < n_rows; i++)
+	{
+		row = source_model_get_nth_row(model, i);
+
+		offset = add_string(strings, offsets, row->title);
+		g_string_append_len(data, (const gchar *) &offset,
+				    sizeof(offset));
+		offset = add_string(strings, offsets, row->objectid);
+		g_string_append_len(data, (const gchar *) &offset,
+				    sizeof(offset));
+		offset = add_string(strings, offsets, row->mime);
+		g_string_append_len(data, (const gchar *) &offset,
+				    sizeof(offset));
+	}
+
+	/* Now that their size is known */
+	((SnapshotHeader *) data->str)->n_strings = strings->len;
+	g_string_append_len(data, strings->str, strings->len);
+
+	dirname = g_path_get_dirname(filename);
+	g_mkdir_with_parents(dirname, 0700);
+	g_free(dirname);
+
+	ok = g_file_set_contents(filename, data->str, data->len, error);
+
+	g_hash_table_destroy(offsets);
+	g_string_free(strings, TRUE);
+	g_string_free(data, TRUE);
+
+	return ok;
+}
+
+/*****************************************************************************
+ * Loading
+ *****************************************************************************/
+
+/**
+ * Check that @offset is a missing string or the start of one
+ */
+static gboolean
+valid_string(const SnapshotHeader *header, guint32 offset)
+{
+	return offset == NO_STRING || offset < header->n_strings;
+}
+
+/**
+ * Check that the mapped file is a complete snapshot that can be used in
+ * place, so that no later access needs to check anything.
+ */
+static gboolean
+validate(ViewSnapshot *snapshot, gsize size)
+{
+	const SnapshotHeader *header = snapshot->header;
+	gsize n_offsets;
+	gsize i;
+
+	if (size < sizeof(SnapshotHeader) ||
+	    header->magic != SNAPSHOT_MAGIC ||
+	    header->version != SNAPSHOT_VERSION)
+		return FALSE;
+
+	/* Guard the size calculation below against overflows */
+	size -= sizeof(SnapshotHeader);
+	if (header->n_path > size / sizeof(guint32) ||
+	    header->n_rows > size / (ROW_FIELDS * sizeof(guint32)))
+		return FALSE;
+
+	n_offsets = header->n_path + (gsize) header->n_rows * ROW_FIELDS;
+	if (n_offsets * sizeof(guint32) + header->n_strings != size)
+		return FALSE;
+
+	snapshot->rows = snapshot->path + header->n_path;
+	snapshot->strings = (const gchar *) (snapshot->path + n_offsets);
+
+	/* A string starting at any offset ends within the file */
+	if (header->n_strings == 0 ||
+	    snapshot->strings[header->n_strings - 1] != '\0')
+		return FALSE;
+
+	if (header->uuid == NO_STRING ||
+	    valid_string(header, header->uuid) == FALSE)
+		return FALSE;
+
+	/* The path entries come right before the rows */
+	for (i = 0; i < n_offsets; i++)
+	{
+		if (valid_string(header, snapshot->path[i]) == FALSE)
+			return FALSE;
+	}
+
+	for (i = 0; i < header->n_path; i++)
+	{
+		if (snapshot->path[i] == NO_STRING)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * view_snapshot_load:
+ * @filename: File to map
+ * @error: Return location for an error, or %NULL
+ *
+ * Map a snapshot saved with view_snapshot_save(). The snapshot is used in
+ * place, nothing is copied until view_snapshot_fill().
+ *
+ * Returns: the snapshot, or %NULL if the file cannot be read or is not a
+ * valid snapshot
+ */
+ViewSnapshot *
+view_snapshot_load(const gchar *filename, GError **error)
+{
+	ViewSnapshot *snapshot;
+	GMappedFile *file;
+	const gchar *contents;
+
+	g_return_val_if_fail(filename != NULL, NULL);
+
+	file = g_mapped_file_new(filename, FALSE, error);
+	if (file == NULL)
+		return NULL;
+
+	contents = g_mapped_file_get_contents(file);
+
+	snapshot = g_new0(ViewSnapshot, 1);
+	snapshot->file = file;
+	snapshot->header = (const SnapshotHeader *) contents;
+	snapshot->path = (const guint32 *) (contents + sizeof(SnapshotHeader));
+
+	if (validate(snapshot, g_mapped_file_get_length(file)) == FALSE)
+	{
+		g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+			    "%s is not a valid view snapshot", filename);
+		view_snapshot_free(snapshot);
+		return NULL;
+	}
+
+	return snapshot;
+}
+
+void
+view_snapshot_free(ViewSnapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+
+	g_mapped_file_free(snapshot->file);
+	g_free(snapshot);
+}
+
+/*****************************************************************************
+ * Contents
+ *****************************************************************************/
+
+static const gchar *
+get_string(ViewSnapshot *snapshot, guint32 offset)
+{
+	if (offset == NO_STRING)
+		return NULL;
+	return snapshot->strings + offset;
+}
+
+/**
+ * view_snapshot_is_fresh:
+ * @snapshot: A #ViewSnapshot
+ * @max_age: Maximum age in seconds
+ *
+ * Returns: %TRUE if @snapshot was saved at most @max_age seconds ago. A
+ * snapshot from the future means that the clock has been changed, and is
+ * not trusted either.
+ */
+gboolean
+view_snapshot_is_fresh(ViewSnapshot *snapshot, guint max_age)
+{
+	gint64 now;
+
+	g_return_val_if_fail(snapshot != NULL, FALSE);
+
+	now = time(NULL);
+	return snapshot->header->timestamp <= now &&
+		now - snapshot->header->timestamp <= max_age;
+}
+
+/**
+ * view_snapshot_get_uuid:
+ * @snapshot: A #ViewSnapshot
+ *
+ * Returns: the UUID of the source that the snapshot was taken in
+ */
+const gchar *
+view_snapshot_get_uuid(ViewSnapshot *snapshot)
+{
+	g_return_val_if_fail(snapshot != NULL, NULL);
+
+	return get_string(snapshot, snapshot->header->uuid);
+}
+
+guint
+view_snapshot_get_path_length(ViewSnapshot *snapshot)
+{
+	g_return_val_if_fail(snapshot != NULL, 0);
+
+	return snapshot->header->n_path;
+}
+
+/**
+ * view_snapshot_get_path:
+ * @snapshot: A #ViewSnapshot
+ * @n: Depth of the container, zero for the source's root
+ *
+ * Returns: the object ID of the container at depth @n of the path
+ */
+const gchar *
+view_snapshot_get_path(ViewSnapshot *snapshot, guint n)
+{
+	g_return_val_if_fail(snapshot != NULL, NULL);
+	g_return_val_if_fail(n < snapshot->header->n_path, NULL);
+
+	return get_string(snapshot, snapshot->path[n]);
+}
+
+guint
+view_snapshot_get_n_rows(ViewSnapshot *snapshot)
+{
+	g_return_val_if_fail(snapshot != NULL, 0);
+
+	return snapshot->header->n_rows;
+}
+
+/**
+ * view_snapshot_fill:
+ * @snapshot: A #ViewSnapshot
+ * @model: Model to append the rows of the snapshot to
+ */
+void
+view_snapshot_fill(ViewSnapshot *snapshot, SourceModel *model)
+{
+	const guint32 *row;
+	guint i;
+
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(SOURCE_IS_MODEL(model));
+
+	row = snapshot->rows;
+	for (i = 0; i < snapshot->header->n_rows; i++, row += ROW_FIELDS)
+		source_model_append(model, get_string(snapshot, row[0]),
+				    get_string(snapshot, row[1]),
+				    get_string(snapshot, row[2]), NULL);
+}
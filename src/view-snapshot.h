@@ -0,0 +1,52 @@
+/*
+ * This file is a part of MAFW
+ *
+ * Copyright (C) 2007, 2008, 2009 Nokia Corporation, all rights reserved.
+ *
+ * Contact: Visa Smolander <visa.smolander@nokia.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __VIEWSNAPSHOT_H__
+#define __VIEWSNAPSHOT_H__
+
+#include <config.h>
+#include <glib.h>
+
+#include "source-model.h"
+
+/** A snapshot older than this many seconds is not shown at startup */
+#define VIEW_SNAPSHOT_MAX_AGE (24 * 60 * 60)
+
+typedef struct _ViewSnapshot ViewSnapshot;
+
+gchar *view_snapshot_get_default_filename(void);
+
+gboolean view_snapshot_save(const gchar *filename, const gchar *uuid,
+			    GPtrArray *path, SourceModel *model,
+			    GError **error);
+
+ViewSnapshot *view_snapshot_load(const gchar *filename, GError **error);
+void view_snapshot_free(ViewSnapshot *snapshot);
+
+gboolean view_snapshot_is_fresh(ViewSnapshot *snapshot, guint max_age);
+const gchar *view_snapshot_get_uuid(ViewSnapshot *snapshot);
+guint view_snapshot_get_path_length(ViewSnapshot *snapshot);
+const gchar *view_snapshot_get_path(ViewSnapshot *snapshot, guint n);
+guint view_snapshot_get_n_rows(ViewSnapshot *snapshot);
+void view_snapshot_fill(ViewSnapshot *snapshot, SourceModel *model);
+
+#endif /* __VIEWSNAPSHOT_H__ */